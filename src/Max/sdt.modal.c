@@ -43,6 +43,12 @@ void *modal_new(t_symbol *s, long argc, t_atom *argv) {
   long nModes = atom_getlong(&argv[1]);
   long nPickups = atom_getlong(&argv[2]);
   modal = SDTResonator_new(nModes, nPickups);
+  // Presets loaded in the DSP cycle can add modes and pickups, within capacity
+  SDTResonator_reserve(modal,
+                       nModes > SDT_RESONATOR_NMODES_RESERVE
+                           ? nModes
+                           : SDT_RESONATOR_NMODES_RESERVE,
+                       SDT_RESONATOR_NPICKUPS_MAX);
   key = atom_getsym(&argv[0]);
   if (SDT_registerResonator(modal, key->s_name)) {
     error(
@@ -21,4 +21,39 @@ long sdt_pd_arg_parse(t_symbol *s, long argc, const t_atom *argv, long nargs,
     }
   free(selected);
   return i;
-}
\ No newline at end of file
+}
+
+void sdt_pd_interactor_perform(SDTInteractor *x, t_float **ins,
+                               t_float **outs, long nOuts, double *buffer,
+                               int n) {
+  const double *inBuffers[6];
+  double *outBuffers[2 * SDT_RESONATOR_NPICKUPS_MAX];
+  SDTResonator *r0 = SDTInteractor_getFirstResonator(x);
+  SDTResonator *r1 = SDTInteractor_getSecondResonator(x);
+  long nPickups, i;
+  int j, k;
+
+  for (j = 0; j < 6; j++) {
+    inBuffers[j] = NULL;
+    // Silent inputs cost nothing to the interactor
+    for (k = 0; k < n; k++) {
+      if (ins[j][k]) break;
+    }
+    if (k == n) continue;
+    for (k = 0; k < n; k++) {
+      buffer[j * n + k] = ins[j][k];
+    }
+    inBuffers[j] = buffer + j * n;
+  }
+  nPickups = (r0 ? SDTResonator_getNPickups(r0) : 0) +
+             (r1 ? SDTResonator_getNPickups(r1) : 0);
+  for (i = 0; i < nPickups; i++) {
+    outBuffers[i] = i < nOuts ? buffer + (6 + i) * n : NULL;
+  }
+  SDTInteractor_dspBlock(x, inBuffers, outBuffers, n);
+  for (i = 0; i < nOuts; i++) {
+    for (k = 0; k < n; k++) {
+      outs[i][k] = i < nPickups ? (t_float)outBuffers[i][k] : 0.0f;
+    }
+  }
+}
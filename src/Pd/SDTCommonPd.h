@@ -1,3 +1,4 @@
+#include "SDT/SDTInteractors.h"
 #include "SDT/SDTStructs.h"
 #include "m_pd.h"
 
@@ -17,6 +18,21 @@ otherwise */
 extern long sdt_pd_arg_parse(t_symbol *s, long argc, const t_atom *argv,
                              long nargs, const t_atomtype *targs, long *argi);
 
+/** @brief Process a block of samples with an interactor
+Input vectors which are silent over the whole block are not passed to the
+interactor, and outlets beyond the pickup points of the resonators are zeroed.
+Inputs are copied before processing, so that they can share memory with the
+outputs.
+@param[in] x The interactor
+@param[in] ins The 6 input signal vectors
+@param[out] outs The output signal vectors
+@param[in] nOuts The number of output signal vectors
+@param[in] buffer Scratch memory of (6 + nOuts) * n doubles
+@param[in] n The block size */
+extern void sdt_pd_interactor_perform(SDTInteractor *x, t_float **ins,
+                                      t_float **outs, long nOuts,
+                                      double *buffer, int n);
+
 /** @brief Parse the Pd arguments for SDT Pd objects creation
 This macro works for initializer functions whose signature is
 "classname_new(t_symbol *s, int argc, t_atom *argv)". This macro defines an
@@ -18,6 +18,8 @@ typedef struct _friction {
   t_outlet **outs;
   t_float **outBuffers;
   long nOuts;
+  double *buffer;
+  long bufferSize;
 } t_friction;
 
 SDT_PD_SETTER(friction, Friction, friction, NormalForce, )
@@ -34,30 +36,29 @@ SDT_PD_SETTER(friction, Interactor, friction, SecondPoint, )
 
 t_int *friction_perform(t_int *w) {
   t_friction *x = (t_friction *)(w[1]);
-  t_float *in0 = (t_float *)(w[2]);
-  t_float *in1 = (t_float *)(w[3]);
-  t_float *in2 = (t_float *)(w[4]);
-  t_float *in3 = (t_float *)(w[5]);
-  t_float *in4 = (t_float *)(w[6]);
-  t_float *in5 = (t_float *)(w[7]);
+  t_float *ins[6];
   int n = (int)w[8];
-  double tmpOuts[2 * SDT_RESONATOR_NPICKUPS_MAX];
-  int i, k;
+  int i;
 
-  for (k = 0; k < n; k++) {
-    SDTInteractor_dsp(x->friction, *in0++, *in1++, *in2++, *in3++, *in4++,
-                      *in5++, tmpOuts);
-    for (i = 0; i < x->nOuts; i++) {
-      x->outBuffers[i][k] = (t_float)tmpOuts[i];
-    }
+  for (i = 0; i < 6; i++) {
+    ins[i] = (t_float *)(w[2 + i]);
   }
+  sdt_pd_interactor_perform(x->friction, ins, x->outBuffers, x->nOuts,
+                            x->buffer, n);
   return w + 9;
 }
 
 void friction_dsp(t_friction *x, t_signal **sp) {
+  long size;
   int i;
 
   SDT_setSampleRate(sp[0]->s_sr);
+  size = (6 + x->nOuts) * sp[0]->s_n;
+  if (size != x->bufferSize) {
+    if (x->buffer) freebytes(x->buffer, x->bufferSize * sizeof(double));
+    x->buffer = (double *)getbytes(size * sizeof(double));
+    x->bufferSize = size;
+  }
   for (i = 0; i < x->nOuts; i++) {
     x->outBuffers[i] = sp[6 + i]->s_vec;
   }
@@ -98,6 +99,8 @@ void *friction_new(t_symbol *s, long argc, t_atom *argv) {
   x->nOuts = atom_getint(argv + 2);
   x->outs = (t_outlet **)getbytes(x->nOuts * sizeof(t_outlet *));
   x->outBuffers = (t_float **)getbytes(x->nOuts * sizeof(t_float *));
+  x->buffer = NULL;
+  x->bufferSize = 0;
   for (i = 0; i < x->nOuts; i++) {
     x->outs[i] = outlet_new(&x->obj, gensym("signal"));
   }
@@ -119,6 +122,7 @@ void friction_free(t_friction *x) {
   }
   freebytes(x->outs, x->nOuts * sizeof(t_outlet *));
   freebytes(x->outBuffers, x->nOuts * sizeof(t_float *));
+  if (x->buffer) freebytes(x->buffer, x->bufferSize * sizeof(double));
 }
 
 void friction_tilde_setup(void) {
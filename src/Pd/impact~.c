@@ -18,6 +18,8 @@ typedef struct _impact {
   t_outlet **outs;
   t_float **outBuffers;
   long nOuts;
+  double *buffer;
+  long bufferSize;
 } t_impact;
 
 SDT_PD_SETTER(impact, Impact, impact, Stiffness, )
@@ -28,30 +30,29 @@ SDT_PD_SETTER(impact, Interactor, impact, SecondPoint, )
 
 t_int *impact_perform(t_int *w) {
   t_impact *x = (t_impact *)(w[1]);
-  t_float *in0 = (t_float *)(w[2]);
-  t_float *in1 = (t_float *)(w[3]);
-  t_float *in2 = (t_float *)(w[4]);
-  t_float *in3 = (t_float *)(w[5]);
-  t_float *in4 = (t_float *)(w[6]);
-  t_float *in5 = (t_float *)(w[7]);
+  t_float *ins[6];
   int n = (int)w[8];
-  double tmpOuts[2 * SDT_RESONATOR_NPICKUPS_MAX];
-  int i, k;
+  int i;
 
-  for (k = 0; k < n; k++) {
-    SDTInteractor_dsp(x->impact, *in0++, *in1++, *in2++, *in3++, *in4++, *in5++,
-                      tmpOuts);
-    for (i = 0; i < x->nOuts; i++) {
-      x->outBuffers[i][k] = (t_float)tmpOuts[i];
-    }
+  for (i = 0; i < 6; i++) {
+    ins[i] = (t_float *)(w[2 + i]);
   }
+  sdt_pd_interactor_perform(x->impact, ins, x->outBuffers, x->nOuts, x->buffer,
+                            n);
   return w + 9;
 }
 
 void impact_dsp(t_impact *x, t_signal **sp) {
+  long size;
   int i;
 
   SDT_setSampleRate(sp[0]->s_sr);
+  size = (6 + x->nOuts) * sp[0]->s_n;
+  if (size != x->bufferSize) {
+    if (x->buffer) freebytes(x->buffer, x->bufferSize * sizeof(double));
+    x->buffer = (double *)getbytes(size * sizeof(double));
+    x->bufferSize = size;
+  }
   for (i = 0; i < x->nOuts; i++) {
     x->outBuffers[i] = sp[6 + i]->s_vec;
   }
@@ -93,6 +94,8 @@ void *impact_new(t_symbol *s, long argc, t_atom *argv) {
   x->nOuts = atom_getint(argv + 2);
   x->outs = (t_outlet **)getbytes(x->nOuts * sizeof(t_outlet *));
   x->outBuffers = (t_float **)getbytes(x->nOuts * sizeof(t_float *));
+  x->buffer = NULL;
+  x->bufferSize = 0;
   for (i = 0; i < x->nOuts; i++) {
     x->outs[i] = outlet_new(&x->obj, gensym("signal"));
   }
@@ -114,6 +117,7 @@ void impact_free(t_impact *x) {
   }
   freebytes(x->outs, x->nOuts * sizeof(t_outlet *));
   freebytes(x->outBuffers, x->nOuts * sizeof(t_float *));
+  if (x->buffer) freebytes(x->buffer, x->bufferSize * sizeof(double));
 }
 
 void impact_tilde_setup(void) {
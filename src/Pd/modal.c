@@ -50,6 +50,12 @@ void *modal_new(t_symbol *s, long argc, t_atom *argv) {
   int nModes = atom_getint(argv + 1);
   int nPickups = atom_getint(argv + 2);
   x->modal = SDTResonator_new(nModes, nPickups);
+  // Presets loaded in the DSP cycle can add modes and pickups, within capacity
+  SDTResonator_reserve(x->modal,
+                       nModes > SDT_RESONATOR_NMODES_RESERVE
+                           ? nModes
+                           : SDT_RESONATOR_NMODES_RESERVE,
+                       SDT_RESONATOR_NPICKUPS_MAX);
   x->key = (char *)(atom_getsymbol(argv)->s_name);
   if (SDT_registerResonator(x->modal, x->key)) {
     pd_error(
@@ -43,6 +43,7 @@ int SDTOSCRoot(const SDTOSCMessage* x) {
   // Synonyms
   if (!strcmp("myoelastic", k)) return SDTOSCMyoelastic(x);
   if (!strcmp("modal", k) || !strcmp("inertial", k)) return SDTOSCResonator(x);
+  if (!strcmp("budget", k)) return SDTOSCModalBudget(x);
   if (!strcmp("karman", k)) return SDTOSCWindKarman(x);
   if (!strcmp("zerocrossing", k)) return SDTOSCZeroCrossing(x);
 #ifdef SDT_VERBOSE
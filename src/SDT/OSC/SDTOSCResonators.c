@@ -29,6 +29,9 @@ int SDTOSCResonator(const SDTOSCMessage *x) {
     return SDTOSCResonator_setFragmentSize(x);
   if (!strcmp("activeModes", k) || !strcmp("modes", k) || !strcmp("active", k))
     return SDTOSCResonator_setActiveModes(x);
+  if (!strcmp("sleepThreshold", k) || !strcmp("sleep", k))
+    return SDTOSCResonator_setSleepThreshold(x);
+  if (!strcmp("priority", k)) return SDTOSCResonator_setPriority(x);
   SDTOSC_MESSAGE_LOGA(ERROR,
                       "\n  %s\n  [NOT IMPLEMENTED] The specified method is not "
                       "implemented: %s\n  %s\n",
@@ -68,3 +71,40 @@ int SDTOSCResonator_setGain(const SDTOSCMessage *x) {
 _SDTOSC_FLOAT_SETTER_FUNCTION(Resonator, fragmentSize, FragmentSize, double, )
 _SDTOSC_FLOAT_SETTER_FUNCTION(Resonator, activeModes, ActiveModes,
                               unsigned int, )
+_SDTOSC_FLOAT_SETTER_FUNCTION(Resonator, sleepThreshold, SleepThreshold,
+                              double, )
+_SDTOSC_FLOAT_SETTER_FUNCTION(Resonator, priority, Priority, double, )
+
+int SDTOSCModalBudget(const SDTOSCMessage *x) {
+  SDTOSC_MESSAGE_LOGA(VERBOSE, "\n  %s\n", x, "");
+  const SDTOSCAddress *a = SDTOSCMessage_getAddress(x);
+  if (SDTOSCAddress_getDepth(a) < 2) {
+    SDTOSC_MESSAGE_LOGA(ERROR,
+                        "\n  %s\n  [MISSING METHOD] Please, specify an OSC "
+                        "method from the container\n  %s\n",
+                        x, SDTOSC_rtfm_string());
+    return 1;
+  }
+  const char *k = SDTOSCAddress_getNode(a, 1);
+  if (!strcmp("log", k)) return SDTOSCModalBudget_log(x);
+  if (!strcmp("save", k)) return SDTOSCModalBudget_save(x);
+  if (!strcmp("load", k)) return SDTOSCModalBudget_load(x);
+  if (!strcmp("loads", k)) return SDTOSCModalBudget_loads(x);
+  if (!strcmp("maxModes", k)) return SDTOSCModalBudget_setMaxModes(x);
+  if (!strcmp("minModes", k)) return SDTOSCModalBudget_setMinModes(x);
+  if (!strcmp("targetLoad", k)) return SDTOSCModalBudget_setTargetLoad(x);
+  SDTOSC_MESSAGE_LOGA(ERROR,
+                      "\n  %s\n  [NOT IMPLEMENTED] The specified method is not "
+                      "implemented: %s\n  %s\n",
+                      x, k, SDTOSC_rtfm_string());
+  return 2;
+}
+
+_SDTOSC_LOG_FUNCTION(ModalBudget)
+_SDTOSC_SAVE_FUNCTION(ModalBudget)
+_SDTOSC_LOAD_FUNCTION(ModalBudget, )
+_SDTOSC_LOADS_FUNCTION(ModalBudget, )
+
+_SDTOSC_FLOAT_SETTER_FUNCTION(ModalBudget, maxModes, MaxModes, int, )
+_SDTOSC_FLOAT_SETTER_FUNCTION(ModalBudget, minModes, MinModes, int, )
+_SDTOSC_FLOAT_SETTER_FUNCTION(ModalBudget, targetLoad, TargetLoad, double, )
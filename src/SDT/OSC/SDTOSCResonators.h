@@ -113,6 +113,83 @@ Function that sets the resonator active modes
 @return Zero on success, non-zero otherwise */
 extern int SDTOSCResonator_setActiveModes(const SDTOSCMessage *x);
 
+/** @brief `/resonator/sleepThreshold <name> <value>`
+
+Function that sets the resonator sleep threshold
+@param x OSC message pointer
+@return Zero on success, non-zero otherwise */
+extern int SDTOSCResonator_setSleepThreshold(const SDTOSCMessage *x);
+
+/** @brief `/resonator/priority <name> <value>`
+
+Function that sets the resonator priority for the mode budget
+@param x OSC message pointer
+@return Zero on success, non-zero otherwise */
+extern int SDTOSCResonator_setPriority(const SDTOSCMessage *x);
+
+/** @} */
+
+/** @defgroup oscmodalbudget SDTOSCModalBudget
+OSC for #SDTModalBudget objects
+@ingroup oscmethods
+@{ */
+
+/** @brief `/modalbudget/<method> ...`
+
+Function that handles OSC messages for #SDTModalBudget objects
+@param x OSC message pointer
+@return Zero on success, non-zero otherwise */
+extern int SDTOSCModalBudget(const SDTOSCMessage *x);
+
+/** @brief `/modalbudget/log <name>`
+
+Function that implements OSC JSON log for #SDTModalBudget objects
+@param x OSC message pointer
+@return Zero on success, non-zero otherwise */
+extern int SDTOSCModalBudget_log(const SDTOSCMessage *x);
+
+/** @brief `/modalbudget/save <name> <filepath>`
+
+Function that implements OSC JSON save for #SDTModalBudget objects
+@param x OSC message pointer
+@return Zero on success, non-zero otherwise */
+extern int SDTOSCModalBudget_save(const SDTOSCMessage *x);
+
+/** @brief `/modalbudget/load <name> <filepath>`
+
+Function that implements OSC JSON load for #SDTModalBudget objects
+@param x OSC message pointer
+@return Zero on success, non-zero otherwise */
+extern int SDTOSCModalBudget_load(const SDTOSCMessage *x);
+
+/** @brief `/modalbudget/loads <name> <json>`
+
+Function that implements OSC JSON loads for #SDTModalBudget objects
+@param x OSC message pointer
+@return Zero on success, non-zero otherwise */
+extern int SDTOSCModalBudget_loads(const SDTOSCMessage *x);
+
+/** @brief `/modalbudget/maxModes <name> <value>`
+
+Function that sets the maximum number of modes over all resonators
+@param x OSC message pointer
+@return Zero on success, non-zero otherwise */
+extern int SDTOSCModalBudget_setMaxModes(const SDTOSCMessage *x);
+
+/** @brief `/modalbudget/minModes <name> <value>`
+
+Function that sets the minimum number of modes for each resonator
+@param x OSC message pointer
+@return Zero on success, non-zero otherwise */
+extern int SDTOSCModalBudget_setMinModes(const SDTOSCMessage *x);
+
+/** @brief `/modalbudget/targetLoad <name> <value>`
+
+Function that sets the target CPU load
+@param x OSC message pointer
+@return Zero on success, non-zero otherwise */
+extern int SDTOSCModalBudget_setTargetLoad(const SDTOSCMessage *x);
+
 /** @} */
 
 #ifdef __cplusplus
@@ -121,6 +121,15 @@ void SDT_gaussian1D(double *x, double sigma, int n) {
   }
 }
 
+long SDT_geomRand(double p) {
+  double k;
+
+  if (p >= 1.0) return 0;
+  if (p <= 0.0) return -1;
+  k = floor(SDT_expRand(-log1p(-p)));
+  return (k < LONG_MAX) ? (long)k : LONG_MAX;
+}
+
 double SDT_gravity(double mass) { return SDT_EARTH * mass; }
 
 void SDT_hanning(double *sig, int n) {
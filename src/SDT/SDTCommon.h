@@ -389,6 +389,14 @@ function
 @param[in] n kernel size */
 extern void SDT_gaussian1D(double *x, double sigma, int n);
 
+/** @brief Geometric random number generator.
+Draws the number of failed Bernoulli trials before the first success, so
+that a per-sample event with probability p can be scheduled with a single
+draw instead of one trial per sample.
+@param[in] p Success probability of each trial
+@return Number of failures before the first success, or -1 if p <= 0 */
+extern long SDT_geomRand(double p);
+
 /** @brief Computes earth gravity force.
 Computes the earth gravity force acting on an object of a
 given mass.
@@ -1,11 +1,19 @@
 #include "SDTControl.h"
 
+#include <limits.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "SDTCommon.h"
+#include "SDTInteractors.h"
+#include "SDTResonators.h"
 #include "SDTStructs.h"
 
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
 #define UNDERSHOOT 0.1
 #define OVERSHOOT 10.0
 
@@ -89,22 +97,40 @@ void SDTBouncing_reset(SDTBouncing *x) {
   x->currentVelocity = 0.0;
 }
 
+static double bounce(SDTBouncing *x) {
+  double v;
+
+  v = x->targetVelocity;
+  x->targetVelocity *= x->restitution * (1.0 - x->irregularity * SDT_frand());
+  x->currentVelocity -= v + x->targetVelocity;
+  return v;
+}
+
 double SDTBouncing_dsp(SDTBouncing *x) {
   double v;
 
   v = 0.0;
   if (x->targetVelocity > SDT_MICRO) {
     x->currentVelocity += SDT_timeStep * SDT_EARTH;
-    if (x->currentVelocity > x->targetVelocity) {
-      v = x->targetVelocity;
-      x->targetVelocity *=
-          x->restitution * (1.0 - x->irregularity * SDT_frand());
-      x->currentVelocity -= v + x->targetVelocity;
-    }
+    if (x->currentVelocity > x->targetVelocity) v = bounce(x);
   }
   return v;
 }
 
+long SDTBouncing_nextEvent(SDTBouncing *x, double *velocity) {
+  double step, k;
+
+  *velocity = 0.0;
+  if (x->targetVelocity <= SDT_MICRO) return -1;
+  step = SDT_timeStep * SDT_EARTH;
+  k = floor((x->targetVelocity - x->currentVelocity) / step);
+  k = fmax(k, 0.0);
+  if (k >= LONG_MAX) return -1;
+  x->currentVelocity += (k + 1.0) * step;
+  *velocity = bounce(x);
+  return (long)k;
+}
+
 int SDTBouncing_hasFinished(SDTBouncing *x) { return x->targetVelocity <= 0.0; }
 
 //-------------------------------------------------------------------------------------//
@@ -112,6 +138,8 @@ int SDTBouncing_hasFinished(SDTBouncing *x) { return x->targetVelocity <= 0.0; }
 struct SDTBreaking {
   double storedEnergy, crushingEnergy, granularity, fragmentation,
       remainingEnergy;
+  long delay;
+  unsigned char scheduled;
 };
 
 SDTBreaking *SDTBreaking_new() {
@@ -123,6 +151,8 @@ SDTBreaking *SDTBreaking_new() {
   x->granularity = 0.0;
   x->fragmentation = 0.0;
   x->remainingEnergy = 0.0;
+  x->delay = -1;
+  x->scheduled = 0;
   return x;
 }
 
@@ -189,43 +219,76 @@ void SDTBreaking_setCrushingEnergy(SDTBreaking *x, double f) {
 
 void SDTBreaking_setGranularity(SDTBreaking *x, double f) {
   x->granularity = SDT_fclip(f, 0.0, 1.0);
+  x->scheduled = 0;
 }
 
 void SDTBreaking_setFragmentation(SDTBreaking *x, double f) {
   x->fragmentation = SDT_fclip(f, 0.0, 1.0);
 }
 
-void SDTBreaking_reset(SDTBreaking *x) { x->remainingEnergy = 1.0; }
+void SDTBreaking_reset(SDTBreaking *x) {
+  x->remainingEnergy = 1.0;
+  x->scheduled = 0;
+}
 
 int SDTBreaking_hasFinished(SDTBreaking *x) {
   return x->remainingEnergy <= x->crushingEnergy / x->storedEnergy;
 }
 
+static void breakOff(SDTBreaking *x, double *outs) {
+  double fragment, energy;
+
+  fragment = 1.0 - x->fragmentation + x->fragmentation * x->remainingEnergy;
+  energy = x->crushingEnergy * x->remainingEnergy *
+           SDT_fclip(SDT_expRand(1.45), UNDERSHOOT, OVERSHOOT);
+  outs[0] = energy;
+  outs[1] = fmax(SDT_MICRO, fragment * (0.5 + 0.5 * SDT_frand()));
+  x->remainingEnergy -= energy / x->storedEnergy;
+  x->scheduled = 0;
+}
+
+static void scheduleBreaking(SDTBreaking *x) {
+  if (x->scheduled) return;
+  x->delay = SDT_geomRand(x->granularity * x->remainingEnergy);
+  x->scheduled = 1;
+}
+
 void SDTBreaking_dsp(SDTBreaking *x, double *outs) {
-  double success, fragment, energy, size;
-
-  energy = 0.0;
-  size = 0.0;
-  if (!SDTBreaking_hasFinished(x)) {
-    success = x->granularity * x->remainingEnergy;
-    if (SDT_frand() < success) {
-      fragment = 1.0 - x->fragmentation + x->fragmentation * x->remainingEnergy;
-      energy = x->crushingEnergy * x->remainingEnergy *
-               SDT_fclip(SDT_expRand(1.45), UNDERSHOOT, OVERSHOOT);
-      size = fmax(SDT_MICRO, fragment * (0.5 + 0.5 * SDT_frand()));
-      x->remainingEnergy -= energy / x->storedEnergy;
-    }
-  } else {
+  outs[0] = 0.0;
+  outs[1] = 0.0;
+  if (SDTBreaking_hasFinished(x)) {
     x->remainingEnergy = 0.0;
+    return;
+  }
+  scheduleBreaking(x);
+  if (x->delay == 0) {
+    breakOff(x, outs);
+  } else if (x->delay > 0) {
+    x->delay--;
   }
-  outs[0] = energy;
-  outs[1] = size;
+}
+
+long SDTBreaking_nextEvent(SDTBreaking *x, double *outs) {
+  long delay;
+
+  outs[0] = 0.0;
+  outs[1] = 0.0;
+  if (SDTBreaking_hasFinished(x)) {
+    x->remainingEnergy = 0.0;
+    return -1;
+  }
+  scheduleBreaking(x);
+  delay = x->delay;
+  if (delay >= 0) breakOff(x, outs);
+  return delay;
 }
 
 //-------------------------------------------------------------------------------------//
 
 struct SDTCrumpling {
   double crushingEnergy, granularity, fragmentation;
+  long delay;
+  unsigned char scheduled;
 };
 
 SDTCrumpling *SDTCrumpling_new() {
@@ -235,6 +298,8 @@ SDTCrumpling *SDTCrumpling_new() {
   x->crushingEnergy = 0.0;
   x->granularity = 0.0;
   x->fragmentation = 0.0;
+  x->delay = -1;
+  x->scheduled = 0;
   return x;
 }
 
@@ -290,26 +355,380 @@ void SDTCrumpling_setCrushingEnergy(SDTCrumpling *x, double f) {
 
 void SDTCrumpling_setGranularity(SDTCrumpling *x, double f) {
   x->granularity = SDT_fclip(f, 0.0, 1.0);
+  x->scheduled = 0;
 }
 
 void SDTCrumpling_setFragmentation(SDTCrumpling *x, double f) {
   x->fragmentation = SDT_fclip(f, 0.0, 1.0);
 }
 
+static void crumple(SDTCrumpling *x, double *outs) {
+  double fragment;
+
+  fragment = 1.0 - x->fragmentation + x->fragmentation * SDT_frand();
+  outs[0] =
+      x->crushingEnergy * SDT_fclip(SDT_expRand(1.45), UNDERSHOOT, OVERSHOOT);
+  outs[1] = fmax(SDT_MICRO, fragment * (0.5 + 0.5 * SDT_frand()));
+  x->scheduled = 0;
+}
+
+static void scheduleCrumpling(SDTCrumpling *x) {
+  if (x->scheduled) return;
+  x->delay = SDT_geomRand(x->granularity);
+  x->scheduled = 1;
+}
+
 void SDTCrumpling_dsp(SDTCrumpling *x, double *outs) {
-  double success, fragment, energy, size;
-
-  energy = 0.0;
-  size = 0.0;
-  success = x->granularity;
-  if (SDT_frand() < success) {
-    fragment = 1.0 - x->fragmentation + x->fragmentation * SDT_frand();
-    energy =
-        x->crushingEnergy * SDT_fclip(SDT_expRand(1.45), UNDERSHOOT, OVERSHOOT);
-    size = fmax(SDT_MICRO, fragment * (0.5 + 0.5 * SDT_frand()));
+  outs[0] = 0.0;
+  outs[1] = 0.0;
+  scheduleCrumpling(x);
+  if (x->delay == 0) {
+    crumple(x, outs);
+  } else if (x->delay > 0) {
+    x->delay--;
   }
-  outs[0] = energy;
-  outs[1] = size;
+}
+
+long SDTCrumpling_nextEvent(SDTCrumpling *x, double *outs) {
+  long delay;
+
+  outs[0] = 0.0;
+  outs[1] = 0.0;
+  scheduleCrumpling(x);
+  delay = x->delay;
+  if (delay >= 0) crumple(x, outs);
+  return delay;
+}
+
+//-------------------------------------------------------------------------------------//
+
+#define GRAIN_FLOOR 1e-4
+#define GRAIN_SIGNATURE 8
+
+struct SDTGrainCache {
+  SDTInteractor *impact;
+  /* Rendered grains, by energy level and then size level. A negative length
+     marks a grain which is not rendered yet. */
+  double **grains, *voiceGains;
+  int *lengths, *voiceGrains, *voicePositions;
+  /* Resonators and parameters the grains were rendered with. Resonators are
+     compared by their parameter revision. */
+  SDTResonator *obj0, *obj1;
+  double signature[GRAIN_SIGNATURE];
+  double duration, minEnergy, maxEnergy;
+  int nVoices, activeVoices, output, energyLevels, sizeLevels;
+};
+
+static void resizeGrid(SDTGrainCache *x, int energyLevels, int sizeLevels) {
+  int i, n;
+
+  SDTGrainCache_invalidate(x);
+  if (x->grains) free(x->grains);
+  if (x->lengths) free(x->lengths);
+  n = energyLevels * sizeLevels;
+  x->grains = (double **)calloc(n, sizeof(double *));
+  x->lengths = (int *)malloc(n * sizeof(int));
+  for (i = 0; i < n; i++) x->lengths[i] = -1;
+  x->energyLevels = energyLevels;
+  x->sizeLevels = sizeLevels;
+}
+
+SDTGrainCache *SDTGrainCache_new(unsigned int nVoices) {
+  SDTGrainCache *x;
+
+  x = (SDTGrainCache *)malloc(sizeof(SDTGrainCache));
+  x->impact = NULL;
+  x->grains = NULL;
+  x->lengths = NULL;
+  x->obj0 = NULL;
+  x->obj1 = NULL;
+  memset(x->signature, 0, sizeof(x->signature));
+  x->nVoices = nVoices > 0 ? nVoices : 1;
+  x->voiceGains = (double *)malloc(x->nVoices * sizeof(double));
+  x->voiceGrains = (int *)malloc(x->nVoices * sizeof(int));
+  x->voicePositions = (int *)malloc(x->nVoices * sizeof(int));
+  x->activeVoices = 0;
+  x->duration = 0.5;
+  x->minEnergy = 0.1;
+  x->maxEnergy = 100.0;
+  x->output = 0;
+  x->energyLevels = 0;
+  x->sizeLevels = 0;
+  resizeGrid(x, 16, 8);
+  return x;
+}
+
+void SDTGrainCache_free(SDTGrainCache *x) {
+  SDTGrainCache_invalidate(x);
+  free(x->grains);
+  free(x->lengths);
+  free(x->voiceGains);
+  free(x->voiceGrains);
+  free(x->voicePositions);
+  free(x);
+}
+
+SDTInteractor *SDTGrainCache_getImpact(const SDTGrainCache *x) {
+  return x->impact;
+}
+
+int SDTGrainCache_getOutput(const SDTGrainCache *x) { return x->output; }
+
+double SDTGrainCache_getDuration(const SDTGrainCache *x) {
+  return x->duration;
+}
+
+double SDTGrainCache_getMinEnergy(const SDTGrainCache *x) {
+  return x->minEnergy;
+}
+
+double SDTGrainCache_getMaxEnergy(const SDTGrainCache *x) {
+  return x->maxEnergy;
+}
+
+int SDTGrainCache_getEnergyLevels(const SDTGrainCache *x) {
+  return x->energyLevels;
+}
+
+int SDTGrainCache_getSizeLevels(const SDTGrainCache *x) {
+  return x->sizeLevels;
+}
+
+int SDTGrainCache_getActiveVoices(const SDTGrainCache *x) {
+  return x->activeVoices;
+}
+
+void SDTGrainCache_setImpact(SDTGrainCache *x, SDTInteractor *p) {
+  x->impact = p;
+  SDTGrainCache_invalidate(x);
+}
+
+void SDTGrainCache_setOutput(SDTGrainCache *x, int i) {
+  x->output = i < 0 ? 0 : i;
+  SDTGrainCache_invalidate(x);
+}
+
+void SDTGrainCache_setDuration(SDTGrainCache *x, double f) {
+  x->duration = fmax(0.0, f);
+  SDTGrainCache_invalidate(x);
+}
+
+void SDTGrainCache_setMinEnergy(SDTGrainCache *x, double f) {
+  x->minEnergy = fmax(SDT_MICRO, f);
+  SDTGrainCache_invalidate(x);
+}
+
+void SDTGrainCache_setMaxEnergy(SDTGrainCache *x, double f) {
+  x->maxEnergy = fmax(SDT_MICRO, f);
+  SDTGrainCache_invalidate(x);
+}
+
+void SDTGrainCache_setEnergyLevels(SDTGrainCache *x, int i) {
+  resizeGrid(x, i < 1 ? 1 : i, x->sizeLevels);
+}
+
+void SDTGrainCache_setSizeLevels(SDTGrainCache *x, int i) {
+  resizeGrid(x, x->energyLevels, i < 1 ? 1 : i);
+}
+
+void SDTGrainCache_invalidate(SDTGrainCache *x) {
+  int i;
+
+  // Playing grains are freed too
+  x->activeVoices = 0;
+  for (i = 0; i < x->energyLevels * x->sizeLevels; i++) {
+    if (x->grains[i]) free(x->grains[i]);
+    x->grains[i] = NULL;
+    x->lengths[i] = -1;
+  }
+}
+
+/* Invalidates the grains if the impact or its resonators changed. Fragment
+   sizes are not compared, because grains set their own. */
+static void refresh(SDTGrainCache *x) {
+  SDTResonator *obj0, *obj1;
+  double s[GRAIN_SIGNATURE];
+
+  obj0 = x->impact ? SDTInteractor_getFirstResonator(x->impact) : NULL;
+  obj1 = x->impact ? SDTInteractor_getSecondResonator(x->impact) : NULL;
+  s[0] = SDT_timeStep;
+  s[1] = x->impact ? SDTImpact_getStiffness(x->impact) : 0.0;
+  s[2] = x->impact ? SDTImpact_getDissipation(x->impact) : 0.0;
+  s[3] = x->impact ? SDTImpact_getShape(x->impact) : 0.0;
+  s[4] = x->impact ? SDTInteractor_getFirstPoint(x->impact) : 0.0;
+  s[5] = x->impact ? SDTInteractor_getSecondPoint(x->impact) : 0.0;
+  s[6] = obj0 ? SDTResonator_getParamRevision(obj0) : 0.0;
+  s[7] = obj1 ? SDTResonator_getParamRevision(obj1) : 0.0;
+  if (obj0 != x->obj0 || obj1 != x->obj1 ||
+      memcmp(s, x->signature, sizeof(s))) {
+    x->obj0 = obj0;
+    x->obj1 = obj1;
+    memcpy(x->signature, s, sizeof(s));
+    SDTGrainCache_invalidate(x);
+  }
+}
+
+static double energyLevel(const SDTGrainCache *x, int i) {
+  if (x->energyLevels < 2) return x->minEnergy;
+  return x->minEnergy * pow(x->maxEnergy / x->minEnergy,
+                            i / (x->energyLevels - 1.0));
+}
+
+static double sizeLevel(const SDTGrainCache *x, int j) {
+  return (j + 1.0) / x->sizeLevels;
+}
+
+static SDTResonator *copyResonator(const SDTResonator *r) {
+  SDTResonator *y;
+
+  y = SDTResonator_new(SDTResonator_getNModes(r), SDTResonator_getNPickups(r));
+  SDTResonator_copy(y, r, 1);
+  SDTResonator_update(y);
+  return y;
+}
+
+/* Simulates a micro impact on private copies of the resonators, and keeps the
+   selected output until it decays below audibility */
+static void renderGrain(SDTGrainCache *x, int k) {
+  SDTResonator *obj0, *obj1;
+  SDTInteractor *impact;
+  double *outs[2 * SDT_RESONATOR_NPICKUPS_MAX],
+      frame[2 * SDT_RESONATOR_NPICKUPS_MAX], *buffer, energy, size, peak;
+  int i, length;
+
+  length = 0;
+  obj0 = x->impact ? SDTInteractor_getFirstResonator(x->impact) : NULL;
+  obj1 = x->impact ? SDTInteractor_getSecondResonator(x->impact) : NULL;
+  i = (int)(x->duration * SDT_sampleRate);
+  if (obj0 && obj1 && i > 0 &&
+      x->output <
+          SDTResonator_getNPickups(obj0) + SDTResonator_getNPickups(obj1)) {
+    length = i;
+    buffer = (double *)malloc(length * sizeof(double));
+    impact = SDTImpact_new();
+    SDTImpact_setStiffness(impact, SDTImpact_getStiffness(x->impact));
+    SDTImpact_setDissipation(impact, SDTImpact_getDissipation(x->impact));
+    SDTImpact_setShape(impact, SDTImpact_getShape(x->impact));
+    SDTInteractor_setFirstPoint(impact, SDTInteractor_getFirstPoint(x->impact));
+    SDTInteractor_setSecondPoint(impact,
+                                 SDTInteractor_getSecondPoint(x->impact));
+    obj0 = copyResonator(obj0);
+    obj1 = copyResonator(obj1);
+    SDTInteractor_setFirstResonator(impact, obj0);
+    SDTInteractor_setSecondResonator(impact, obj1);
+    energy = energyLevel(x, k / x->sizeLevels);
+    size = sizeLevel(x, k % x->sizeLevels);
+    SDTInteractor_dsp(impact, -energy, 0.0, size, 0.0, 0.0, size, frame);
+    buffer[0] = frame[x->output];
+    for (i = 0; i < 2 * SDT_RESONATOR_NPICKUPS_MAX; i++) outs[i] = NULL;
+    outs[x->output] = buffer + 1;
+    SDTInteractor_dspBlock(impact, NULL, outs, length - 1);
+    SDTImpact_free(impact);
+    SDTResonator_free(obj0);
+    SDTResonator_free(obj1);
+    // Trim the inaudible tail
+    peak = 0.0;
+    for (i = 0; i < length; i++) peak = fmax(peak, fabs(buffer[i]));
+    while (length > 0 && fabs(buffer[length - 1]) <= GRAIN_FLOOR * peak) {
+      length--;
+    }
+    // Not realloc(), which the memory tracker of debug builds would miss
+    if (length > 0) {
+      x->grains[k] = (double *)malloc(length * sizeof(double));
+      memcpy(x->grains[k], buffer, length * sizeof(double));
+    }
+    free(buffer);
+  }
+  x->lengths[k] = length;
+}
+
+void SDTGrainCache_render(SDTGrainCache *x) {
+  int k;
+
+  refresh(x);
+  for (k = 0; k < x->energyLevels * x->sizeLevels; k++) {
+    if (x->lengths[k] < 0) renderGrain(x, k);
+  }
+}
+
+void SDTGrainCache_trigger(SDTGrainCache *x, double energy, double size) {
+  double e;
+  int i, j, k, v;
+
+  if (!(energy > 0.0)) return;
+  refresh(x);
+  i = 0;
+  if (x->energyLevels > 1) {
+    e = log(energy / x->minEnergy) / log(x->maxEnergy / x->minEnergy);
+    i = SDT_clip(lround(e * (x->energyLevels - 1)), 0, x->energyLevels - 1);
+  }
+  j = SDT_clip(lround(size * x->sizeLevels) - 1, 0, x->sizeLevels - 1);
+  k = i * x->sizeLevels + j;
+  if (x->lengths[k] < 0) renderGrain(x, k);
+  if (!x->lengths[k]) return;
+  if (x->activeVoices < x->nVoices) {
+    v = x->activeVoices++;
+  } else {
+    // Steal the oldest voice
+    v = 0;
+    for (i = 1; i < x->nVoices; i++) {
+      if (x->voicePositions[i] > x->voicePositions[v]) v = i;
+    }
+  }
+  x->voiceGrains[v] = k;
+  x->voicePositions[v] = 0;
+  x->voiceGains[v] = energy / energyLevel(x, k / x->sizeLevels);
+}
+
+// Adds n samples of every playing grain, and releases the finished ones
+static void mix(SDTGrainCache *x, double *out, unsigned int n) {
+  const double *grain;
+  double g;
+  int v, k, p, m, i;
+
+  for (v = 0; v < x->activeVoices;) {
+    k = x->voiceGrains[v];
+    p = x->voicePositions[v];
+    g = x->voiceGains[v];
+    grain = x->grains[k] + p;
+    m = x->lengths[k] - p;
+    if (m > (int)n) m = n;
+    for (i = 0; i < m; i++) out[i] += g * grain[i];
+    x->voicePositions[v] += m;
+    if (x->voicePositions[v] < x->lengths[k]) {
+      v++;
+    } else {
+      x->activeVoices--;
+      x->voiceGrains[v] = x->voiceGrains[x->activeVoices];
+      x->voicePositions[v] = x->voicePositions[x->activeVoices];
+      x->voiceGains[v] = x->voiceGains[x->activeVoices];
+    }
+  }
+}
+
+double SDTGrainCache_dsp(SDTGrainCache *x, const double *ins) {
+  double out;
+
+  if (ins[0] > 0.0) SDTGrainCache_trigger(x, ins[0], ins[1]);
+  out = 0.0;
+  mix(x, &out, 1);
+  return out;
+}
+
+void SDTGrainCache_dspBlock(SDTGrainCache *x, const double *energy,
+                            const double *size, double *out, unsigned int n) {
+  unsigned int i, j;
+
+  for (i = 0; i < n; i++) out[i] = 0.0;
+  j = 0;
+  for (i = 0; energy && i < n; i++) {
+    if (energy[i] > 0.0) {
+      mix(x, out + j, i - j);
+      SDTGrainCache_trigger(x, energy[i], size[i]);
+      j = i;
+    }
+  }
+  mix(x, out + j, n - j);
 }
 
 //-------------------------------------------------------------------------------------//
@@ -1,4 +1,5 @@
 #include "SDTCommonMacros.h"
+#include "SDTInteractors.h"
 #include "SDTJSON.h"
 
 /** @file SDTControl.h
@@ -112,6 +113,16 @@ The loop should end when SDTBouncing_hasFinished() returns true.
 @return Impact velocity of the bounce */
 extern double SDTBouncing_dsp(SDTBouncing *x);
 
+/** @brief Skips ahead to the next bounce.
+Advances the bouncing process past its next impact, as if SDTBouncing_dsp()
+had been called once per sample up to and including the impact. Use it to
+schedule the impacts of a block or of an offline render without iterating
+over silent samples.
+@param[out] velocity Impact velocity of the bounce
+@return Number of silent samples before the bounce, or -1 if the process has
+finished */
+extern long SDTBouncing_nextEvent(SDTBouncing *x, double *velocity);
+
 /** @brief Checks if the bouncing process is finished, i.e. if the remaining
 energy is 0.
 @return 1 (true) if the remaining energy is <= 0, 0 (false) otherwise. */
@@ -229,6 +240,16 @@ The loop should end when SDTBreaking_hasFinished() returns true.
 @param[out] outs Pointer to the output array: impact energy and fragment size */
 extern void SDTBreaking_dsp(SDTBreaking *x, double *outs);
 
+/** @brief Skips ahead to the next micro impact.
+Advances the breaking process past its next micro impact, as if
+SDTBreaking_dsp() had been called once per sample up to and including the
+impact. The waiting time is drawn in a single step from a geometric
+distribution, and changing the granularity redraws it.
+@param[out] outs Pointer to the output array: impact energy and fragment size
+@return Number of silent samples before the impact, or -1 if the process has
+finished */
+extern long SDTBreaking_nextEvent(SDTBreaking *x, double *outs);
+
 /** @brief Checks if the breaking process is finished, i.e. if the remaining
 energy is 0.
 @return 1 (true) if the remaining energy is <= 0, 0 (false) otherwise. */
@@ -339,6 +360,150 @@ process can continue indefinitely until explicitly interrupted.
 @param[out] outs Pointer to the output array: impact energy and fragment size */
 extern void SDTCrumpling_dsp(SDTCrumpling *x, double *outs);
 
+/** @brief Skips ahead to the next micro impact.
+Advances the crumpling process past its next micro impact, as if
+SDTCrumpling_dsp() had been called once per sample up to and including the
+impact. The waiting time is drawn in a single step from a geometric
+distribution, and changing the granularity redraws it.
+@param[out] outs Pointer to the output array: impact energy and fragment size
+@return Number of silent samples before the impact, or -1 if the granularity
+is 0 */
+extern long SDTCrumpling_nextEvent(SDTCrumpling *x, double *outs);
+
+/** @} */
+
+/** @defgroup graincache Grain cache
+Plays the micro impacts of a breaking or crumpling process from a cache of
+pre-rendered grains, instead of simulating every contact. Each grain is the
+sound of an impact between two resonators at rest: the first one is hit with
+a single sample of force equal to minus the impact energy, and the fragment
+size of both is set to the event size, like in the crumpling~ help patch.
+Energies and sizes are quantized to a grid of levels. Each grain is rendered
+the first time it is needed, and is scaled by the ratio between the event
+energy and its level. Grains are mixed by overlap-add on a fixed number of
+voices, and the oldest voice is stolen when none is free.
+
+The impact parameters and the parameter revision of its resonators are
+checked at every event, and grains are rendered again after any change.
+External forces applied to the resonators of the impact do not affect the
+grains, which are rendered on private copies.
+
+Rendering simulates the impact for the whole duration of the grain, and
+allocates memory. Call SDTGrainCache_render() outside of the audio thread
+after creating the cache and after every change, otherwise missing grains are
+rendered by SDTGrainCache_trigger() inside the DSP cycle.
+@{ */
+
+/** @brief Opaque data structure for the grain cache. */
+typedef struct SDTGrainCache SDTGrainCache;
+
+/** @brief Object constructor.
+@param[in] nVoices Maximum number of overlapping grains
+@return Pointer to the new instance */
+extern SDTGrainCache *SDTGrainCache_new(unsigned int nVoices);
+
+/** @brief Object destructor.
+@param[in] x Pointer to the instance to destroy */
+extern void SDTGrainCache_free(SDTGrainCache *x);
+
+/** @brief Gets the impact rendering the grains.
+@return Impact interactor, or NULL */
+extern SDTInteractor *SDTGrainCache_getImpact(const SDTGrainCache *x);
+
+/** @brief Gets the output rendered in the grains.
+@return Output index, as in the outputs of SDTInteractor_dsp() */
+extern int SDTGrainCache_getOutput(const SDTGrainCache *x);
+
+/** @brief Gets the duration of the grains.
+@return Grain duration, in s */
+extern double SDTGrainCache_getDuration(const SDTGrainCache *x);
+
+/** @brief Gets the lowest energy level.
+@return Energy of the lowest level */
+extern double SDTGrainCache_getMinEnergy(const SDTGrainCache *x);
+
+/** @brief Gets the highest energy level.
+@return Energy of the highest level */
+extern double SDTGrainCache_getMaxEnergy(const SDTGrainCache *x);
+
+/** @brief Gets the number of energy levels.
+@return Number of energy levels */
+extern int SDTGrainCache_getEnergyLevels(const SDTGrainCache *x);
+
+/** @brief Gets the number of fragment size levels.
+@return Number of fragment size levels */
+extern int SDTGrainCache_getSizeLevels(const SDTGrainCache *x);
+
+/** @brief Gets the number of grains playing.
+@return Number of busy voices */
+extern int SDTGrainCache_getActiveVoices(const SDTGrainCache *x);
+
+/** @brief Sets the impact rendering the grains.
+The impact must be connected to two resonators.
+@param[in] p Impact interactor */
+extern void SDTGrainCache_setImpact(SDTGrainCache *x, SDTInteractor *p);
+
+/** @brief Sets the output rendered in the grains.
+@param[in] i Output index, as in the outputs of SDTInteractor_dsp() */
+extern void SDTGrainCache_setOutput(SDTGrainCache *x, int i);
+
+/** @brief Sets the duration of the grains.
+Grains are shortened when their tail falls below audibility.
+@param[in] f Grain duration, in s */
+extern void SDTGrainCache_setDuration(SDTGrainCache *x, double f);
+
+/** @brief Sets the lowest energy level.
+@param[in] f Energy of the lowest level */
+extern void SDTGrainCache_setMinEnergy(SDTGrainCache *x, double f);
+
+/** @brief Sets the highest energy level.
+@param[in] f Energy of the highest level */
+extern void SDTGrainCache_setMaxEnergy(SDTGrainCache *x, double f);
+
+/** @brief Sets the number of energy levels.
+Levels are spaced logarithmically between the lowest and highest energy.
+@param[in] i Number of energy levels */
+extern void SDTGrainCache_setEnergyLevels(SDTGrainCache *x, int i);
+
+/** @brief Sets the number of fragment size levels.
+Levels are spaced linearly in ]0, 1].
+@param[in] i Number of fragment size levels */
+extern void SDTGrainCache_setSizeLevels(SDTGrainCache *x, int i);
+
+/** @brief Discards all the rendered grains. */
+extern void SDTGrainCache_invalidate(SDTGrainCache *x);
+
+/** @brief Renders all the grains that are not in the cache.
+Call this function outside of the audio thread, ahead of playback, to avoid
+rendering on the first occurrence of each grain. This function allocates
+memory and should not be called inside a DSP cycle. */
+extern void SDTGrainCache_render(SDTGrainCache *x);
+
+/** @brief Starts playing the grain of a micro impact.
+A grain missing from the cache is rendered on the spot, which is only
+real-time safe after SDTGrainCache_render() has filled the cache.
+@param[in] energy Impact energy
+@param[in] size Fragment size [0, 1] */
+extern void SDTGrainCache_trigger(SDTGrainCache *x, double energy,
+                                  double size);
+
+/** @brief Signal processing routine.
+Call this function at sample rate, with the outputs of SDTBreaking_dsp() or
+SDTCrumpling_dsp() as inputs.
+@param[in] ins Pointer to the input array: impact energy and fragment size
+@return Mix of the playing grains */
+extern double SDTGrainCache_dsp(SDTGrainCache *x, const double *ins);
+
+/** @brief Block signal processing routine.
+Equivalent to calling SDTGrainCache_dsp() once per sample for n samples.
+@param[in] energy Impact energy, n samples. Can be NULL for no events
+@param[in] size Fragment size, n samples
+@param[out] out Mix of the playing grains, n samples
+@param[in] n Number of samples */
+extern void SDTGrainCache_dspBlock(SDTGrainCache *x, const double *energy,
+                                   const double *size, double *out,
+                                   unsigned int n);
+
 /** @} */
 
 /** @defgroup rolling Rolling
@@ -1,7 +1,9 @@
 #include "SDTGases.h"
 
+#include <limits.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "SDTCommon.h"
 #include "SDTEffects.h"
@@ -289,28 +291,86 @@ double SDTWindKarman_dsp(SDTWindKarman *x) {
 
 //-------------------------------------------------------------------------------------//
 
+// Length of the chunks of the delay lines, in samples
+#define EXPLOSION_CHUNK 1024
+// Chunks are not allocated for writes below this magnitude
+#define EXPLOSION_SILENCE 1e-12
+
 struct SDTExplosion {
   SDTReverb *scatter;
   SDTTwoPoles *wave, *wind;
-  double *waveBuf, *windBuf, blastTime, scatterTime, dispersion, distance,
-      waveSpeed, windSpeed, time;
-  long i, waveDelay, windDelay, size;
+  /* Delay lines, split into chunks which are only allocated while they hold
+     sound. Chunks which are read through go back to a pool of free chunks. */
+  double **waveChunks, **windChunks, **freeChunks, blastTime, scatterTime,
+      dispersion, distance, waveSpeed, windSpeed, time;
+  long i, waveDelay, windDelay, size, nChunks, nFree;
 };
 
+/* The ring is one chunk longer than the maximum delay, so that writes never
+   land behind the read position in the chunk being read */
+static void allocateChunks(SDTExplosion *x, long maxDelay) {
+  x->size = maxDelay > 0 ? maxDelay : 0;
+  x->nChunks = (x->size + EXPLOSION_CHUNK - 1) / EXPLOSION_CHUNK + 1;
+  x->waveChunks = (double **)calloc(x->nChunks, sizeof(double *));
+  x->windChunks = (double **)calloc(x->nChunks, sizeof(double *));
+  x->freeChunks = (double **)malloc(2 * x->nChunks * sizeof(double *));
+  x->nFree = 0;
+  x->i = 0;
+}
+
+static void freeChunks(SDTExplosion *x) {
+  long k;
+
+  for (k = 0; k < x->nChunks; k++) {
+    if (x->waveChunks[k]) free(x->waveChunks[k]);
+    if (x->windChunks[k]) free(x->windChunks[k]);
+  }
+  for (k = 0; k < x->nFree; k++) free(x->freeChunks[k]);
+  free(x->waveChunks);
+  free(x->windChunks);
+  free(x->freeChunks);
+}
+
+// Adds a sample to a delay line, at the given position in the ring
+static void delayWrite(SDTExplosion *x, double **chunks, long j, double v) {
+  double **chunk;
+
+  chunk = &chunks[j / EXPLOSION_CHUNK];
+  if (!*chunk) {
+    if (fabs(v) < EXPLOSION_SILENCE) return;
+    // Free chunks were zeroed while being read
+    *chunk = x->nFree > 0 ? x->freeChunks[--x->nFree]
+                          : (double *)calloc(EXPLOSION_CHUNK, sizeof(double));
+  }
+  (*chunk)[j % EXPLOSION_CHUNK] += v;
+}
+
+/* Reads and clears the sample at the read position of a delay line, and
+   releases the chunk after its last sample */
+static double delayRead(SDTExplosion *x, double **chunks) {
+  double **chunk, result;
+  long j;
+
+  chunk = &chunks[x->i / EXPLOSION_CHUNK];
+  if (!*chunk) return 0.0;
+  j = x->i % EXPLOSION_CHUNK;
+  result = (*chunk)[j];
+  (*chunk)[j] = 0.0;
+  if (j == EXPLOSION_CHUNK - 1) {
+    x->freeChunks[x->nFree++] = *chunk;
+    *chunk = NULL;
+  }
+  return result;
+}
+
 SDTExplosion *SDTExplosion_new(long maxScatter, long maxDelay) {
   SDTExplosion *x;
-  long i;
 
   x = (SDTExplosion *)malloc(sizeof(SDTExplosion));
   x->scatter = SDTReverb_new(maxScatter);
   x->wave = SDTTwoPoles_new();
   x->wind = SDTTwoPoles_new();
-  x->waveBuf = (double *)malloc(maxDelay * sizeof(double));
-  x->windBuf = (double *)malloc(maxDelay * sizeof(double));
-  for (i = 0; i < maxDelay; i++) {
-    x->waveBuf[i] = 0.0;
-    x->windBuf[i] = 0.0;
-  }
+  allocateChunks(x, maxDelay);
   x->blastTime = 0.0;
   x->scatterTime = 0.0;
   x->dispersion = 0.0;
@@ -318,10 +378,8 @@ SDTExplosion *SDTExplosion_new(long maxScatter, long maxDelay) {
   x->waveSpeed = 0.0;
   x->windSpeed = 0.0;
   x->time = 1000000.0;
-  x->i = 0;
   x->waveDelay = 0;
   x->windDelay = 0;
-  x->size = maxDelay;
   return x;
 }
 
@@ -329,8 +387,7 @@ void SDTExplosion_free(SDTExplosion *x) {
   SDTReverb_free(x->scatter);
   SDTTwoPoles_free(x->wave);
   SDTTwoPoles_free(x->wind);
-  free(x->waveBuf);
-  free(x->windBuf);
+  freeChunks(x);
   free(x);
 }
 
@@ -340,11 +397,8 @@ void SDTExplosion_setMaxScatter(SDTExplosion *x, long f) {
 }
 
 void SDTExplosion_setMaxDelay(SDTExplosion *x, long f) {
-  free(x->waveBuf);
-  free(x->windBuf);
-  x->waveBuf = calloc(f, sizeof(double));
-  x->windBuf = calloc(f, sizeof(double));
-  x->size = f;
+  freeChunks(x);
+  allocateChunks(x, f);
 }
 
 _SDT_COPY_FUNCTION(Explosion)
@@ -453,15 +507,33 @@ void SDTExplosion_setWindSpeed(SDTExplosion *x, double f) {
 
 void SDTExplosion_update(SDTExplosion *x) { SDTExplosion_trigger(x); }
 
+// Configures the reverb scattering the blast
+static void setupScatter(SDTReverb *r, double scatterTime) {
+  SDTReverb_setXSize(r, 0.01 * SDT_MACH1 * scatterTime);
+  SDTReverb_setYSize(r, 0.01 * SDT_MACH1 * scatterTime);
+  SDTReverb_setZSize(r, 0.01 * SDT_MACH1 * scatterTime);
+  SDTReverb_setRandomness(r, 1.0);
+  SDTReverb_setTime(r, scatterTime);
+  SDTReverb_setTime1k(r, 0.9 * scatterTime);
+  SDTReverb_update(r);
+}
+
+// Friedlander waveform of the blast, at the given time
+static double blastWave(double blastTime, double time) {
+  double zeroCross;
+
+  zeroCross = blastTime == 0.0 ? 1.0 : time / blastTime;
+  return exp(-zeroCross) * (1.0 - zeroCross);
+}
+
+// Cutoff of the lowpass filter shaping the shockwave at a distance
+static double waveCutoff(double distance) {
+  return fmin(20000.0, 20000.0 / sqrt(distance));
+}
+
 void SDTExplosion_trigger(SDTExplosion *x) {
-  SDTReverb_setXSize(x->scatter, 0.01 * SDT_MACH1 * x->scatterTime);
-  SDTReverb_setYSize(x->scatter, 0.01 * SDT_MACH1 * x->scatterTime);
-  SDTReverb_setZSize(x->scatter, 0.01 * SDT_MACH1 * x->scatterTime);
-  SDTReverb_setRandomness(x->scatter, 1.0);
-  SDTReverb_setTime(x->scatter, x->scatterTime);
-  SDTReverb_setTime1k(x->scatter, 0.9 * x->scatterTime);
-  SDTReverb_update(x->scatter);
-  SDTTwoPoles_lowpass(x->wave, fmin(20000.0, 20000.0 / sqrt(x->distance)));
+  setupScatter(x->scatter, x->scatterTime);
+  SDTTwoPoles_lowpass(x->wave, waveCutoff(x->distance));
   SDTTwoPoles_resonant(x->wind, 800.0, 1.0);
   x->waveDelay = fmin(x->distance * SDT_sampleRate / x->waveSpeed, x->size);
   x->windDelay = fmin(x->distance * SDT_sampleRate / x->windSpeed, x->size);
@@ -469,28 +541,295 @@ void SDTExplosion_trigger(SDTExplosion *x) {
 }
 
 void SDTExplosion_dsp(SDTExplosion *x, double *outs) {
-  double zeroCross, blast, scatter, wave, wind;
-  long waveI, windI;
+  double blast, scatter, wave, wind;
 
-  zeroCross = x->blastTime == 0.0 ? 1.0 : x->time / x->blastTime;
-  blast = exp(-zeroCross) * (1.0 - zeroCross);
+  blast = blastWave(x->blastTime, x->time);
   scatter = SDTReverb_dsp(x->scatter, blast);
   wave = SDTTwoPoles_dsp(
       x->wave, (1.0 - x->dispersion) * blast + x->dispersion * scatter);
   wind = SDTTwoPoles_dsp(x->wind, SDT_whiteNoise() * wave);
 
   if (x->waveDelay < x->size) {
-    waveI = (x->i + x->waveDelay) % x->size;
-    x->waveBuf[waveI] += wave;
+    delayWrite(x, x->waveChunks,
+               (x->i + x->waveDelay) % (x->nChunks * EXPLOSION_CHUNK), wave);
   }
   if (x->windDelay < x->size) {
-    windI = (x->i + x->windDelay) % x->size;
-    x->windBuf[windI] += wind;
+    delayWrite(x, x->windChunks,
+               (x->i + x->windDelay) % (x->nChunks * EXPLOSION_CHUNK), wind);
   }
-  outs[0] = x->waveBuf[x->i];
-  outs[1] = x->windBuf[x->i];
-  x->waveBuf[x->i] = 0.0;
-  x->windBuf[x->i] = 0.0;
+  outs[0] = delayRead(x, x->waveChunks);
+  outs[1] = delayRead(x, x->windChunks);
   x->time += SDT_timeStep;
-  x->i = (x->i + 1) % x->size;
+  x->i = (x->i + 1) % (x->nChunks * EXPLOSION_CHUNK);
+}
+
+//-------------------------------------------------------------------------------------//
+
+#define EXPLOSION_FLOOR 1e-4
+#define EXPLOSION_SIGNATURE 6
+
+struct SDTExplosionCache {
+  SDTExplosion *explosion;
+  /* Blast and scattering, before the filters depending on the distance.
+     A negative length marks a source which is not rendered yet. */
+  double *source, signature[EXPLOSION_SIGNATURE], *voiceGains;
+  SDTTwoPoles **waveFilters, **windLowpass, **windFilters;
+  long *voicePositions, *waveDelays, *windDelays, *voiceEnds, length;
+  int nVoices, activeVoices;
+};
+
+SDTExplosionCache *SDTExplosionCache_new(unsigned int nVoices) {
+  SDTExplosionCache *x;
+  int v;
+
+  x = (SDTExplosionCache *)malloc(sizeof(SDTExplosionCache));
+  x->explosion = NULL;
+  x->source = NULL;
+  memset(x->signature, 0, EXPLOSION_SIGNATURE * sizeof(double));
+  x->length = -1;
+  x->nVoices = nVoices > 0 ? nVoices : 1;
+  x->activeVoices = 0;
+  x->voiceGains = (double *)malloc(x->nVoices * sizeof(double));
+  x->voicePositions = (long *)malloc(x->nVoices * sizeof(long));
+  x->waveDelays = (long *)malloc(x->nVoices * sizeof(long));
+  x->windDelays = (long *)malloc(x->nVoices * sizeof(long));
+  x->voiceEnds = (long *)malloc(x->nVoices * sizeof(long));
+  x->waveFilters = (SDTTwoPoles **)malloc(x->nVoices * sizeof(SDTTwoPoles *));
+  x->windLowpass = (SDTTwoPoles **)malloc(x->nVoices * sizeof(SDTTwoPoles *));
+  x->windFilters = (SDTTwoPoles **)malloc(x->nVoices * sizeof(SDTTwoPoles *));
+  for (v = 0; v < x->nVoices; v++) {
+    x->waveFilters[v] = SDTTwoPoles_new();
+    x->windLowpass[v] = SDTTwoPoles_new();
+    x->windFilters[v] = SDTTwoPoles_new();
+  }
+  return x;
+}
+
+void SDTExplosionCache_free(SDTExplosionCache *x) {
+  int v;
+
+  SDTExplosionCache_invalidate(x);
+  for (v = 0; v < x->nVoices; v++) {
+    SDTTwoPoles_free(x->waveFilters[v]);
+    SDTTwoPoles_free(x->windLowpass[v]);
+    SDTTwoPoles_free(x->windFilters[v]);
+  }
+  free(x->voiceGains);
+  free(x->voicePositions);
+  free(x->waveDelays);
+  free(x->windDelays);
+  free(x->voiceEnds);
+  free(x->waveFilters);
+  free(x->windLowpass);
+  free(x->windFilters);
+  free(x);
+}
+
+SDTExplosion *SDTExplosionCache_getExplosion(const SDTExplosionCache *x) {
+  return x->explosion;
+}
+
+long SDTExplosionCache_getLength(const SDTExplosionCache *x) {
+  return x->length > 0 ? x->length : 0;
+}
+
+int SDTExplosionCache_getActiveVoices(const SDTExplosionCache *x) {
+  return x->activeVoices;
+}
+
+void SDTExplosionCache_setExplosion(SDTExplosionCache *x, SDTExplosion *p) {
+  x->explosion = p;
+  SDTExplosionCache_invalidate(x);
+}
+
+void SDTExplosionCache_invalidate(SDTExplosionCache *x) {
+  // Playing explosions are stopped too
+  x->activeVoices = 0;
+  if (x->source) free(x->source);
+  x->source = NULL;
+  x->length = -1;
+}
+
+// Invalidates the source if the explosion changed
+static void refreshExplosion(SDTExplosionCache *x) {
+  double s[EXPLOSION_SIGNATURE];
+  SDTExplosion *e;
+
+  e = x->explosion;
+  s[0] = SDT_timeStep;
+  s[1] = e != NULL;
+  s[2] = e ? e->blastTime : 0.0;
+  s[3] = e ? e->scatterTime : 0.0;
+  s[4] = e ? e->dispersion : 0.0;
+  s[5] = e ? SDTReverb_getMaxDelay(e->scatter) : 0.0;
+  if (memcmp(s, x->signature, EXPLOSION_SIGNATURE * sizeof(double))) {
+    memcpy(x->signature, s, EXPLOSION_SIGNATURE * sizeof(double));
+    SDTExplosionCache_invalidate(x);
+  }
+}
+
+/* Renders the blast and its scattering on a private reverb, like
+   SDTExplosion_dsp(), until they decay below audibility. The blast vanishes
+   within a few tens of blast times, and the scattering within two
+   reverberation times. */
+static void renderExplosion(SDTExplosionCache *x) {
+  SDTExplosion *e;
+  SDTReverb *scatter;
+  double *buffer, blast, peak;
+  long i, length;
+
+  length = 0;
+  e = x->explosion;
+  if (e) {
+    length = (long)(SDT_sampleRate *
+                    (16.0 * e->blastTime + 2.0 * e->scatterTime));
+  }
+  if (length > 0) {
+    buffer = (double *)malloc(length * sizeof(double));
+    scatter = SDTReverb_new(SDTReverb_getMaxDelay(e->scatter));
+    setupScatter(scatter, e->scatterTime);
+    for (i = 0; i < length; i++) {
+      blast = blastWave(e->blastTime, i * SDT_timeStep);
+      buffer[i] = (1.0 - e->dispersion) * blast +
+                  e->dispersion * SDTReverb_dsp(scatter, blast);
+    }
+    SDTReverb_free(scatter);
+    // Trim the inaudible tail
+    peak = 0.0;
+    for (i = 0; i < length; i++) peak = fmax(peak, fabs(buffer[i]));
+    while (length > 0 && fabs(buffer[length - 1]) <= EXPLOSION_FLOOR * peak) {
+      length--;
+    }
+    // Not realloc(), which the memory tracker of debug builds would miss
+    if (length > 0) {
+      x->source = (double *)malloc(length * sizeof(double));
+      memcpy(x->source, buffer, length * sizeof(double));
+    }
+    free(buffer);
+  }
+  x->length = length;
+}
+
+void SDTExplosionCache_render(SDTExplosionCache *x) {
+  refreshExplosion(x);
+  if (x->length < 0) renderExplosion(x);
+}
+
+// Delay of a front travelling at the given speed, or -1 if it never arrives
+static long frontDelay(double distance, double speed) {
+  double d;
+
+  d = distance * SDT_sampleRate / speed;
+  return d < LONG_MAX / 2 ? (long)d : -1;
+}
+
+void SDTExplosionCache_trigger(SDTExplosionCache *x, double distance,
+                               double gain) {
+  double cutoff;
+  long waveDelay, windDelay, ring;
+  int v, i;
+
+  distance = fmax(0.0, distance);
+  SDTExplosionCache_render(x);
+  if (!x->length) return;
+  waveDelay = frontDelay(distance, x->explosion->waveSpeed);
+  windDelay = frontDelay(distance, x->explosion->windSpeed);
+  if (waveDelay < 0 && windDelay < 0) return;
+  if (x->activeVoices < x->nVoices) {
+    v = x->activeVoices++;
+  } else {
+    // Steal the oldest voice
+    v = 0;
+    for (i = 1; i < x->nVoices; i++) {
+      if (x->voicePositions[i] > x->voicePositions[v]) v = i;
+    }
+  }
+  /* The filters are not reset, as in SDTExplosion_trigger(), so that a stolen
+     voice does not click */
+  cutoff = waveCutoff(distance);
+  SDTTwoPoles_lowpass(x->waveFilters[v], cutoff);
+  SDTTwoPoles_lowpass(x->windLowpass[v], cutoff);
+  SDTTwoPoles_resonant(x->windFilters[v], 800.0, 1.0);
+  x->voiceGains[v] = gain;
+  x->voicePositions[v] = 0;
+  x->waveDelays[v] = waveDelay;
+  x->windDelays[v] = windDelay;
+  /* Voices last until both fronts have passed, and the filters have rung for
+     ten times their slowest time constant */
+  ring = (long)ceil(10.0 * SDT_sampleRate / (SDT_PI * fmin(cutoff, 800.0)));
+  x->voiceEnds[v] = (waveDelay > windDelay ? waveDelay : windDelay) +
+                    x->length + ring;
+}
+
+// Adds n samples of every playing explosion, and releases the finished ones
+static void mixExplosions(SDTExplosionCache *x, double *wave, double *wind,
+                          long n) {
+  SDTTwoPoles *waveFilter, *windLowpass, *windFilter;
+  const double *source;
+  double g, in;
+  long p, t, m, i, length;
+  int v;
+
+  source = x->source;
+  length = x->length;
+  for (v = 0; v < x->activeVoices;) {
+    p = x->voicePositions[v];
+    g = x->voiceGains[v];
+    m = x->voiceEnds[v] - p;
+    if (m > n) m = n;
+    waveFilter = x->waveFilters[v];
+    windLowpass = x->windLowpass[v];
+    windFilter = x->windFilters[v];
+    // Each front is silent until it reaches the listener
+    if (x->waveDelays[v] >= 0) {
+      t = p - x->waveDelays[v];
+      for (i = t < 0 ? -t : 0; i < m; i++) {
+        in = t + i < length ? source[t + i] : 0.0;
+        wave[i] += g * SDTTwoPoles_dsp(waveFilter, in);
+      }
+    }
+    if (x->windDelays[v] >= 0) {
+      t = p - x->windDelays[v];
+      for (i = t < 0 ? -t : 0; i < m; i++) {
+        in = t + i < length ? source[t + i] : 0.0;
+        in = SDT_whiteNoise() * SDTTwoPoles_dsp(windLowpass, in);
+        wind[i] += g * SDTTwoPoles_dsp(windFilter, in);
+      }
+    }
+    x->voicePositions[v] += m;
+    if (x->voicePositions[v] < x->voiceEnds[v]) {
+      v++;
+      continue;
+    }
+    // Filters are swapped with the last voice, instead of copied
+    x->activeVoices--;
+    x->voiceGains[v] = x->voiceGains[x->activeVoices];
+    x->voicePositions[v] = x->voicePositions[x->activeVoices];
+    x->waveDelays[v] = x->waveDelays[x->activeVoices];
+    x->windDelays[v] = x->windDelays[x->activeVoices];
+    x->voiceEnds[v] = x->voiceEnds[x->activeVoices];
+    x->waveFilters[v] = x->waveFilters[x->activeVoices];
+    x->windLowpass[v] = x->windLowpass[x->activeVoices];
+    x->windFilters[v] = x->windFilters[x->activeVoices];
+    x->waveFilters[x->activeVoices] = waveFilter;
+    x->windLowpass[x->activeVoices] = windLowpass;
+    x->windFilters[x->activeVoices] = windFilter;
+  }
+}
+
+void SDTExplosionCache_dsp(SDTExplosionCache *x, double *outs) {
+  outs[0] = 0.0;
+  outs[1] = 0.0;
+  mixExplosions(x, &outs[0], &outs[1], 1);
+}
+
+void SDTExplosionCache_dspBlock(SDTExplosionCache *x, double *wave,
+                                double *wind, unsigned int n) {
+  unsigned int i;
+
+  for (i = 0; i < n; i++) {
+    wave[i] = 0.0;
+    wind[i] = 0.0;
+  }
+  mixExplosions(x, wave, wind, n);
 }
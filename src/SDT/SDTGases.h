@@ -339,6 +339,9 @@ typedef struct SDTExplosion SDTExplosion;
 #define SDT_EXPLOSION_MAX_DELAY_DEFAULT 441000
 
 /** @brief Object constructor.
+The delays between explosion and sound are stored in chunks, which are only
+allocated while they hold sound. Memory therefore follows the duration of the
+sound on its way to the listener, rather than the maximum delay.
 @param[in] maxScatter Maximum scattering time, in samples
 @param[in] maxDelay Maximum delay between explosion and sound, in samples
 @return Pointer to the new instance */
@@ -479,6 +482,90 @@ extern void SDTExplosion_dsp(SDTExplosion *x, double *outs);
 
 /** @} */
 
+/** @defgroup explosioncache Explosion cache
+Plays many explosions sharing the same preset from a pre-rendered source,
+instead of running the scattering network for every blast. The source is the
+blast and its scattering, which only depend on the blast time, the scattering
+time and the dispersion, and is rendered once until it decays below
+audibility. Each explosion then plays the source back with its own distance,
+which sets the delays of the shockwave and the blast wind, and the lowpass
+filter shaping both. The filters and the noise modulating the wind are still
+computed for every explosion, and are much cheaper than the scattering.
+
+The parameters of the explosion are checked at every trigger, and the source
+is rendered again after any change. Explosions are mixed on a fixed number of
+voices, and the oldest voice is stolen when none is free. Since the delays are
+just counters, the memory of the cache does not depend on the distance.
+
+Rendering runs the scattering network until the source decays, and allocates
+memory. Call SDTExplosionCache_render() outside of the audio thread after
+setting the preset and after every change, otherwise the source is rendered by
+SDTExplosionCache_trigger() inside the DSP cycle.
+@{ */
+
+/** @brief Opaque data structure for the explosion cache. */
+typedef struct SDTExplosionCache SDTExplosionCache;
+
+/** @brief Object constructor.
+@param[in] nVoices Maximum number of overlapping explosions
+@return Pointer to the new instance */
+extern SDTExplosionCache *SDTExplosionCache_new(unsigned int nVoices);
+
+/** @brief Object destructor.
+@param[in] x Pointer to the instance to destroy */
+extern void SDTExplosionCache_free(SDTExplosionCache *x);
+
+/** @brief Gets the explosion providing the preset.
+@return Explosion, or NULL */
+extern SDTExplosion *SDTExplosionCache_getExplosion(const SDTExplosionCache *x);
+
+/** @brief Gets the length of the rendered source.
+@return Length of the source, in samples. 0 if not rendered */
+extern long SDTExplosionCache_getLength(const SDTExplosionCache *x);
+
+/** @brief Gets the number of explosions playing.
+@return Number of busy voices */
+extern int SDTExplosionCache_getActiveVoices(const SDTExplosionCache *x);
+
+/** @brief Sets the explosion providing the preset.
+Blast time, scattering time, dispersion, maximum scattering time and the speeds
+of the shockwave and blast wind are read from it. Its distance is ignored.
+@param[in] p Explosion */
+extern void SDTExplosionCache_setExplosion(SDTExplosionCache *x,
+                                           SDTExplosion *p);
+
+/** @brief Discards the rendered source, and stops all the explosions. */
+extern void SDTExplosionCache_invalidate(SDTExplosionCache *x);
+
+/** @brief Renders the source if it is not in the cache.
+Call this function outside of the audio thread, ahead of playback, to avoid
+rendering on the first trigger. This function allocates memory and should not
+be called inside a DSP cycle. */
+extern void SDTExplosionCache_render(SDTExplosionCache *x);
+
+/** @brief Starts playing an explosion.
+A source missing from the cache is rendered on the spot, which is only
+real-time safe after SDTExplosionCache_render() has filled the cache.
+@param[in] distance Distance between explosion and listener, in m
+@param[in] gain Amplitude of the explosion */
+extern void SDTExplosionCache_trigger(SDTExplosionCache *x, double distance,
+                                      double gain);
+
+/** @brief Signal processing routine.
+Call this function at sample rate to mix the playing explosions.
+@param[out] outs Pointer to the output array: shockwave and blast wind */
+extern void SDTExplosionCache_dsp(SDTExplosionCache *x, double *outs);
+
+/** @brief Block signal processing routine.
+Equivalent to calling SDTExplosionCache_dsp() once per sample for n samples.
+@param[out] wave Shockwave, n samples
+@param[out] wind Blast wind, n samples
+@param[in] n Number of samples */
+extern void SDTExplosionCache_dspBlock(SDTExplosionCache *x, double *wave,
+                                       double *wind, unsigned int n);
+
+/** @} */
+
 #ifdef __cplusplus
 };
 #endif
@@ -1,6 +1,8 @@
 #include "SDTInteractors.h"
 
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 
 #include "SDTCommon.h"
@@ -10,6 +12,8 @@
 
 #define MAX_ERROR 0.001
 #define MAX_ITERATIONS 50
+#define MAX_SUBSTEPS 16
+#define N_INPUTS 6
 
 #define SDT_INTERACTOR Interactor
 #define SDT_INTERACTOR_ATTRIBUTES(T, A)                 \
@@ -37,13 +41,28 @@
 struct SDTInteractor {
   SDTResonator *obj0, *obj1;
   long contact0, contact1;
-  double energy;
+  double energy, ins[N_INPUTS], outs[2 * SDT_RESONATOR_NPICKUPS_MAX];
+  double **buffers;
+  unsigned long fallbacks;
+  /* A sleeping interactor skips the force computation, until the revision
+     of either resonator changes */
+  unsigned long revision0, revision1;
+  int asleep;
   void *state;
   double (*computeForce)(SDTInteractor *x);
 };
 
+/* Incremented whenever the interaction graph changes, and read by the
+   schedulers on the audio thread */
+static atomic_ulong graphVersion = 0;
+
+// Force functions, called directly by the specialized block routines
+double SDTImpact_MarhefkaOrin(SDTInteractor *x);
+double SDTFriction_ElastoPlastic(SDTInteractor *x);
+
 SDTInteractor *SDTInteractor_new() {
   SDTInteractor *x;
+  int i;
 
   x = (SDTInteractor *)malloc(sizeof(SDTInteractor));
   x->obj0 = NULL;
@@ -51,6 +70,17 @@ SDTInteractor *SDTInteractor_new() {
   x->contact0 = 0;
   x->contact1 = 0;
   x->energy = 0.0;
+  x->fallbacks = 0;
+  x->revision0 = 0;
+  x->revision1 = 0;
+  x->asleep = 0;
+  for (i = 0; i < N_INPUTS; i++) {
+    x->ins[i] = 0.0;
+  }
+  for (i = 0; i < 2 * SDT_RESONATOR_NPICKUPS_MAX; i++) {
+    x->outs[i] = 0.0;
+  }
+  x->buffers = NULL;
   x->state = NULL;
   x->computeForce = NULL;
   return x;
@@ -66,15 +96,25 @@ void SDTInteractor_free(SDTInteractor *x) {
 
 void SDTInteractor_setFirstResonator(SDTInteractor *x, SDTResonator *p) {
   x->obj0 = p;
+  x->asleep = 0;
+  atomic_fetch_add(&graphVersion, 1);
 }
 
 void SDTInteractor_setSecondResonator(SDTInteractor *x, SDTResonator *p) {
   x->obj1 = p;
+  x->asleep = 0;
+  atomic_fetch_add(&graphVersion, 1);
 }
 
-void SDTInteractor_setFirstPoint(SDTInteractor *x, long l) { x->contact0 = l; }
+void SDTInteractor_setFirstPoint(SDTInteractor *x, long l) {
+  x->contact0 = l;
+  x->asleep = 0;
+}
 
-void SDTInteractor_setSecondPoint(SDTInteractor *x, long l) { x->contact1 = l; }
+void SDTInteractor_setSecondPoint(SDTInteractor *x, long l) {
+  x->contact1 = l;
+  x->asleep = 0;
+}
 
 SDTResonator *SDTInteractor_getFirstResonator(const SDTInteractor *x) {
   return x->obj0;
@@ -90,11 +130,16 @@ long SDTInteractor_getSecondPoint(const SDTInteractor *x) {
   return x->contact1;
 }
 
-double SDTInteractor_computeForce(SDTInteractor *x) {
-  double f, h, w, f0, f1;
+unsigned long SDTInteractor_getFallbacks(const SDTInteractor *x) {
+  return x->fallbacks;
+}
+
+int SDTInteractor_isAsleep(const SDTInteractor *x) { return x->asleep; }
+
+static double computeForceIterative(SDTInteractor *x, double f) {
+  double h, w, f0, f1;
   int count;
 
-  f = x->computeForce(x);
   h = SDTResonator_computeEnergy(x->obj0, x->contact0, 0.0) +
       SDTResonator_computeEnergy(x->obj1, x->contact1, 0.0) + x->energy;
   w = SDTResonator_computeEnergy(x->obj0, x->contact0, f) +
@@ -118,16 +163,55 @@ double SDTInteractor_computeForce(SDTInteractor *x) {
   return f;
 }
 
-void SDTInteractor_dsp(SDTInteractor *x, double f0, double v0, double s0,
-                       double f1, double v1, double s1, double *outs) {
-  double f, p;
-  long pickup, nPickups0, nPickups1;
+// Limits a force so that the interaction does not add energy to the system
+static double limitForce(SDTInteractor *x, double f) {
+  double a0, b0, c0, a1, b1, c1, b, c, e, s, u, w;
+
+  if (SDTResonator_computeEnergyCoefficients(x->obj0, x->contact0, f, &a0,
+                                             &b0, &c0) ||
+      SDTResonator_computeEnergyCoefficients(x->obj1, x->contact1, f, &a1,
+                                             &b1, &c1)) {
+    x->fallbacks++;
+    return computeForceIterative(x, f);
+  }
+  /* Energy excess of the interaction as a function of the force,
+     w(f) = b * f + c * f^2 - e, with w(0) = -e <= 0 and c >= 0.
+     If the computed force adds energy, reduce it to the root of w(f) lying
+     between 0 and f, which is the limit of the bisection method. */
+  b = b0 - b1;
+  c = c0 + c1;
+  e = x->energy;
+  w = f * (b + c * f) - e;
+  if (w > 0.0) {
+    s = f < 0.0 ? -1.0 : 1.0;
+    e = fmax(e, 0.0);
+    if (s * b < 0.0)
+      u = (sqrt(b * b + 4.0 * c * e) - s * b) / (2.0 * c);
+    else if (e > 0.0)
+      u = 2.0 * e / (s * b + sqrt(b * b + 4.0 * c * e));
+    else
+      u = 0.0;
+    f = s * SDT_fclip(u, 0.0, fabs(f));
+    w = f * (b + c * f) - x->energy;
+  }
+  x->energy = -w;
+  return f;
+}
+
+double SDTInteractor_computeForce(SDTInteractor *x) {
+  return limitForce(x, x->computeForce(x));
+}
+
+// Applies external changes to the resonators
+static void applyInputs(SDTInteractor *x, double f0, double v0, double s0,
+                        double f1, double v1, double s1) {
+  double p;
 
   // Apply external changes to first object
-  if (x->obj0) SDTResonator_applyForce(x->obj0, x->contact0, f0);
-  if (x->obj1) SDTResonator_applyForce(x->obj1, x->contact1, f1);
-  if (s0 && x->obj0) SDTResonator_setFragmentSize(x->obj0, s0);
-  if (s1 && x->obj1) SDTResonator_setFragmentSize(x->obj1, s1);
+  if (f0 && x->obj0) SDTResonator_applyForce(x->obj0, x->contact0, f0);
+  if (f1 && x->obj1) SDTResonator_applyForce(x->obj1, x->contact1, f1);
+  if (s0 && x->obj0) SDTResonator_modulateFragmentSize(x->obj0, s0);
+  if (s1 && x->obj1) SDTResonator_modulateFragmentSize(x->obj1, s1);
   if (v0 && x->obj0) {
     p = x->obj1 ? SDTResonator_getPosition(x->obj1, x->contact1) : 0.0;
     SDTResonator_setPosition(x->obj0, x->contact0, p);
@@ -138,30 +222,193 @@ void SDTInteractor_dsp(SDTInteractor *x, double f0, double v0, double s0,
     SDTResonator_setPosition(x->obj1, x->contact1, p);
     SDTResonator_setVelocity(x->obj1, x->contact1, v1);
   }
+}
+
+/* Tells whether a sleeping interactor can keep sleeping. External changes
+   perturb the resonators, and wake up the interactor. */
+static int isResting(const SDTInteractor *x) {
+  return x->asleep &&
+         (!x->obj0 || SDTResonator_getRevision(x->obj0) == x->revision0) &&
+         (!x->obj1 || SDTResonator_getRevision(x->obj1) == x->revision1);
+}
+
+/* Applies external changes and internal forces to the resonators, without
+   updating their state */
+static void interact(SDTInteractor *x, double f0, double v0, double s0,
+                     double f1, double v1, double s1) {
+  double f;
+
+  applyInputs(x, f0, v0, s0, f1, v1, s1);
+  if (isResting(x)) return;
+  x->asleep = 0;
   // Compute internal forces
   if (x->obj0 && x->obj1) {
     f = SDTInteractor_computeForce(x);
     SDTResonator_applyForce(x->obj0, x->contact0, f);
     SDTResonator_applyForce(x->obj1, x->contact1, -f);
   }
-  // Update state of first object
+}
+
+/* Puts the interactor to sleep when its force is bound to stay zero, for as
+   long as the resonators evolve freely. Call after updating the resonators. */
+static void trySleep(SDTInteractor *x) {
+  double lo0, hi0, lo1, hi1;
+
+  if (x->asleep) return;
+  if (x->obj0 && x->obj1) {
+    if (SDTInteractor_isImpact(x)) {
+      // Energy is only stored during a contact
+      if (x->energy != 0.0) return;
+      SDTResonator_getPositionBounds(x->obj0, x->contact0, &lo0, &hi0);
+      SDTResonator_getPositionBounds(x->obj1, x->contact1, &lo1, &hi1);
+      if (hi1 - lo0 > 0.0) return;
+    } else if (SDTInteractor_isFriction(x)) {
+      if (SDTFriction_getNormalForce(x) > 0.0) return;
+    } else {
+      return;
+    }
+  }
+  x->revision0 = x->obj0 ? SDTResonator_getRevision(x->obj0) : 0;
+  x->revision1 = x->obj1 ? SDTResonator_getRevision(x->obj1) : 0;
+  x->asleep = 1;
+}
+
+// Reads the displacement of both resonators at all their pickup points
+static void readOutputs(const SDTInteractor *x, double *outs) {
+  long nPickups0;
+
   nPickups0 = 0;
   if (x->obj0) {
-    SDTResonator_dsp(x->obj0);
     nPickups0 = SDTResonator_getNPickups(x->obj0);
-    for (pickup = 0; pickup < nPickups0; pickup++) {
-      outs[pickup] = SDTResonator_getPosition(x->obj0, pickup);
-    }
+    SDTResonator_getPositions(x->obj0, outs);
   }
-  // Update state of second object
-  nPickups1 = 0;
-  if (x->obj1) {
-    SDTResonator_dsp(x->obj1);
-    nPickups1 = SDTResonator_getNPickups(x->obj1);
-    for (pickup = 0; pickup < nPickups1; pickup++) {
-      outs[nPickups0 + pickup] = SDTResonator_getPosition(x->obj1, pickup);
+  if (x->obj1) SDTResonator_getPositions(x->obj1, outs + nPickups0);
+}
+
+void SDTInteractor_dsp(SDTInteractor *x, double f0, double v0, double s0,
+                       double f1, double v1, double s1, double *outs) {
+  interact(x, f0, v0, s0, f1, v1, s1);
+  if (x->obj0) SDTResonator_dsp(x->obj0);
+  if (x->obj1) SDTResonator_dsp(x->obj1);
+  trySleep(x);
+  readOutputs(x, outs);
+}
+
+// Finds the first sample from i on with a nonzero external input
+static unsigned int nextInput(const double **ins, unsigned int i,
+                              unsigned int n) {
+  int j;
+
+  if (!ins) return n;
+  for (; i < n; i++) {
+    for (j = 0; j < N_INPUTS; j++) {
+      if (ins[j] && ins[j][i]) return i;
     }
   }
+  return n;
+}
+
+static double inputAt(const double **ins, int j, unsigned int i) {
+  return ins[j] ? ins[j][i] : 0.0;
+}
+
+/* Advances the resonators of a sleeping interactor by n samples without
+   external inputs, during which they evolve freely */
+static void dspResting(SDTInteractor *x, double **outs, unsigned int offset,
+                       unsigned int n) {
+  double *blockOuts[2 * SDT_RESONATOR_NPICKUPS_MAX];
+  int k, nOuts;
+
+  nOuts = (x->obj0 ? SDTResonator_getNPickups(x->obj0) : 0) +
+          (x->obj1 ? SDTResonator_getNPickups(x->obj1) : 0);
+  for (k = 0; k < nOuts; k++) {
+    blockOuts[k] = (outs && outs[k]) ? outs[k] + offset : NULL;
+  }
+  if (x->obj0) {
+    SDTResonator_dspBlock(x->obj0, 0, NULL, blockOuts, n);
+    k = SDTResonator_getNPickups(x->obj0);
+  } else {
+    k = 0;
+  }
+  if (x->obj1) SDTResonator_dspBlock(x->obj1, 0, NULL, blockOuts + k, n);
+}
+
+/** @brief Implement the block signal processing routine of an interactor
+@param[in] NAME Function name
+@param[in] FORCE Force function, called directly to avoid an indirect call per
+sample */
+#define _SDT_INTERACTOR_BLOCK(NAME, FORCE)                                   \
+  static void NAME(SDTInteractor *x, const double **ins, double **outs,     \
+                   unsigned int n) {                                         \
+    double f, out[2 * SDT_RESONATOR_NPICKUPS_MAX];                           \
+    unsigned int i, next;                                                    \
+    int k, nOuts;                                                            \
+                                                                             \
+    nOuts = (x->obj0 ? SDTResonator_getNPickups(x->obj0) : 0) +              \
+            (x->obj1 ? SDTResonator_getNPickups(x->obj1) : 0);               \
+    next = nextInput(ins, 0, n);                                             \
+    for (i = 0; i < n; i++) {                                                \
+      if (next < i) next = nextInput(ins, i, n);                             \
+      /* Until the next input, a sleeping interactor has nothing to do */    \
+      if (x->asleep && next > i) {                                           \
+        dspResting(x, outs, i, next - i);                                    \
+        i = next - 1;                                                        \
+        continue;                                                            \
+      }                                                                      \
+      if (next == i) {                                                       \
+        applyInputs(x, inputAt(ins, 0, i), inputAt(ins, 1, i),               \
+                    inputAt(ins, 2, i), inputAt(ins, 3, i),                  \
+                    inputAt(ins, 4, i), inputAt(ins, 5, i));                 \
+      }                                                                      \
+      if (!isResting(x)) {                                                   \
+        x->asleep = 0;                                                       \
+        if (x->obj0 && x->obj1) {                                            \
+          f = limitForce(x, FORCE(x));                                       \
+          SDTResonator_applyForce(x->obj0, x->contact0, f);                  \
+          SDTResonator_applyForce(x->obj1, x->contact1, -f);                 \
+        }                                                                    \
+      }                                                                      \
+      if (x->obj0) SDTResonator_dsp(x->obj0);                                \
+      if (x->obj1) SDTResonator_dsp(x->obj1);                                \
+      trySleep(x);                                                           \
+      if (!outs) continue;                                                   \
+      readOutputs(x, out);                                                   \
+      for (k = 0; k < nOuts; k++) {                                          \
+        if (outs[k]) outs[k][i] = out[k];                                    \
+      }                                                                      \
+    }                                                                        \
+  }
+
+_SDT_INTERACTOR_BLOCK(dspBlockImpact, SDTImpact_MarhefkaOrin)
+_SDT_INTERACTOR_BLOCK(dspBlockFriction, SDTFriction_ElastoPlastic)
+_SDT_INTERACTOR_BLOCK(dspBlockGeneric, x->computeForce)
+
+void SDTInteractor_dspBlock(SDTInteractor *x, const double **ins,
+                            double **outs, unsigned int n) {
+  if (SDTInteractor_isImpact(x))
+    dspBlockImpact(x, ins, outs, n);
+  else if (SDTInteractor_isFriction(x))
+    dspBlockFriction(x, ins, outs, n);
+  else
+    dspBlockGeneric(x, ins, outs, n);
+}
+
+void SDTInteractor_setInputs(SDTInteractor *x, double f0, double v0,
+                             double s0, double f1, double v1, double s1) {
+  x->ins[0] = f0;
+  x->ins[1] = v0;
+  x->ins[2] = s0;
+  x->ins[3] = f1;
+  x->ins[4] = v1;
+  x->ins[5] = s1;
+}
+
+double SDTInteractor_getOutput(const SDTInteractor *x, unsigned int i) {
+  return (i < 2 * SDT_RESONATOR_NPICKUPS_MAX) ? x->outs[i] : 0.0;
+}
+
+void SDTInteractor_setOutputBuffers(SDTInteractor *x, double **buffers) {
+  x->buffers = buffers;
 }
 
 SDTInteractor *SDTInteractor_copy(SDTInteractor *dest, const SDTInteractor *src,
@@ -276,6 +523,7 @@ int SDT_registerInteractor(SDTInteractor *x, const char *key0,
 
   SDTHashmap_put(hashmap_interactors0, key0, x);
   SDTHashmap_put(hashmap_interactors1, key1, x);
+  atomic_fetch_add(&graphVersion, 1);
   SDT_updateInteractors(key0);
   SDT_updateInteractors(key1);
   return 0;
@@ -299,6 +547,7 @@ SDTInteractor *SDT_getInteractor(const char *key0, const char *key1) {
 
 int SDT_unregisterInteractor(const char *key0, const char *key1) {
   if (!SDT_getInteractor(key0, key1)) return 1;
+  atomic_fetch_add(&graphVersion, 1);
   _SDT_POP_INTERACTOR_HASHMAP(0)
   _SDT_POP_INTERACTOR_HASHMAP(1)
   return 0;
@@ -324,6 +573,363 @@ void SDT_updateInteractors(const char *key) {
 
 //-------------------------------------------------------------------------------------//
 
+struct SDTScheduler {
+  SDTInteractor **interactors;
+  SDTResonator **resonators;
+  int *parents, *interactorOffsets, *resonatorOffsets;
+  // Scratch memory for the island partition, sized with the lists
+  void **sorted;
+  int *labels, *resonatorIslands, *interactorIslands, *next;
+  int nInteractors, nResonators, nIslands, size;
+  unsigned long version;
+  pthread_t *threads;
+  pthread_mutex_t mutex;
+  pthread_cond_t start, done;
+  unsigned long generation;
+  unsigned int blockSize;
+  int nThreads, nextIsland, pending, quit;
+};
+
+SDTScheduler *SDTScheduler_new() {
+  SDTScheduler *x;
+
+  x = (SDTScheduler *)malloc(sizeof(SDTScheduler));
+  x->interactors = NULL;
+  x->resonators = NULL;
+  x->parents = NULL;
+  x->interactorOffsets = NULL;
+  x->resonatorOffsets = NULL;
+  x->sorted = NULL;
+  x->labels = NULL;
+  x->resonatorIslands = NULL;
+  x->interactorIslands = NULL;
+  x->next = NULL;
+  x->nInteractors = 0;
+  x->nResonators = 0;
+  x->nIslands = 0;
+  x->size = 0;
+  x->version = atomic_load(&graphVersion) - 1;
+  x->threads = NULL;
+  pthread_mutex_init(&x->mutex, NULL);
+  pthread_cond_init(&x->start, NULL);
+  pthread_cond_init(&x->done, NULL);
+  x->generation = 0;
+  x->blockSize = 0;
+  x->nThreads = 1;
+  x->nextIsland = 0;
+  x->pending = 0;
+  x->quit = 0;
+  return x;
+}
+
+static void stopThreads(SDTScheduler *x) {
+  int i;
+
+  if (!x->threads) return;
+  pthread_mutex_lock(&x->mutex);
+  x->quit = 1;
+  pthread_cond_broadcast(&x->start);
+  pthread_mutex_unlock(&x->mutex);
+  for (i = 0; i < x->nThreads - 1; i++) {
+    pthread_join(x->threads[i], NULL);
+  }
+  free(x->threads);
+  x->threads = NULL;
+  x->nThreads = 1;
+  x->quit = 0;
+}
+
+static void freeLists(SDTScheduler *x) {
+  if (x->interactors) free(x->interactors);
+  if (x->resonators) free(x->resonators);
+  if (x->parents) free(x->parents);
+  if (x->interactorOffsets) free(x->interactorOffsets);
+  if (x->resonatorOffsets) free(x->resonatorOffsets);
+  if (x->sorted) free(x->sorted);
+  if (x->labels) free(x->labels);
+  if (x->resonatorIslands) free(x->resonatorIslands);
+  if (x->interactorIslands) free(x->interactorIslands);
+  if (x->next) free(x->next);
+}
+
+void SDTScheduler_free(SDTScheduler *x) {
+  stopThreads(x);
+  pthread_mutex_destroy(&x->mutex);
+  pthread_cond_destroy(&x->start);
+  pthread_cond_destroy(&x->done);
+  freeLists(x);
+  free(x);
+}
+
+static void countInteractor(const char *key, void *value, void *data) {
+  (*(int *)data)++;
+}
+
+static void addInteractor(const char *key, void *value, void *data) {
+  SDTScheduler *x = (SDTScheduler *)data;
+
+  x->interactors[x->nInteractors++] = (SDTInteractor *)value;
+}
+
+static int findResonator(const SDTScheduler *x, const SDTResonator *r) {
+  int i;
+
+  if (!r) return -1;
+  for (i = 0; i < x->nResonators; i++) {
+    if (x->resonators[i] == r) return i;
+  }
+  return -1;
+}
+
+static int addResonator(SDTScheduler *x, SDTResonator *r) {
+  int i = findResonator(x, r);
+
+  if (r && i < 0) {
+    i = x->nResonators++;
+    x->resonators[i] = r;
+    x->parents[i] = i;
+  }
+  return i;
+}
+
+static int findRoot(int *parents, int i) {
+  while (parents[i] != i) {
+    parents[i] = parents[parents[i]];
+    i = parents[i];
+  }
+  return i;
+}
+
+// Sorts items by island, preserving their relative order
+static void sortByIsland(SDTScheduler *x, void **items, const int *islands,
+                         int n, int *offsets) {
+  void **sorted = x->sorted;
+  int i, island, nIslands = x->nIslands, *next = x->next;
+
+  for (i = 0; i <= nIslands; i++) {
+    offsets[i] = 0;
+  }
+  for (i = 0; i < n; i++) {
+    offsets[islands[i] + 1]++;
+  }
+  for (i = 0; i < nIslands; i++) {
+    offsets[i + 1] += offsets[i];
+    next[i] = offsets[i];
+  }
+  for (i = 0; i < n; i++) {
+    island = islands[i];
+    sorted[next[island]++] = items[i];
+  }
+  for (i = 0; i < n; i++) {
+    items[i] = sorted[i];
+  }
+}
+
+void SDTScheduler_update(SDTScheduler *x) {
+  SDTInteractor *interactor;
+  int i, r0, r1, n = 0;
+
+  if (hashmap_interactors0)
+    SDTHashmap_forEach(hashmap_interactors0, countInteractor, &n);
+  if (n > x->size) {
+    freeLists(x);
+    x->interactors = (SDTInteractor **)malloc(n * sizeof(SDTInteractor *));
+    x->resonators = (SDTResonator **)malloc(2 * n * sizeof(SDTResonator *));
+    x->parents = (int *)malloc(2 * n * sizeof(int));
+    x->interactorOffsets = (int *)malloc((2 * n + 1) * sizeof(int));
+    x->resonatorOffsets = (int *)malloc((2 * n + 1) * sizeof(int));
+    x->sorted = (void **)malloc(2 * n * sizeof(void *));
+    x->labels = (int *)malloc(2 * n * sizeof(int));
+    x->resonatorIslands = (int *)malloc(2 * n * sizeof(int));
+    x->interactorIslands = (int *)malloc(n * sizeof(int));
+    x->next = (int *)malloc((2 * n + 1) * sizeof(int));
+    x->size = n;
+  }
+  x->nInteractors = 0;
+  x->nResonators = 0;
+  x->nIslands = 0;
+  x->version = atomic_load(&graphVersion);
+  if (hashmap_interactors0)
+    SDTHashmap_forEach(hashmap_interactors0, addInteractor, x);
+  if (!x->nInteractors) return;
+  // Join resonators touched by the same interactor into islands
+  for (i = 0; i < x->nInteractors; i++) {
+    interactor = x->interactors[i];
+    r0 = addResonator(x, interactor->obj0);
+    r1 = addResonator(x, interactor->obj1);
+    if (r0 >= 0 && r1 >= 0) {
+      x->parents[findRoot(x->parents, r1)] = findRoot(x->parents, r0);
+    }
+  }
+  if (!x->nResonators) {
+    x->nInteractors = 0;
+    return;
+  }
+  for (i = 0; i < x->nResonators; i++) {
+    x->labels[i] = -1;
+  }
+  for (i = 0; i < x->nResonators; i++) {
+    r0 = findRoot(x->parents, i);
+    if (x->labels[r0] < 0) x->labels[r0] = x->nIslands++;
+    x->resonatorIslands[i] = x->labels[r0];
+  }
+  /* Interactors take the island of their resonators, looked up before the
+     resonators are sorted. Those without resonators have no work to do and
+     get dropped. */
+  n = 0;
+  for (i = 0; i < x->nInteractors; i++) {
+    interactor = x->interactors[i];
+    r0 = findResonator(x, interactor->obj0 ? interactor->obj0
+                                           : interactor->obj1);
+    if (r0 < 0) continue;
+    x->interactors[n] = interactor;
+    x->interactorIslands[n++] = x->resonatorIslands[r0];
+  }
+  x->nInteractors = n;
+  sortByIsland(x, (void **)x->resonators, x->resonatorIslands,
+               x->nResonators, x->resonatorOffsets);
+  sortByIsland(x, (void **)x->interactors, x->interactorIslands,
+               x->nInteractors, x->interactorOffsets);
+}
+
+int SDTScheduler_getNInteractors(const SDTScheduler *x) {
+  return x->nInteractors;
+}
+
+int SDTScheduler_getNResonators(const SDTScheduler *x) {
+  return x->nResonators;
+}
+
+int SDTScheduler_getNIslands(const SDTScheduler *x) { return x->nIslands; }
+
+static void dspIsland(SDTScheduler *x, int island, unsigned int n) {
+  SDTInteractor *interactor;
+  int i, j, i0, i1, r0, r1, nOuts;
+  unsigned int s;
+
+  i0 = x->interactorOffsets[island];
+  i1 = x->interactorOffsets[island + 1];
+  r0 = x->resonatorOffsets[island];
+  r1 = x->resonatorOffsets[island + 1];
+  for (s = 0; s < n; s++) {
+    // Gather all forces acting on each resonator
+    for (i = i0; i < i1; i++) {
+      interactor = x->interactors[i];
+      interact(interactor, interactor->ins[0], interactor->ins[1],
+               interactor->ins[2], interactor->ins[3], interactor->ins[4],
+               interactor->ins[5]);
+      for (j = 0; j < N_INPUTS; j++) {
+        interactor->ins[j] = 0.0;
+      }
+    }
+    // Advance each resonator exactly once
+    for (i = r0; i < r1; i++) {
+      SDTResonator_dsp(x->resonators[i]);
+    }
+    // Hand out the pickup outputs
+    for (i = i0; i < i1; i++) {
+      interactor = x->interactors[i];
+      trySleep(interactor);
+      readOutputs(interactor, interactor->outs);
+      if (!interactor->buffers) continue;
+      nOuts = (interactor->obj0 ? SDTResonator_getNPickups(interactor->obj0)
+                                : 0) +
+              (interactor->obj1 ? SDTResonator_getNPickups(interactor->obj1)
+                                : 0);
+      for (j = 0; j < nOuts; j++) {
+        if (interactor->buffers[j]) {
+          interactor->buffers[j][s] = interactor->outs[j];
+        }
+      }
+    }
+  }
+}
+
+// Processes islands until none is left. Call with the mutex locked.
+static void runIslands(SDTScheduler *x) {
+  int island;
+
+  while (x->nextIsland < x->nIslands) {
+    island = x->nextIsland++;
+    pthread_mutex_unlock(&x->mutex);
+    dspIsland(x, island, x->blockSize);
+    pthread_mutex_lock(&x->mutex);
+    if (--x->pending == 0) pthread_cond_signal(&x->done);
+  }
+}
+
+static void *worker(void *data) {
+  SDTScheduler *x = (SDTScheduler *)data;
+  unsigned long generation;
+
+  pthread_mutex_lock(&x->mutex);
+  generation = x->generation;
+  while (1) {
+    while (!x->quit && x->generation == generation) {
+      pthread_cond_wait(&x->start, &x->mutex);
+    }
+    if (x->quit) break;
+    generation = x->generation;
+    runIslands(x);
+  }
+  pthread_mutex_unlock(&x->mutex);
+  return NULL;
+}
+
+int SDTScheduler_getNThreads(const SDTScheduler *x) { return x->nThreads; }
+
+int SDTScheduler_setNThreads(SDTScheduler *x, int nThreads) {
+  int i;
+
+  stopThreads(x);
+  if (nThreads <= 1) return 0;
+  x->threads = (pthread_t *)malloc((nThreads - 1) * sizeof(pthread_t));
+  for (i = 0; i < nThreads - 1; i++) {
+    if (pthread_create(&x->threads[i], NULL, worker, x)) {
+      SDT_LOGA(ERROR, "Could only start %d worker threads out of %d\n", i,
+               nThreads - 1);
+      x->nThreads = i + 1;
+      return 1;
+    }
+    x->nThreads = i + 2;
+  }
+  return 0;
+}
+
+void SDTScheduler_dsp(SDTScheduler *x) {
+  int island;
+
+  if (x->version != atomic_load(&graphVersion)) SDTScheduler_update(x);
+  for (island = 0; island < x->nIslands; island++) {
+    dspIsland(x, island, 1);
+  }
+}
+
+void SDTScheduler_dspBlock(SDTScheduler *x, unsigned int n) {
+  int island;
+
+  if (x->version != atomic_load(&graphVersion)) SDTScheduler_update(x);
+  if (x->nThreads <= 1 || x->nIslands <= 1) {
+    for (island = 0; island < x->nIslands; island++) {
+      dspIsland(x, island, n);
+    }
+    return;
+  }
+  pthread_mutex_lock(&x->mutex);
+  x->blockSize = n;
+  x->nextIsland = 0;
+  x->pending = x->nIslands;
+  x->generation++;
+  pthread_cond_broadcast(&x->start);
+  runIslands(x);
+  while (x->pending > 0) {
+    pthread_cond_wait(&x->done, &x->mutex);
+  }
+  pthread_mutex_unlock(&x->mutex);
+}
+
+//-------------------------------------------------------------------------------------//
+
 struct SDTImpact {
   double stiffness, dissipation, shape;
 };
@@ -413,13 +1019,36 @@ static SDTInteractor *_SDTImpact_setStateParams(SDTInteractor *x,
 
 //-------------------------------------------------------------------------------------//
 
+/* Each friction draws noise from its own generator, so that islands running on
+   different threads neither race on the shared seed nor depend on the order
+   in which they run. Seeds are spread by a creation counter, so that frictions
+   with the same settings still sound different. */
+#define FRICTION_SEED 42
+#define FRICTION_SEED_STEP 0x9E3779B9u
+
+static atomic_uint frictionCount = 0;
+
 struct SDTFriction {
   double fn, vs, ks, kd, kba, s0, s1, s2, s3, fs, fc, z;
+  unsigned int seed;
 };
 
+// Plastic fraction of the bristle displacement
+static double bristleAlpha(double z, double zss, double zba, int vSgn) {
+  if (vSgn != SDT_signum(z))
+    return 0.0;
+  else if (fabs(z) < fabs(zba))
+    return 0.0;
+  else if (fabs(z) < fabs(zss))
+    return 0.5 + 0.5 * sin(SDT_PI * (z - 0.5 * (zss + zba)) / (zss - zba));
+  else
+    return 1.0;
+}
+
 double SDTFriction_ElastoPlastic(SDTInteractor *x) {
   SDTFriction *s = (SDTFriction *)x->state;
-  double v, vRatio, vSgn, zSgn, zss, zba, alpha, dz, w, f;
+  double v, vRatio, zss, zba, alpha, z, h, r, dz, w, f;
+  int vSgn, i, n;
 
   x->energy = 0.0;
   v = SDTResonator_getVelocity(x->obj1, x->contact1) -
@@ -430,22 +1059,29 @@ double SDTFriction_ElastoPlastic(SDTInteractor *x) {
   }
   vRatio = v / s->vs;
   vSgn = SDT_signum(v);
-  zSgn = SDT_signum(s->z);
   zss = vSgn * (s->fc + (s->fs - s->fc) * exp(-vRatio * vRatio)) / s->s0;
   zba = vSgn * s->kba * s->fc / s->s0;
-  if (vSgn != zSgn)
-    alpha = 0.0;
-  else if (fabs(s->z) < fabs(zba))
-    alpha = 0.0;
-  else if (fabs(s->z) < fabs(zss))
-    alpha = 0.5 + 0.5 * sin(SDT_PI * (s->z - 0.5 * (zss + zba)) / (zss - zba));
-  else
-    alpha = 1.0;
-  dz = v * (1.0 - alpha * s->z / zss);
-  if (!isnormal(dz)) dz = 0.0;
-  w = SDT_whiteNoise() * sqrt(fabs(v) * s->fn);
+  /* The bristles relax towards zss at a rate up to |v / zss|, which grows with
+     the stiffness. When explicit Euler would overshoot, the sample is split
+     into sub-steps, and sub-steps which are still too long are integrated
+     implicitly in the relaxation term. */
+  r = fabs(v / zss) * SDT_timeStep;
+  n = r > 1.0 ? (r < MAX_SUBSTEPS ? (int)ceil(r) : MAX_SUBSTEPS) : 1;
+  h = SDT_timeStep / n;
+  z = s->z;
+  dz = 0.0;
+  for (i = 0; i < n; i++) {
+    alpha = bristleAlpha(z, zss, zba, vSgn);
+    dz = v * (1.0 - alpha * z / zss);
+    if (!isnormal(dz)) dz = 0.0;
+    r = h * v * alpha / zss;
+    if (r > 1.0) dz /= 1.0 + r;
+    z += dz * h;
+  }
+  if (n > 1) dz = (z - s->z) / SDT_timeStep;
+  w = SDT_whiteNoiseFrom(&s->seed) * sqrt(fabs(v) * s->fn);
   f = s->s0 * s->z + s->s1 * dz + s->s2 * v + s->s3 * w;
-  s->z += dz * SDT_timeStep;
+  s->z = z;
   return f;
 }
 
@@ -467,6 +1103,8 @@ SDTInteractor *SDTFriction_new() {
   s->fs = 0.0;
   s->fc = 0.0;
   s->z = 0.0;
+  s->seed = FRICTION_SEED +
+            atomic_fetch_add(&frictionCount, 1) * FRICTION_SEED_STEP;
   x->state = s;
   x->computeForce = SDTFriction_ElastoPlastic;
   return x;
@@ -486,10 +1124,15 @@ void SDTFriction_free(SDTInteractor *x) { SDTInteractor_free(x); }
 void SDTFriction_setNormalForce(SDTInteractor *x, double f) {
   SDTFriction *s = (SDTFriction *)x->state;
   s->fn = fmax(0.0, f);
+  if (s->fn > 0.0) x->asleep = 0;
   s->fs = s->fn * s->ks;
   s->fc = s->fn * s->kd;
 }
 
+void SDTFriction_setSeed(SDTInteractor *x, unsigned int seed) {
+  ((SDTFriction *)x->state)->seed = seed;
+}
+
 void SDTFriction_setStribeckVelocity(SDTInteractor *x, double f) {
   ((SDTFriction *)x->state)->vs = fmax(0.0, f);
 }
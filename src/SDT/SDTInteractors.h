@@ -60,9 +60,30 @@ extern long SDTInteractor_getFirstPoint(const SDTInteractor *x);
 extern long SDTInteractor_getSecondPoint(const SDTInteractor *x);
 
 /** @brief Computes a force to apply to the contact points,
-based on the resonators' state at the chosen pickups */
+based on the resonators' state at the chosen pickups.
+The force is then limited so that the interaction does not add energy to the
+system. The total energy of the resonators is a quadratic function of the
+force, so the limit is computed in closed form. An iterative search is used
+instead whenever the quadratic form is not exact, e.g. when modal displacements
+get clipped. */
 extern double SDTInteractor_computeForce(SDTInteractor *x);
 
+/** @brief Gets the number of times the force computation fell back to the
+iterative energy correction, since the interactor was created.
+@return Number of fallbacks */
+extern unsigned long SDTInteractor_getFallbacks(const SDTInteractor *x);
+
+/** @brief Tells whether the interactor is asleep.
+An interactor falls asleep when its force is bound to stay zero for as long as
+the resonators evolve freely: for an impact, when the displacement bounds of the
+resonators at the contact points rule out any contact; for friction, when the
+normal force is zero. A sleeping interactor skips the force computation, while
+the resonators keep ringing until their own modes fall asleep. Any external
+force, velocity or fragment size change, and any other perturbation of either
+resonator, wakes the interactor up.
+@return Nonzero if the interactor is asleep */
+extern int SDTInteractor_isAsleep(const SDTInteractor *x);
+
 /** @brief Signal processing routine.
 Convenience method to compute the interaction force, apply it to the resonators
 and update their state. This method already calls the DSP routines of the two
@@ -79,6 +100,50 @@ to make contact with first object if present)
 extern void SDTInteractor_dsp(SDTInteractor *x, double f0, double v0, double s0,
                               double f1, double v1, double s1, double *outs);
 
+/** @brief Block signal processing routine.
+Equivalent to calling SDTInteractor_dsp() once per sample for n samples, with
+the force model of impacts and friction called directly. Input buffers are
+scanned ahead for nonzero samples, so that sparse or missing inputs cost
+nothing. While the interactor is asleep and no input arrives, the resonators
+are advanced with their own block routines, which only put modes to sleep at
+the end of each stretch.
+@param[in] ins Array of 6 input buffers of n samples, in the order of the
+SDTInteractor_dsp() arguments f0, v0, s0, f1, v1, s1. Can be NULL, and so can be
+any of its elements, for zero input
+@param[out] outs Array of output buffers of n samples, receiving the
+displacement of the first resonator at each of its pickup points, followed by
+the second resonator. Can be NULL, and so can be any of its elements, to skip
+the corresponding outputs
+@param[in] n Number of samples to process */
+extern void SDTInteractor_dspBlock(SDTInteractor *x, const double **ins,
+                                   double **outs, unsigned int n);
+
+/** @brief Sets the external inputs for the next SDTScheduler_dsp() call.
+Inputs are consumed by the scheduler, and reset to zero afterwards.
+See SDTInteractor_dsp() for the meaning of each input.
+@param[in] f0 Applied force to the first resonator
+@param[in] v0 Applied velocity to the first resonator
+@param[in] s0 Fragment size of the first resonator
+@param[in] f1 Applied force to the second resonator
+@param[in] v1 Applied velocity to the second resonator
+@param[in] s1 Fragment size of the second resonator */
+extern void SDTInteractor_setInputs(SDTInteractor *x, double f0, double v0,
+                                    double s0, double f1, double v1,
+                                    double s1);
+
+/** @brief Gets an output written by the last SDTScheduler_dsp() call.
+Outputs are ordered as in SDTInteractor_dsp(): the pickup points of the first
+resonator, followed by the pickup points of the second resonator.
+@param[in] i Output index
+@return Displacement of the resonator at the corresponding pickup point */
+extern double SDTInteractor_getOutput(const SDTInteractor *x, unsigned int i);
+
+/** @brief Sets the output buffers written by SDTScheduler_dspBlock().
+Buffers are ordered as the outputs of SDTInteractor_dsp(), and must hold at
+least as many samples as the processed blocks. NULL buffers are skipped.
+@param[in] buffers Array of output buffers, or NULL to disable block output */
+extern void SDTInteractor_setOutputBuffers(SDTInteractor *x, double **buffers);
+
 /** @brief Update interactors in the interactors list that involve
 the specified resonator.
 
@@ -139,6 +204,84 @@ extern SDTInteractor *SDTInteractor_setParams(SDTInteractor *x,
 
 /** @} */
 
+/** @defgroup scheduler Interaction scheduler
+When a resonator takes part in more than one interaction, calling
+SDTInteractor_dsp() on each interactor would update the resonator several times
+per sample. The scheduler processes all the interactors in the interactors
+list together: first, it lets every interactor apply its external inputs and
+contact forces; then, it updates the state of each involved resonator exactly
+once; finally, it writes the outputs of every interactor.
+External inputs are set with SDTInteractor_setInputs(), and outputs are read
+with SDTInteractor_getOutput(). The scheduler follows registrations and
+unregistrations of resonators and interactors automatically.
+
+Interactors are partitioned into islands, groups of interactors connected
+through shared resonators. Islands never affect each other, so
+SDTScheduler_dspBlock() can process them concurrently on a pool of worker
+threads. Each island is always processed by a single thread, in the same order,
+so the output does not depend on the number of threads.
+@{ */
+
+/** @brief Opaque data structure representing an interaction scheduler */
+typedef struct SDTScheduler SDTScheduler;
+
+/** @brief Object constructor.
+@return Pointer to the new instance */
+extern SDTScheduler *SDTScheduler_new();
+
+/** @brief Object destructor.
+@param[in] x Pointer to the instance to destroy */
+extern void SDTScheduler_free(SDTScheduler *x);
+
+/** @brief Collects the registered interactors and their resonators.
+This function is called automatically by SDTScheduler_dsp() when the
+interactors list changes. It only allocates memory when the list grows beyond
+its largest size so far. Calling it from the host thread after registering the
+interactors, before audio processing starts, keeps the audio thread from
+allocating.
+@param[in] x Pointer to the instance to update */
+extern void SDTScheduler_update(SDTScheduler *x);
+
+/** @brief Gets the number of scheduled interactors
+@return Number of interactors */
+extern int SDTScheduler_getNInteractors(const SDTScheduler *x);
+
+/** @brief Gets the number of distinct scheduled resonators
+@return Number of resonators */
+extern int SDTScheduler_getNResonators(const SDTScheduler *x);
+
+/** @brief Gets the number of independent islands
+@return Number of islands */
+extern int SDTScheduler_getNIslands(const SDTScheduler *x);
+
+/** @brief Gets the number of threads processing the islands
+@return Number of threads, including the calling thread */
+extern int SDTScheduler_getNThreads(const SDTScheduler *x);
+
+/** @brief Sets the number of threads processing the islands.
+The thread calling SDTScheduler_dspBlock() takes part in the processing, so
+nThreads - 1 worker threads are started. Do not call this function from the
+audio thread.
+@param[in] nThreads Number of threads, including the calling thread
+@return 0 on success, 1 if some worker threads could not be started */
+extern int SDTScheduler_setNThreads(SDTScheduler *x, int nThreads);
+
+/** @brief Signal processing routine.
+Call this function at sample rate, instead of the DSP routines of the
+scheduled interactors and resonators. */
+extern void SDTScheduler_dsp(SDTScheduler *x);
+
+/** @brief Block signal processing routine.
+Processes a block of samples, distributing the islands among the threads.
+External inputs set with SDTInteractor_setInputs() are applied on the first
+sample of the block. Outputs are written to the buffers set with
+SDTInteractor_setOutputBuffers(), and the last sample is also available
+through SDTInteractor_getOutput().
+@param[in] n Number of samples */
+extern void SDTScheduler_dspBlock(SDTScheduler *x, unsigned int n);
+
+/** @} */
+
 /** @defgroup impact Impact
 Simulates a non-linear impact, computing impact force from the total
 compression, namely the relative displacement between the two contact points.
@@ -254,6 +397,9 @@ extern void SDTFriction_setDynamicCoefficient(SDTInteractor *x, double f);
 extern void SDTFriction_setBreakAway(SDTInteractor *x, double f);
 
 /** @brief Sets the contact stiffness.
+Stiffer bristles relax faster. When a sample is too long for their relaxation,
+it is split into sub-steps, and integrated semi-implicitly beyond 16 of them, so
+that stiff contacts stay stable at usual sample rates.
 @param[in] f Contact stiffness, positive scalar */
 extern void SDTFriction_setStiffness(SDTInteractor *x, double f);
 
@@ -269,6 +415,13 @@ extern void SDTFriction_setViscosity(SDTInteractor *x, double f);
 @param[in] f Surface roughness, positive scalar */
 extern void SDTFriction_setNoisiness(SDTInteractor *x, double f);
 
+/** @brief Sets the state of the noise generator.
+Each friction draws its surface noise from a generator of its own, seeded
+differently at creation. Frictions with the same seed and parameters produce
+the same noise.
+@param[in] seed Generator state */
+extern void SDTFriction_setSeed(SDTInteractor *x, unsigned int seed);
+
 /** @brief Gets the perpendicular force (pressure) applied to the two sliding
 resonators.
 @return Normal force, in N */
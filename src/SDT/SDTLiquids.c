@@ -2,8 +2,10 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "SDTCommon.h"
+#include "SDTFFT.h"
 #include "SDTFilters.h"
 #include "SDTStructs.h"
 
@@ -16,6 +18,9 @@
 struct SDTBubble {
   double radius, depth, riseFactor, amp, decay, gain, phaseStep, phaseRise,
       phase, out, lastOut;
+  /* Unit phasor of the oscillation, rotated every sample by the phase step,
+     which is in turn rotated by the phase rise */
+  double re, im, stepRe, stepIm, riseRe, riseIm;
 };
 
 SDTBubble *SDTBubble_new() {
@@ -33,6 +38,12 @@ SDTBubble *SDTBubble_new() {
   x->phase = 0.0;
   x->out = 0.0;
   x->lastOut = 0.0;
+  x->re = 1.0;
+  x->im = 0.0;
+  x->stepRe = 1.0;
+  x->stepIm = 0.0;
+  x->riseRe = 1.0;
+  x->riseIm = 0.0;
   return x;
 }
 
@@ -86,52 +97,123 @@ void SDTBubble_setRiseFactor(SDTBubble *x, double f) {
   x->riseFactor = SDT_fclip(f, 0.0, MAX_RISE);
 }
 
-void SDTBubble_trigger(SDTBubble *x) {
+/* Computes the initial amplitude, the decay and the phase increments of a
+   bubble from its radius, depth and rise factor */
+static void bubbleCoefficients(double radius, double depth, double riseFactor,
+                               double *amp, double *decay, double *phaseStep,
+                               double *phaseRise) {
   double pRadius;
 
+  pRadius = radius * sqrt(radius);
+  *amp = 17.2133 * pRadius * depth;
+  *decay = 0.13 / radius + 0.0072 / pRadius;
+  *phaseStep = 3.0 / radius * SDT_timeStep;
+  *phaseRise = *phaseStep * *decay * riseFactor * SDT_timeStep;
+}
+
+void SDTBubble_trigger(SDTBubble *x) {
   x->lastOut = x->out;
-  pRadius = x->radius * sqrt(x->radius);
-  x->amp = 17.2133 * pRadius * x->depth;
-  x->decay = 0.13 / x->radius + 0.0072 / pRadius;
+  bubbleCoefficients(x->radius, x->depth, x->riseFactor, &x->amp, &x->decay,
+                     &x->phaseStep, &x->phaseRise);
   x->gain = exp(-x->decay * SDT_timeStep);
-  x->phaseStep = 3.0 / x->radius * SDT_timeStep;
-  x->phaseRise = x->phaseStep * x->decay * x->riseFactor * SDT_timeStep;
   x->phase = 0.0;
+  x->re = 1.0;
+  x->im = 0.0;
+  x->stepRe = cos(SDT_TWOPI * x->phaseStep);
+  x->stepIm = sin(SDT_TWOPI * x->phaseStep);
+  x->riseRe = cos(SDT_TWOPI * x->phaseRise);
+  x->riseIm = sin(SDT_TWOPI * x->phaseRise);
 }
 
 void SDTBubble_normAmp(SDTBubble *x) { x->amp = 1.0; }
 
 double SDTBubble_dsp(SDTBubble *x) {
-  double alpha;
+  double alpha, t;
 
   if (x->amp < SDT_QUIET && x->phase > 1.0) return 0.0;
   alpha = x->phase < 1.0 ? x->phase : 1.0;
-  x->out =
-      (1.0 - alpha) * x->lastOut + alpha * x->amp * sin(SDT_TWOPI * x->phase);
+  x->out = (1.0 - alpha) * x->lastOut + alpha * x->amp * x->im;
+  t = x->re * x->stepRe - x->im * x->stepIm;
+  x->im = x->re * x->stepIm + x->im * x->stepRe;
+  x->re = t;
+  t = x->stepRe * x->riseRe - x->stepIm * x->riseIm;
+  x->stepIm = x->stepRe * x->riseIm + x->stepIm * x->riseRe;
+  x->stepRe = t;
   x->phase += x->phaseStep;
   x->phaseStep += x->phaseRise;
   x->amp *= x->gain;
   return x->out;
 }
 
+// Number of samples after which a triggered bubble is surely silent
+static double bubbleLife(double amp, double gain, double phaseStep) {
+  double n;
+
+  n = phaseStep > 0.0 ? ceil(1.0 / phaseStep) : HUGE_VAL;
+  if (amp >= SDT_QUIET && gain < 1.0) {
+    n = fmax(n, ceil(log(SDT_QUIET / amp) / log(gain)));
+  }
+  return n + 2.0;
+}
+
 //-------------------------------------------------------------------------------------//
 
+// Voice state arrays, in the order they are stored
+enum {
+  VOICE_AMP,
+  VOICE_GAIN,
+  VOICE_PHASE,
+  VOICE_STEP,
+  VOICE_RISE,
+  VOICE_OUT,
+  VOICE_LAST_OUT,
+  VOICE_RE,
+  VOICE_IM,
+  VOICE_STEP_RE,
+  VOICE_STEP_IM,
+  VOICE_RISE_RE,
+  VOICE_RISE_IM,
+  VOICE_END,
+  N_VOICE_ARRAYS
+};
+
 struct SDTFluidFlow {
-  SDTBubble **bubbles;
+  /* Bubble state, with one contiguous array per variable. Playing voices
+     come first, so that they can be processed together. */
+  double *voices[N_VOICE_ARRAYS];
+  /* Playing voices also form a min-heap on the time when they fall silent.
+     Each voice knows its position in the heap. */
+  int *heap, *heapPos;
   double minRadius, maxRadius, expRadius, minDepth, maxDepth, expDepth,
-      riseFactor, riseCutoff, avgRate, success, gain;
-  int nBubbles;
+      riseFactor, riseCutoff, avgRate, wait, time, gain;
+  int nBubbles, nActive;
 };
 
+static void allocateVoices(SDTFluidFlow *x, int nBubbles) {
+  double *storage;
+  int i;
+
+  x->nBubbles = nBubbles > 0 ? nBubbles : 0;
+  storage = (double *)calloc(N_VOICE_ARRAYS * x->nBubbles + 1, sizeof(double));
+  for (i = 0; i < N_VOICE_ARRAYS; i++) {
+    x->voices[i] = storage + i * x->nBubbles;
+  }
+  x->heap = (int *)malloc((x->nBubbles + 1) * sizeof(int));
+  x->heapPos = (int *)malloc((x->nBubbles + 1) * sizeof(int));
+  x->nActive = 0;
+}
+
+static void freeVoices(SDTFluidFlow *x) {
+  free(x->voices[0]);
+  free(x->heap);
+  free(x->heapPos);
+}
+
 SDTFluidFlow *SDTFluidFlow_new(int nBubbles) {
   SDTFluidFlow *x;
-  int i;
 
   x = (SDTFluidFlow *)malloc(sizeof(SDTFluidFlow));
-  x->bubbles = (SDTBubble **)malloc(nBubbles * sizeof(SDTBubble *));
-  for (i = 0; i < nBubbles; i++) {
-    x->bubbles[i] = SDTBubble_new();
-  }
+  allocateVoices(x, nBubbles);
   x->minRadius = 0.00015;
   x->maxRadius = 0.015;
   x->expRadius = 1.0;
@@ -141,30 +223,21 @@ SDTFluidFlow *SDTFluidFlow_new(int nBubbles) {
   x->riseFactor = 0.1;
   x->riseCutoff = 0.9;
   x->avgRate = 0.0;
-  x->success = 0.0;
+  x->wait = HUGE_VAL;
+  x->time = 0.0;
   x->gain = 1.0;
-  x->nBubbles = nBubbles;
 
   return x;
 }
 
 void SDTFluidFlow_free(SDTFluidFlow *x) {
-  int i;
-
-  for (i = 0; i < x->nBubbles; i++) {
-    SDTBubble_free(x->bubbles[i]);
-  }
-  free(x->bubbles);
+  freeVoices(x);
   free(x);
 }
 
 void SDTFluidFlow_setNBubbles(SDTFluidFlow *x, int f) {
-  for (unsigned int i = 0; i < x->nBubbles; i++) SDTBubble_free(x->bubbles[i]);
-  free(x->bubbles);
-  x->nBubbles = f;
-  x->bubbles = (SDTBubble **)malloc(x->nBubbles * sizeof(SDTBubble *));
-  for (unsigned int i = 0; i < x->nBubbles; i++)
-    x->bubbles[i] = SDTBubble_new();
+  freeVoices(x);
+  allocateVoices(x, f);
 }
 
 _SDT_COPY_FUNCTION(FluidFlow)
@@ -228,6 +301,8 @@ SDTFluidFlow *SDTFluidFlow_setParams(SDTFluidFlow *x, const json_value *j,
 
 int SDTFluidFlow_getNBubbles(const SDTFluidFlow *x) { return x->nBubbles; }
 
+int SDTFluidFlow_getActiveVoices(const SDTFluidFlow *x) { return x->nActive; }
+
 double SDTFluidFlow_getAvgRate(const SDTFluidFlow *x) { return x->avgRate; }
 
 double SDTFluidFlow_getMinRadius(const SDTFluidFlow *x) { return x->minRadius; }
@@ -283,39 +358,592 @@ void SDTFluidFlow_setRiseCutoff(SDTFluidFlow *x, double f) {
   x->riseCutoff = SDT_fclip(f, 0.0, 1.0);
 }
 
+// Draws the number of samples until the next bubble
+static double drawWait(const SDTFluidFlow *x) {
+  if (x->avgRate <= 0.0) return HUGE_VAL;
+  return SDT_expRand(x->avgRate * SDT_timeStep);
+}
+
 void SDTFluidFlow_setAvgRate(SDTFluidFlow *x, double f) {
   x->avgRate = SDT_fclip(f, 0.0, MAX_RATE);
-  x->success = x->avgRate * SDT_timeStep;
+  // Arrivals are memoryless, so the wait can be drawn again
+  x->wait = drawWait(x);
+}
+
+static void heapSwap(SDTFluidFlow *x, int i, int j) {
+  int t;
+
+  t = x->heap[i];
+  x->heap[i] = x->heap[j];
+  x->heap[j] = t;
+  x->heapPos[x->heap[i]] = i;
+  x->heapPos[x->heap[j]] = j;
+}
+
+static double heapKey(const SDTFluidFlow *x, int i) {
+  return x->voices[VOICE_END][x->heap[i]];
+}
+
+static void heapUp(SDTFluidFlow *x, int i) {
+  int parent;
+
+  while (i > 0) {
+    parent = (i - 1) / 2;
+    if (heapKey(x, parent) <= heapKey(x, i)) break;
+    heapSwap(x, i, parent);
+    i = parent;
+  }
+}
+
+static void heapDown(SDTFluidFlow *x, int i) {
+  int child;
+
+  while ((child = 2 * i + 1) < x->nActive) {
+    if (child + 1 < x->nActive && heapKey(x, child + 1) < heapKey(x, child)) {
+      child++;
+    }
+    if (heapKey(x, i) <= heapKey(x, child)) break;
+    heapSwap(x, i, child);
+    i = child;
+  }
+}
+
+/* Starts a new bubble on an idle voice, or else on the voice which is closest
+   to falling silent */
+static void spawnBubble(SDTFluidFlow *x) {
+  double **v, radius, depth, amp, decay, gain, step, rise;
+  int voice;
+
+  v = x->voices;
+  if (x->nActive < x->nBubbles) {
+    voice = x->nActive++;
+    x->heap[voice] = voice;
+    x->heapPos[voice] = voice;
+    v[VOICE_LAST_OUT][voice] = 0.0;
+  } else {
+    voice = x->heap[0];
+    v[VOICE_LAST_OUT][voice] = v[VOICE_OUT][voice];
+  }
+  radius = SDT_scale(rand(), 0.0, RAND_MAX, x->minRadius, x->maxRadius,
+                     x->expRadius);
+  depth =
+      SDT_scale(rand(), 0.0, RAND_MAX, x->minDepth, x->maxDepth, x->expDepth);
+  bubbleCoefficients(radius, depth,
+                     depth > x->riseCutoff ? x->riseFactor : 0.0, &amp,
+                     &decay, &step, &rise);
+  gain = exp(-decay * SDT_timeStep);
+  v[VOICE_AMP][voice] = amp;
+  v[VOICE_GAIN][voice] = gain;
+  v[VOICE_PHASE][voice] = 0.0;
+  v[VOICE_STEP][voice] = step;
+  v[VOICE_RISE][voice] = rise;
+  v[VOICE_OUT][voice] = 0.0;
+  v[VOICE_RE][voice] = 1.0;
+  v[VOICE_IM][voice] = 0.0;
+  v[VOICE_STEP_RE][voice] = cos(SDT_TWOPI * step);
+  v[VOICE_STEP_IM][voice] = sin(SDT_TWOPI * step);
+  v[VOICE_RISE_RE][voice] = cos(SDT_TWOPI * rise);
+  v[VOICE_RISE_IM][voice] = sin(SDT_TWOPI * rise);
+  v[VOICE_END][voice] = x->time + bubbleLife(amp, gain, step);
+  heapUp(x, x->heapPos[voice]);
+  heapDown(x, x->heapPos[voice]);
+}
+
+/* Releases the voice on top of the heap, moving the last playing voice in its
+   place to keep the playing voices contiguous */
+static void releaseBubble(SDTFluidFlow *x) {
+  int voice, last, i;
+
+  voice = x->heap[0];
+  heapSwap(x, 0, x->nActive - 1);
+  x->nActive--;
+  heapDown(x, 0);
+  last = x->nActive;
+  if (voice == last) return;
+  for (i = 0; i < N_VOICE_ARRAYS; i++) {
+    x->voices[i][voice] = x->voices[i][last];
+  }
+  x->heapPos[voice] = x->heapPos[last];
+  x->heap[x->heapPos[voice]] = voice;
+}
+
+/* Advances the playing voices by one sample, like SDTBubble_dsp(). Voices are
+   independent from each other, so the loop carries no dependencies and can be
+   vectorized by the compiler. Silent voices are not skipped, but they are
+   released within a few samples, while below SDT_QUIET. */
+static void dspVoices(int n, double *restrict amp, const double *restrict gain,
+                      double *restrict phase, double *restrict step,
+                      const double *restrict rise, double *restrict out,
+                      const double *restrict lastOut, double *restrict re,
+                      double *restrict im, double *restrict stepRe,
+                      double *restrict stepIm, const double *restrict riseRe,
+                      const double *restrict riseIm) {
+  double alpha, t;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    // Branchless min(phase, 1), since comparisons would block vectorization
+    alpha = 0.5 * (phase[i] + 1.0 - fabs(phase[i] - 1.0));
+    out[i] = (1.0 - alpha) * lastOut[i] + alpha * amp[i] * im[i];
+    t = re[i] * stepRe[i] - im[i] * stepIm[i];
+    im[i] = re[i] * stepIm[i] + im[i] * stepRe[i];
+    re[i] = t;
+    t = stepRe[i] * riseRe[i] - stepIm[i] * riseIm[i];
+    stepIm[i] = stepRe[i] * riseIm[i] + stepIm[i] * riseRe[i];
+    stepRe[i] = t;
+    phase[i] += step[i];
+    step[i] += rise[i];
+    amp[i] *= gain[i];
+  }
 }
 
-double SDTFluidFlow_dsp(SDTFluidFlow *x) {
-  SDTBubble *bubble;
-  double minAmp, radius, depth, riseFactor, result;
+static double dspFlow(SDTFluidFlow *x) {
+  double **v, result;
   int i;
 
-  if (SDT_frand() < x->success) {
-    minAmp = x->bubbles[0]->amp;
-    bubble = x->bubbles[0];
-    for (i = 1; i < x->nBubbles; i++) {
-      if (x->bubbles[i]->amp < minAmp) {
-        minAmp = x->bubbles[i]->amp;
-        bubble = x->bubbles[i];
+  if (x->nBubbles < 1) return 0.0;
+  while (x->wait < 1.0) {
+    spawnBubble(x);
+    x->wait += drawWait(x);
+  }
+  x->wait -= 1.0;
+  v = x->voices;
+  dspVoices(x->nActive, v[VOICE_AMP], v[VOICE_GAIN], v[VOICE_PHASE],
+            v[VOICE_STEP], v[VOICE_RISE], v[VOICE_OUT], v[VOICE_LAST_OUT],
+            v[VOICE_RE], v[VOICE_IM], v[VOICE_STEP_RE], v[VOICE_STEP_IM],
+            v[VOICE_RISE_RE], v[VOICE_RISE_IM]);
+  result = 0.0;
+  for (i = 0; i < x->nActive; i++) result += v[VOICE_OUT][i];
+  // Release the voices which fell silent
+  x->time += 1.0;
+  while (x->nActive > 0 && heapKey(x, 0) <= x->time) releaseBubble(x);
+  return result * x->gain;
+}
+
+double SDTFluidFlow_dsp(SDTFluidFlow *x) { return dspFlow(x); }
+
+void SDTFluidFlow_dspBlock(SDTFluidFlow *x, double *outs, unsigned int n) {
+  unsigned int i;
+
+  for (i = 0; i < n; i++) outs[i] = dspFlow(x);
+}
+
+//-------------------------------------------------------------------------------------//
+
+// Blackman-Harris synthesis kernel: half width in bins and table oversampling
+#define KERNEL_WIDTH 4
+#define KERNEL_OVERSAMPLING 64
+
+// Partial state arrays, in the order they are stored
+enum {
+  PARTIAL_AMP,
+  PARTIAL_GAIN,
+  PARTIAL_BIN,
+  PARTIAL_BIN_RISE,
+  PARTIAL_RE,
+  PARTIAL_IM,
+  PARTIAL_ROT_RE,
+  PARTIAL_ROT_IM,
+  PARTIAL_RISE_RE,
+  PARTIAL_RISE_IM,
+  N_PARTIAL_ARRAYS
+};
+
+struct SDTSpectralFlow {
+  SDTFFT *fft;
+  SDTComplex *spectrum;
+  /* Bubble state at the center of the next frame, with one contiguous array
+     per variable. Playing partials come first. */
+  double *partials[N_PARTIAL_ARRAYS];
+  double *kernel, *window, *frame, *ola;
+  double minRadius, maxRadius, expRadius, minDepth, maxDepth, expDepth,
+      riseFactor, riseCutoff, avgRate, wait, gain;
+  int nBubbles, nActive, quietest, hopSize, frameSize, pos;
+};
+
+static void allocatePartials(SDTSpectralFlow *x, int nBubbles) {
+  double *storage;
+  int i;
+
+  x->nBubbles = nBubbles > 0 ? nBubbles : 0;
+  storage =
+      (double *)calloc(N_PARTIAL_ARRAYS * x->nBubbles + 1, sizeof(double));
+  for (i = 0; i < N_PARTIAL_ARRAYS; i++) {
+    x->partials[i] = storage + i * x->nBubbles;
+  }
+  x->nActive = 0;
+  x->quietest = -1;
+}
+
+SDTSpectralFlow *SDTSpectralFlow_new(int nBubbles) {
+  SDTSpectralFlow *x;
+  double a, u;
+  int i, t;
+
+  x = (SDTSpectralFlow *)malloc(sizeof(SDTSpectralFlow));
+  allocatePartials(x, nBubbles);
+  x->hopSize = SDT_SPECTRALFLOW_HOPSIZE;
+  x->frameSize = 4 * x->hopSize;
+  x->fft = SDTFFT_new(x->frameSize / 2);
+  x->spectrum =
+      (SDTComplex *)calloc(x->frameSize / 2 + 1, sizeof(SDTComplex));
+  x->kernel = (double *)calloc(KERNEL_WIDTH * KERNEL_OVERSAMPLING + 2,
+                               sizeof(double));
+  x->window = (double *)calloc(2 * x->hopSize, sizeof(double));
+  x->frame = (double *)calloc(x->frameSize, sizeof(double));
+  x->ola = (double *)calloc(2 * x->hopSize, sizeof(double));
+  /* Same synthesis kernel and window as the spectral resonator: spectrum of a
+     zero-phase Blackman-Harris window, and a triangular synthesis window
+     compensating for it, so that frames overlap-add to unity */
+  for (i = 0; i <= KERNEL_WIDTH * KERNEL_OVERSAMPLING; i++) {
+    a = SDT_TWOPI * i / KERNEL_OVERSAMPLING / x->frameSize;
+    for (t = 0; t < x->frameSize; t++) {
+      u = SDT_TWOPI * (t - x->frameSize / 2) / x->frameSize;
+      x->kernel[i] += (0.35875 + 0.48829 * cos(u) + 0.14128 * cos(2.0 * u) +
+                       0.01168 * cos(3.0 * u)) *
+                      cos(a * (t - x->frameSize / 2));
+    }
+  }
+  for (t = 0; t < 2 * x->hopSize; t++) {
+    u = SDT_TWOPI * (t - x->hopSize) / x->frameSize;
+    x->window[t] = (1.0 - fabs(t - x->hopSize) / x->hopSize) /
+                   (0.35875 + 0.48829 * cos(u) + 0.14128 * cos(2.0 * u) +
+                    0.01168 * cos(3.0 * u)) /
+                   x->frameSize;
+  }
+  x->minRadius = 0.00015;
+  x->maxRadius = 0.015;
+  x->expRadius = 1.0;
+  x->minDepth = 0.0;
+  x->maxDepth = 1.0;
+  x->expDepth = 1.0;
+  x->riseFactor = 0.1;
+  x->riseCutoff = 0.9;
+  x->avgRate = 0.0;
+  x->wait = HUGE_VAL;
+  x->gain = 1.0;
+  x->pos = x->hopSize;
+  return x;
+}
+
+void SDTSpectralFlow_free(SDTSpectralFlow *x) {
+  free(x->partials[0]);
+  SDTFFT_free(x->fft);
+  free(x->spectrum);
+  free(x->kernel);
+  free(x->window);
+  free(x->frame);
+  free(x->ola);
+  free(x);
+}
+
+void SDTSpectralFlow_setNBubbles(SDTSpectralFlow *x, int f) {
+  free(x->partials[0]);
+  allocatePartials(x, f);
+}
+
+_SDT_COPY_FUNCTION(SpectralFlow)
+
+_SDT_HASHMAP_FUNCTIONS(SpectralFlow)
+
+json_value *SDTSpectralFlow_toJSON(const SDTSpectralFlow *x) {
+  json_value *obj = json_object_new(0);
+
+  json_object_push(obj, "nBubbles",
+                   json_integer_new(SDTSpectralFlow_getNBubbles(x)));
+  json_object_push(obj, "avgRate",
+                   json_double_new(SDTSpectralFlow_getAvgRate(x)));
+  json_object_push(obj, "minRadius",
+                   json_double_new(SDTSpectralFlow_getMinRadius(x)));
+  json_object_push(obj, "maxRadius",
+                   json_double_new(SDTSpectralFlow_getMaxRadius(x)));
+  json_object_push(obj, "expRadius",
+                   json_double_new(SDTSpectralFlow_getExpRadius(x)));
+  json_object_push(obj, "minDepth",
+                   json_double_new(SDTSpectralFlow_getMinDepth(x)));
+  json_object_push(obj, "maxDepth",
+                   json_double_new(SDTSpectralFlow_getMaxDepth(x)));
+  json_object_push(obj, "expDepth",
+                   json_double_new(SDTSpectralFlow_getExpDepth(x)));
+  json_object_push(obj, "riseFactor",
+                   json_double_new(SDTSpectralFlow_getRiseFactor(x)));
+  json_object_push(obj, "riseCutoff",
+                   json_double_new(SDTSpectralFlow_getRiseCutoff(x)));
+  return obj;
+}
+
+SDTSpectralFlow *SDTSpectralFlow_fromJSON(const json_value *x) {
+  if (!x || x->type != json_object) return 0;
+
+  unsigned int nBubbles = SDT_SPECTRALFLOW_NBUBBLES_DEFAULT;
+  _SDT_GET_PARAM_FROM_JSON(nBubbles, x, nBubbles, integer);
+
+  SDTSpectralFlow *y = SDTSpectralFlow_new(nBubbles);
+  return SDTSpectralFlow_setParams(y, x, 0);
+}
+
+SDTSpectralFlow *SDTSpectralFlow_setParams(SDTSpectralFlow *x,
+                                           const json_value *j,
+                                           unsigned char unsafe) {
+  if (!x || !j || j->type != json_object) return 0;
+
+  _SDT_SET_UNSAFE_PARAM_FROM_JSON(SpectralFlow, x, j, NBubbles, nBubbles,
+                                  integer, unsafe);
+
+  _SDT_SET_DOUBLE_FROM_JSON(SpectralFlow, x, j, AvgRate, avgRate);
+  _SDT_SET_DOUBLE_FROM_JSON(SpectralFlow, x, j, MinRadius, minRadius);
+  _SDT_SET_DOUBLE_FROM_JSON(SpectralFlow, x, j, MaxRadius, maxRadius);
+  _SDT_SET_DOUBLE_FROM_JSON(SpectralFlow, x, j, ExpRadius, expRadius);
+  _SDT_SET_DOUBLE_FROM_JSON(SpectralFlow, x, j, MinDepth, minDepth);
+  _SDT_SET_DOUBLE_FROM_JSON(SpectralFlow, x, j, MaxDepth, maxDepth);
+  _SDT_SET_DOUBLE_FROM_JSON(SpectralFlow, x, j, ExpDepth, expDepth);
+  _SDT_SET_DOUBLE_FROM_JSON(SpectralFlow, x, j, RiseFactor, riseFactor);
+  _SDT_SET_DOUBLE_FROM_JSON(SpectralFlow, x, j, RiseCutoff, riseCutoff);
+
+  return x;
+}
+
+int SDTSpectralFlow_getNBubbles(const SDTSpectralFlow *x) {
+  return x->nBubbles;
+}
+
+int SDTSpectralFlow_getActiveVoices(const SDTSpectralFlow *x) {
+  return x->nActive;
+}
+
+int SDTSpectralFlow_getHopSize(const SDTSpectralFlow *x) {
+  return x->hopSize;
+}
+
+double SDTSpectralFlow_getAvgRate(const SDTSpectralFlow *x) {
+  return x->avgRate;
+}
+
+double SDTSpectralFlow_getMinRadius(const SDTSpectralFlow *x) {
+  return x->minRadius;
+}
+
+double SDTSpectralFlow_getMaxRadius(const SDTSpectralFlow *x) {
+  return x->maxRadius;
+}
+
+double SDTSpectralFlow_getExpRadius(const SDTSpectralFlow *x) {
+  return x->expRadius;
+}
+
+double SDTSpectralFlow_getMinDepth(const SDTSpectralFlow *x) {
+  return x->minDepth;
+}
+
+double SDTSpectralFlow_getMaxDepth(const SDTSpectralFlow *x) {
+  return x->maxDepth;
+}
+
+double SDTSpectralFlow_getExpDepth(const SDTSpectralFlow *x) {
+  return x->expDepth;
+}
+
+double SDTSpectralFlow_getRiseFactor(const SDTSpectralFlow *x) {
+  return x->riseFactor;
+}
+
+double SDTSpectralFlow_getRiseCutoff(const SDTSpectralFlow *x) {
+  return x->riseCutoff;
+}
+
+void SDTSpectralFlow_setMinRadius(SDTSpectralFlow *x, double f) {
+  x->minRadius = SDT_fclip(f, MIN_RADIUS, x->maxRadius);
+}
+
+void SDTSpectralFlow_setMaxRadius(SDTSpectralFlow *x, double f) {
+  x->maxRadius = SDT_fclip(f, x->minRadius, MAX_RADIUS);
+  x->gain = MAX_RADIUS / x->maxRadius;
+}
+
+void SDTSpectralFlow_setExpRadius(SDTSpectralFlow *x, double f) {
+  x->expRadius = SDT_fclip(f, 0.0, MAX_EXP);
+}
+
+void SDTSpectralFlow_setMinDepth(SDTSpectralFlow *x, double f) {
+  x->minDepth = SDT_fclip(f, 0.0, x->maxDepth);
+}
+
+void SDTSpectralFlow_setMaxDepth(SDTSpectralFlow *x, double f) {
+  x->maxDepth = SDT_fclip(f, x->minDepth, 1.0);
+}
+
+void SDTSpectralFlow_setExpDepth(SDTSpectralFlow *x, double f) {
+  x->expDepth = SDT_fclip(f, 0.0, MAX_EXP);
+}
+
+void SDTSpectralFlow_setRiseFactor(SDTSpectralFlow *x, double f) {
+  x->riseFactor = SDT_fclip(f, 0.0, MAX_RISE);
+}
+
+void SDTSpectralFlow_setRiseCutoff(SDTSpectralFlow *x, double f) {
+  x->riseCutoff = SDT_fclip(f, 0.0, 1.0);
+}
+
+void SDTSpectralFlow_setAvgRate(SDTSpectralFlow *x, double f) {
+  x->avgRate = SDT_fclip(f, 0.0, MAX_RATE);
+  if (x->avgRate <= 0.0) {
+    x->wait = HUGE_VAL;
+    return;
+  }
+  // The wait is counted from the center of the next frame
+  x->wait = SDT_expRand(x->avgRate * SDT_timeStep) -
+            (2 * x->hopSize - x->pos);
+}
+
+/* Starts a bubble which was born n samples before the center of the next
+   frame, on an idle partial or else on the quietest partial of the last
+   frame. The state of the bubble is evaluated at the frame center, following
+   the phase and amplitude of SDTBubble_dsp(). */
+static void spawnPartial(SDTSpectralFlow *x, double n) {
+  double **p, radius, depth, amp, decay, step, rise, f, h, a;
+  int partial;
+
+  radius = SDT_scale(rand(), 0.0, RAND_MAX, x->minRadius, x->maxRadius,
+                     x->expRadius);
+  depth =
+      SDT_scale(rand(), 0.0, RAND_MAX, x->minDepth, x->maxDepth, x->expDepth);
+  bubbleCoefficients(radius, depth,
+                     depth > x->riseCutoff ? x->riseFactor : 0.0, &amp,
+                     &decay, &step, &rise);
+  amp *= exp(-decay * SDT_timeStep * n);
+  f = step + rise * n;
+  if (amp < SDT_QUIET || f >= 0.5) return;
+  if (x->nActive < x->nBubbles) {
+    partial = x->nActive++;
+  } else if (x->quietest >= 0) {
+    partial = x->quietest;
+    x->quietest = -1;
+  } else {
+    return;
+  }
+  p = x->partials;
+  h = x->hopSize;
+  p[PARTIAL_AMP][partial] = amp;
+  p[PARTIAL_GAIN][partial] = exp(-decay * SDT_timeStep * h);
+  p[PARTIAL_BIN][partial] = f * x->frameSize;
+  p[PARTIAL_BIN_RISE][partial] = rise * h * x->frameSize;
+  // Phase at the frame center, and its increments over the following hops
+  a = SDT_TWOPI * (step * n + 0.5 * rise * n * (n - 1.0));
+  p[PARTIAL_RE][partial] = cos(a);
+  p[PARTIAL_IM][partial] = sin(a);
+  a = SDT_TWOPI * (f * h + 0.5 * rise * h * (h - 1.0));
+  p[PARTIAL_ROT_RE][partial] = cos(a);
+  p[PARTIAL_ROT_IM][partial] = sin(a);
+  a = SDT_TWOPI * rise * h * h;
+  p[PARTIAL_RISE_RE][partial] = cos(a);
+  p[PARTIAL_RISE_IM][partial] = sin(a);
+}
+
+static void releasePartial(SDTSpectralFlow *x, int partial) {
+  int i, last;
+
+  last = --x->nActive;
+  for (i = 0; i < N_PARTIAL_ARRAYS; i++) {
+    x->partials[i][partial] = x->partials[i][last];
+  }
+}
+
+/* Adds the bubbles born before the center of the next frame, synthesizes the
+   frame and overlap-adds it to the output buffer */
+static void spectralFlowFrame(SDTSpectralFlow *x) {
+  double **p, b, d, w, cr, ci, re, im, rotRe, rotIm, minAmp;
+  int nBins, partial, k, kk, i;
+
+  p = x->partials;
+  nBins = x->frameSize / 2;
+  // Bubbles are born on whole samples, as in the fluid flow
+  while (x->wait < 1.0) {
+    spawnPartial(x, -floor(x->wait));
+    x->wait += SDT_expRand(x->avgRate * SDT_timeStep);
+  }
+  x->wait -= x->hopSize;
+  memmove(x->ola, x->ola + x->hopSize, x->hopSize * sizeof(double));
+  memset(x->ola + x->hopSize, 0, x->hopSize * sizeof(double));
+  if (x->nActive < 1) return;
+  memset(x->spectrum, 0, (nBins + 1) * sizeof(SDTComplex));
+  for (partial = 0; partial < x->nActive; partial++) {
+    // Analytic signal of the bubble at the frame center, as in SDTBubble_dsp()
+    cr = p[PARTIAL_AMP][partial] * p[PARTIAL_IM][partial];
+    ci = -p[PARTIAL_AMP][partial] * p[PARTIAL_RE][partial];
+    // Only the main lobe of the window spectrum is synthesized
+    b = p[PARTIAL_BIN][partial];
+    for (k = (int)ceil(b - KERNEL_WIDTH); k <= (int)floor(b + KERNEL_WIDTH);
+         k++) {
+      d = fabs(k - b) * KERNEL_OVERSAMPLING;
+      i = (int)d;
+      w = x->kernel[i] + (d - i) * (x->kernel[i + 1] - x->kernel[i]);
+      // Half amplitude, and a phase shift centering the window in the frame
+      w *= (k & 1) ? -0.5 : 0.5;
+      // Bins outside [0, nBins] fold back as complex conjugates
+      kk = k;
+      if (k < 0 || k > nBins) {
+        kk = k < 0 ? -k : x->frameSize - k;
+        x->spectrum[kk].r += w * cr;
+        x->spectrum[kk].i -= w * ci;
+        continue;
       }
+      x->spectrum[kk].r += w * cr;
+      x->spectrum[kk].i += w * ci;
+      // DC and Nyquist bins also receive their own conjugates
+      if (kk == 0 || kk == nBins) x->spectrum[kk].r += w * cr;
     }
-    radius = SDT_scale(rand(), 0.0, RAND_MAX, x->minRadius, x->maxRadius,
-                       x->expRadius);
-    depth =
-        SDT_scale(rand(), 0.0, RAND_MAX, x->minDepth, x->maxDepth, x->expDepth);
-    riseFactor = depth > x->riseCutoff ? x->riseFactor : 0.0;
-    SDTBubble_setRadius(bubble, radius);
-    SDTBubble_setDepth(bubble, depth);
-    SDTBubble_setRiseFactor(bubble, riseFactor);
-    SDTBubble_trigger(bubble);
   }
-  result = 0.0;
-  for (i = 0; i < x->nBubbles; i++) {
-    result += SDTBubble_dsp(x->bubbles[i]);
+  SDTFFT_ifftr(x->fft, x->spectrum, x->frame);
+  for (i = 0; i < 2 * x->hopSize; i++) {
+    x->ola[i] += x->frame[nBins - x->hopSize + i] * x->window[i];
+  }
+  /* Advances the partials to the center of the next frame. Bubbles which fell
+     silent or rose above the Nyquist frequency fade out over the next hop. */
+  x->quietest = -1;
+  minAmp = HUGE_VAL;
+  partial = 0;
+  while (partial < x->nActive) {
+    p[PARTIAL_AMP][partial] *= p[PARTIAL_GAIN][partial];
+    p[PARTIAL_BIN][partial] += p[PARTIAL_BIN_RISE][partial];
+    if (p[PARTIAL_AMP][partial] < SDT_QUIET ||
+        p[PARTIAL_BIN][partial] >= nBins) {
+      releasePartial(x, partial);
+      continue;
+    }
+    re = p[PARTIAL_RE][partial];
+    im = p[PARTIAL_IM][partial];
+    rotRe = p[PARTIAL_ROT_RE][partial];
+    rotIm = p[PARTIAL_ROT_IM][partial];
+    p[PARTIAL_RE][partial] = re * rotRe - im * rotIm;
+    p[PARTIAL_IM][partial] = re * rotIm + im * rotRe;
+    p[PARTIAL_ROT_RE][partial] = rotRe * p[PARTIAL_RISE_RE][partial] -
+                                 rotIm * p[PARTIAL_RISE_IM][partial];
+    p[PARTIAL_ROT_IM][partial] = rotRe * p[PARTIAL_RISE_IM][partial] +
+                                 rotIm * p[PARTIAL_RISE_RE][partial];
+    if (p[PARTIAL_AMP][partial] < minAmp) {
+      minAmp = p[PARTIAL_AMP][partial];
+      x->quietest = partial;
+    }
+    partial++;
+  }
+}
+
+double SDTSpectralFlow_dsp(SDTSpectralFlow *x) {
+  double out;
+
+  SDTSpectralFlow_dspBlock(x, &out, 1);
+  return out;
+}
+
+void SDTSpectralFlow_dspBlock(SDTSpectralFlow *x, double *outs,
+                              unsigned int n) {
+  unsigned int i;
+
+  for (i = 0; i < n; i++) {
+    if (x->pos == x->hopSize) {
+      spectralFlowFrame(x);
+      x->pos = 0;
+    }
+    outs[i] = x->ola[x->pos++] * x->gain;
   }
-  result *= x->gain;
-  return result;
 }
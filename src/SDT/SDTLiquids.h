@@ -118,7 +118,8 @@ extern void SDTBubble_trigger(SDTBubble *x);
 extern void SDTBubble_normAmp(SDTBubble *x);
 
 /** @brief Signal processing routine.
-Call this function at sample rate to obtain a bubble sound.
+Call this function at sample rate to obtain a bubble sound. The oscillation is
+computed by rotating a phasor, without evaluating any sine function.
 @return Output sample */
 extern double SDTBubble_dsp(SDTBubble *x);
 
@@ -129,11 +130,13 @@ Rich and complex liquid sound simulations can be generated
 through a stochastic population of bubbles, modeled by a sinusoidal oscillator
 bank with each voice modulated in amplitude and frequency according to desired
 probability distributions. A simple stochastic algorithm controls the behavior
-of the bubble population: Bubble generation rate follows a Bernoulli process,
+of the bubble population: Bubble generation follows a Poisson process,
 while radius and depth for each new bubble are chosen at random.
-To limit the presence of sudden peaks and glitches, voices are updated based on
-their age: The bubble with the lowest amplitude gets "killed" in favor of the
-new one.
+The state of all the voices is kept in contiguous arrays, so that the playing
+voices are computed together. Each voice is released as soon as its bubble
+falls silent. To limit the presence of sudden peaks and glitches, when
+no voice is free the bubble which is closest to falling silent gets "killed"
+in favor of the new one.
 @{ */
 
 /** @brief Opaque data structure representing a fluid flow object */
@@ -183,6 +186,10 @@ extern int SDT_unregisterFluidFlow(const char *key);
 @return Number of voices in the oscillator bank */
 extern int SDTFluidFlow_getNBubbles(const SDTFluidFlow *x);
 
+/** @brief Gets the number of bubbles playing.
+@return Number of busy voices */
+extern int SDTFluidFlow_getActiveVoices(const SDTFluidFlow *x);
+
 /** @brief Gets the minimum radius for the bubble population.
 @return Minimum radius of the generated bubbles, in m [0.00015, 0.150] */
 extern double SDTFluidFlow_getMinRadius(const SDTFluidFlow *x);
@@ -286,6 +293,211 @@ Call this function at sample rate to obtain a liquid sound.
 @return Output sample */
 extern double SDTFluidFlow_dsp(SDTFluidFlow *x);
 
+/** @brief Block signal processing routine.
+Equivalent to calling SDTFluidFlow_dsp() once per sample for n samples, which
+is what it does: bubbles are born and released on exact samples, so the block
+is not processed several samples at a time. Vectorization runs across the
+playing voices within each sample instead, and only pays off with many
+overlapping bubbles.
+@param[out] outs Output buffer, n samples
+@param[in] n Number of samples */
+extern void SDTFluidFlow_dspBlock(SDTFluidFlow *x, double *outs,
+                                  unsigned int n);
+
+/** @} */
+
+/** @defgroup spectralflow Spectral fluid flow
+Dense liquid textures, such as heavy rain, boiling or waterfalls, are made of
+tens of thousands of bubbles per second. The spectral fluid flow renders the
+same bubble population as the fluid flow, with the same statistical controls,
+but synthesizes it in the frequency domain. Every hop, each bubble is
+approximated by a stationary sinusoid, whose spectrum is the main lobe of a
+Blackman-Harris window added to a frame in a handful of bins. The frame is
+brought back to the time domain by a single inverse FFT and overlap-added to
+the output, so that amplitude, frequency and phase of each bubble are
+interpolated from one hop to the next.
+
+The cost of a bubble depends on the hop rate rather than on the sample rate,
+while every frame has the fixed cost of an inverse FFT. The trade-offs are
+bubble onsets smoothed over one hop, and bubbles decaying in less than a few
+hops losing accuracy. When no voice is free, the quietest bubble of the last
+frame gets replaced by the new one, and further new bubbles are discarded until
+the next frame.
+@{ */
+
+/** @brief Opaque data structure representing a spectral fluid flow object */
+typedef struct SDTSpectralFlow SDTSpectralFlow;
+
+#define SDT_SPECTRALFLOW_NBUBBLES_DEFAULT 4096
+
+/** @brief Hop size of the spectral fluid flow, in samples.
+Frames are four hops long. */
+#define SDT_SPECTRALFLOW_HOPSIZE 64
+
+/** @brief Object constructor.
+@param[in] nBubbles Maximum number of simultaneous bubbles
+@return Pointer to the new instance */
+extern SDTSpectralFlow *SDTSpectralFlow_new(int nBubbles);
+
+/** @brief Object destructor.
+@param[in] x Pointer to the instance to destroy */
+extern void SDTSpectralFlow_free(SDTSpectralFlow *x);
+
+/** @brief Deep-copies a spectral fluid flow.
+@param[in] dest Pointer to the instance to modify
+@param[in] src Pointer to the instance to copy
+@param[in] unsafe If false, do not perform any memory-related changes
+@return Pointer to destination instance */
+extern SDTSpectralFlow *SDTSpectralFlow_copy(SDTSpectralFlow *dest,
+                                             const SDTSpectralFlow *src,
+                                             unsigned char unsafe);
+
+/** @brief Registers a spectral fluid flow into the spectral fluid flows list
+with a unique ID.
+@param[in] x SpectralFlow instance to register
+@param[in] key Unique ID assigned to the spectral fluid flow instance
+@return Zero on success, otherwise one */
+extern int SDT_registerSpectralFlow(SDTSpectralFlow *x, const char *key);
+
+/** @brief Queries the spectral fluid flows list by its unique ID.
+If a spectral fluid flow with the ID is present, a pointer to it is returned.
+Otherwise, a NULL pointer is returned.
+@param[in] key Unique ID assigned to the spectral fluid flow instance
+@return SpectralFlow instance pointer */
+extern SDTSpectralFlow *SDT_getSpectralFlow(const char *key);
+
+/** @brief Unregisters a spectral fluid flow from the spectral fluid flows list.
+If a spectral fluid flow with the given ID is present, it is unregistered from
+the list.
+@param[in] key Unique ID of the spectral fluid flow instance to unregister
+@return Zero on success, otherwise one */
+extern int SDT_unregisterSpectralFlow(const char *key);
+
+/** @brief Gets the maximum number of simultaneous bubbles.
+@return Number of voices */
+extern int SDTSpectralFlow_getNBubbles(const SDTSpectralFlow *x);
+
+/** @brief Gets the number of bubbles playing.
+@return Number of busy voices */
+extern int SDTSpectralFlow_getActiveVoices(const SDTSpectralFlow *x);
+
+/** @brief Gets the hop size.
+@return Hop size, in samples */
+extern int SDTSpectralFlow_getHopSize(const SDTSpectralFlow *x);
+
+/** @brief Gets the minimum radius for the bubble population.
+@return Minimum radius of the generated bubbles, in m [0.00015, 0.150] */
+extern double SDTSpectralFlow_getMinRadius(const SDTSpectralFlow *x);
+
+/** @brief Gets the maximum radius for the bubble population.
+@return Maximum radius of the generated bubbles, in m [0.00015, 0.150] */
+extern double SDTSpectralFlow_getMaxRadius(const SDTSpectralFlow *x);
+
+/** @brief Gets the gamma factor for the radius assignment
+@return Radius gamma factor. O to 1 = bigger bubbles, > 1 = smaller bubbles */
+extern double SDTSpectralFlow_getExpRadius(const SDTSpectralFlow *x);
+
+/** @brief Gets the minimum depth value for the bubble population.
+@return Minimum depth value of the generated bubbles, [0, 1] */
+extern double SDTSpectralFlow_getMinDepth(const SDTSpectralFlow *x);
+
+/** @brief Gets the maximum depth value for the bubble population.
+@return Maximum depth value of the generated bubbles, [0, 1] */
+extern double SDTSpectralFlow_getMaxDepth(const SDTSpectralFlow *x);
+
+/** @brief Gets the gamma factor for the depth assignment
+@return Depth gamma factor. O to 1 = shallower bubbles, > 1 = deeper
+bubbles */
+extern double SDTSpectralFlow_getExpDepth(const SDTSpectralFlow *x);
+
+/** @brief Gets the amount of blooping for the bubble population
+@return Rise factor. Typical value for water = 0.1 */
+extern double SDTSpectralFlow_getRiseFactor(const SDTSpectralFlow *x);
+
+/** @brief Bubbles deeper than this threshold do not rise in frequency
+@return Rise cutoff, [0, 1] */
+extern double SDTSpectralFlow_getRiseCutoff(const SDTSpectralFlow *x);
+
+/** @brief Gets the amount of generated bubbles per second.
+@return Average number of bubbles per second */
+extern double SDTSpectralFlow_getAvgRate(const SDTSpectralFlow *x);
+
+/** @brief Represent a spectral fluid flow as a JSON object.
+Keys are the same as in SDTFluidFlow_toJSON().
+@param[in] x Pointer to the instance
+@return JSON object */
+extern json_value *SDTSpectralFlow_toJSON(const SDTSpectralFlow *x);
+
+/** @brief Initialize a spectral fluid flow from a JSON object.
+@param[in] x Pointer to the instance
+@return JSON object */
+extern SDTSpectralFlow *SDTSpectralFlow_fromJSON(const json_value *x);
+
+/** @brief Set parameters of a spectral fluid flow from a JSON object.
+@param[in] x Pointer to the instance
+@param[in] j JSON object
+@param[in] unsafe If false, do not perform any memory-related changes
+@return Pointer to destination instance */
+extern SDTSpectralFlow *SDTSpectralFlow_setParams(SDTSpectralFlow *x,
+                                                  const json_value *j,
+                                                  unsigned char unsafe);
+
+/** @brief Sets the maximum number of simultaneous bubbles.
+@param[in] f Number of voices */
+extern void SDTSpectralFlow_setNBubbles(SDTSpectralFlow *x, int f);
+
+/** @brief Sets the minimum radius for the bubble population.
+@param[in] f Minimum radius of the generated bubbles, in m [0.00015, 0.150] */
+extern void SDTSpectralFlow_setMinRadius(SDTSpectralFlow *x, double f);
+
+/** @brief Sets the maximum radius for the bubble population.
+@param[in] f Maximum radius of the generated bubbles, in m [0.00015, 0.150] */
+extern void SDTSpectralFlow_setMaxRadius(SDTSpectralFlow *x, double f);
+
+/** @brief Sets the gamma factor for the radius assignment
+@param[in] f Radius gamma factor. O to 1 = bigger bubbles, > 1 = smaller bubbles
+*/
+extern void SDTSpectralFlow_setExpRadius(SDTSpectralFlow *x, double f);
+
+/** @brief Sets the minimum depth value for the bubble population.
+@param[in] f Minimum depth value of the generated bubbles, [0, 1] */
+extern void SDTSpectralFlow_setMinDepth(SDTSpectralFlow *x, double f);
+
+/** @brief Sets the maximum depth value for the bubble population.
+@param[in] f Maximum depth value of the generated bubbles, [0, 1] */
+extern void SDTSpectralFlow_setMaxDepth(SDTSpectralFlow *x, double f);
+
+/** @brief Sets the gamma factor for the depth assignment
+@param[in] f Depth gamma factor. O to 1 = shallower bubbles, > 1 = deeper
+bubbles */
+extern void SDTSpectralFlow_setExpDepth(SDTSpectralFlow *x, double f);
+
+/** @brief Sets the amount of blooping for the bubble population
+@param[in] f Rise factor. Typical value for water = 0.1 */
+extern void SDTSpectralFlow_setRiseFactor(SDTSpectralFlow *x, double f);
+
+/** @brief Bubbles deeper than this threshold do not rise in frequency
+@param[in] f Rise cutoff, [0, 1] */
+extern void SDTSpectralFlow_setRiseCutoff(SDTSpectralFlow *x, double f);
+
+/** @brief Sets the amount of generated bubbles per second.
+@param[in] f Average number of bubbles per second */
+extern void SDTSpectralFlow_setAvgRate(SDTSpectralFlow *x, double f);
+
+/** @brief Signal processing routine.
+Call this function at sample rate to obtain a liquid sound. Prefer
+SDTSpectralFlow_dspBlock() when possible.
+@return Output sample */
+extern double SDTSpectralFlow_dsp(SDTSpectralFlow *x);
+
+/** @brief Block signal processing routine.
+Blocks can have any size: a new frame is synthesized whenever a hop boundary
+is crossed.
+@param[out] outs Output buffer, n samples
+@param[in] n Number of samples */
+extern void SDTSpectralFlow_dspBlock(SDTSpectralFlow *x, double *outs,
+                                     unsigned int n);
+
 /** @} */
 
 #ifdef __cplusplus
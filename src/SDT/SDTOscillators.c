@@ -57,7 +57,9 @@ double SDTPinkNoise_dsp(SDTPinkNoise *x) {
 
 //-------------------------------------------------------------------------------------//
 
-double SDT_whiteNoise() {
-  seed = seed * LCG_MULT + LCG_ADD;
-  return (double)seed / (double)0x7FFFFFFF - 1.0;
+double SDT_whiteNoise() { return SDT_whiteNoiseFrom(&seed); }
+
+double SDT_whiteNoiseFrom(unsigned int *state) {
+  *state = *state * LCG_MULT + LCG_ADD;
+  return (double)*state / (double)0x7FFFFFFF - 1.0;
 }
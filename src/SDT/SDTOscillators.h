@@ -30,6 +30,12 @@ extern double SDTPinkNoise_dsp(SDTPinkNoise *x);
 Call this function at sample rate to generate white noise */
 extern double SDT_whiteNoise();
 
+/** @brief Signal processing routine, with a private generator state.
+Same as SDT_whiteNoise(), but advances the given state instead of the seed
+shared by the whole library, so that it can run concurrently on distinct states
+@param[in,out] state Generator state, updated at each call */
+extern double SDT_whiteNoiseFrom(unsigned int *state);
+
 /** @} */
 
 #ifdef __cplusplus
@@ -32,6 +32,7 @@ extern int SDTProject_fromJSON(const json_value *prj, unsigned char unsafe);
   FOO(Demix, demix, );                 \
   FOO(Envelope, envelope, update);     \
   FOO(Explosion, explosion, );         \
+  FOO(ModalBudget, modalbudget, );     \
   FOO(Motor, motor, update);           \
   FOO(Myoelastic, myo, update);        \
   FOO(Pitch, pitch, );                 \
@@ -1,10 +1,13 @@
 #include "SDTResonators.h"
 
+#include <limits.h>
 #include <math.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "SDTCommon.h"
+#include "SDTFFT.h"
 #include "SDTInteractors.h"
 #include "SDTStructs.h"
 
@@ -13,18 +16,99 @@
 #endif
 
 #define MAX_POS 10000.0
+// Relative allowance for rounding errors in the bounds of free oscillations
+#define BOUND_MARGIN 1.001
+// Width of fragment size interpolation cells, in square root of fragment size
+#define FRAGMENT_CELL 0.005
+
+// Modal coefficients depending on fragment size
+#define COEF_M 0
+#define COEF_K 1
+#define COEF_B1 2
+#define COEF_D1 3
+#define COEF_D2 4
+#define COEF_B0V 5
+#define COEF_B1V 6
+#define N_COEFS 7
+
+// Coefficient and state arrays of live modes, packed for block processing
+#define PACK_B1 0
+#define PACK_D1 1
+#define PACK_D2 2
+#define PACK_B0V 3
+#define PACK_B1V 4
+#define PACK_P0 5
+#define PACK_P1 6
+#define PACK_V 7
+#define PACK_F 8
+#define N_PACKED 9
+
+// Number of modal arrays in the storage block
+#define N_ARRAYS (11 + 2 * N_COEFS + N_PACKED)
+
+// Decay time of modes faded out by a mode limit, and time before dropping them
+#define FADE_DECAY 0.01
+#define FADE_TIME 0.05
+
+// Samples between the sleep checks of SDTResonator_dsp()
+#define SLEEP_INTERVAL 64
+
+/* Precision of modal state and filter coefficients. Parameters, gains and
+   the public interface are always double. */
+#ifdef SDT_RESONATOR_FLOAT32
+typedef float SDTModalReal;
+#else
+typedef double SDTModalReal;
+#endif
+
+typedef void (*SDTModalKernel)(SDTModalReal **arrays, const SDTModalReal *fw,
+                               const double *in, const double *projection,
+                               double **outs, int nModes, int nPickups,
+                               unsigned int n);
+
+/* All modal parameters and state live in a single memory block, with a row of
+   gains per pickup */
+typedef struct SDTModalStorage {
+  double *block, **gains;
+  int modeCapacity, pickupCapacity;
+} SDTModalStorage;
 
 struct SDTResonator {
-  double fragmentSize, *freqs, *decays, *weights, **gains, *m, *k, *b1, *a1,
-      *a2, *b0v, *b1v, *p0, *p1, *v, *f;
-  int nModes, nPickups, activeModes;
+  SDTModalStorage *storage;
+  /* Storage built by SDTResonator_reserve(), waiting to be swapped in by the
+     next commit, and the storage it replaced, to be freed outside DSP */
+  _Atomic(SDTModalStorage *) staged, retired;
+  double fragmentSize, sleepThreshold, priority, *freqs, *decays, *weights,
+      **gains, *shares, *projection;
+  SDTModalReal *m, *k, *b1, *d1, *d2, *b0v, *b1v, *p0, *p1, *v, *f, *packed;
+  /* Exact coefficients at the ends of the current interpolation cell,
+     in square root of fragment size. A negative end is not computed. */
+  SDTModalReal *cellA[N_COEFS], *cellB[N_COEFS];
+  double uA, uB;
+  unsigned char *asleep, *dirty, dirtyModes, dirtyPickups;
+  /* Active modes which are simulated and reach at least one pickup, in
+     increasing order. Only these are processed. Their gains are also kept
+     in a projection matrix, with a contiguous row of gains per pickup. */
+  int *live;
+  // Block processing function, specialized for the number of live modes
+  SDTModalKernel kernel;
+  // Incremented whenever the free evolution of the modes is perturbed
+  unsigned long revision;
+  // Incremented whenever a parameter shaping the response changes
+  unsigned long paramRevision;
+  int nModes, nPickups, activeModes, awakeModes, liveModes, modeCapacity,
+      pickupCapacity, reservedModes, reservedPickups, requestedModes,
+      modeLimit, fadeFrom, fadeSamples, sleepClock;
 };
 
 static double modalPosition(const SDTResonator *x, unsigned int mode,
                             double f) {
-  return SDT_fclip(
-      x->b1[mode] * f - x->a1[mode] * x->p0[mode] - x->a2[mode] * x->p1[mode],
-      -MAX_POS, MAX_POS);
+  double p;
+
+  p = x->p0[mode] + (x->p0[mode] - x->p1[mode]) - x->d1[mode] * x->p0[mode] +
+      x->d2[mode] * x->p1[mode] + x->b1[mode] * f;
+  p = p > -MAX_POS ? p : -MAX_POS;
+  return p < MAX_POS ? p : MAX_POS;
 }
 
 static double modalVelocity(const SDTResonator *x, unsigned int mode,
@@ -37,71 +121,341 @@ static double modalEnergy(const SDTResonator *x, unsigned int mode, double p,
   return 0.5 * (x->k[mode] * p * p + x->m[mode] * v * v);
 }
 
-static void distributeForce(const SDTResonator *x, unsigned int pickup,
-                            double *fs, double f) {
+/* Range of the displacement of a mode over its free evolution. The recursion
+   p[n+1] = a1 p[n] - a2 p[n-1], with a1 = 2r cos(wt) and a2 = r^2, scales
+   q = p[n]^2 - a1 p[n] p[n-1] + a2 p[n-1]^2 by a2 at each step, so that
+   oscillations never exceed sqrt(q) / sin(wt). Undamped inertial modes move
+   at constant velocity, until they get clipped. */
+static void modalBounds(const SDTResonator *x, unsigned int mode, double *lo,
+                        double *hi) {
+  double p0, p1, d1, d2, q, s;
+
+  p0 = x->p0[mode];
+  p1 = x->p1[mode];
+  d1 = x->d1[mode];
+  d2 = x->d2[mode];
+  // 4 a2 sin^2(wt) = 4 a2 - a1^2, without cancellation
+  s = d1 * (4.0 - d1) - 4.0 * d2;
+  if (p0 == 0.0 && p1 == 0.0) {
+    *lo = 0.0;
+    *hi = 0.0;
+  } else if (s > 0.0) {
+    q = (p0 - p1) * (p0 - p1) + d1 * p0 * p1 - d2 * p1 * p1;
+    *hi = BOUND_MARGIN * sqrt(4.0 * (1.0 - d2) * fmax(q, 0.0) / s);
+    *hi = fmin(*hi, MAX_POS);
+    *lo = -*hi;
+  } else if (d1 == 0.0 && d2 == 0.0) {
+    *lo = p0 < p1 ? -MAX_POS : p0;
+    *hi = p0 > p1 ? MAX_POS : p0;
+  } else {
+    *lo = -MAX_POS;
+    *hi = MAX_POS;
+  }
+}
+
+// Shares of a force applied to a pickup that go to each mode
+static double *forceShares(const SDTResonator *x, unsigned int pickup) {
+  return x->shares + pickup * x->modeCapacity;
+}
+
+static void updateState(SDTResonator *x, unsigned int mode) {
+  x->p1[mode] = (x->v[mode] - x->b0v[mode] * x->p0[mode]) / x->b1v[mode];
+}
+
+static void wakeMode(SDTResonator *x, unsigned int mode) {
+  if (x->asleep[mode]) {
+    x->asleep[mode] = 0;
+    x->awakeModes++;
+  }
+}
+
+/* Only oscillating and dead modes can sleep: their state is zero at rest.
+   Zero-frequency (inertial) modes can rest at any displacement. */
+static void trySleepMode(SDTResonator *x, unsigned int mode) {
+  if ((x->k[mode] > 0.0 || x->m[mode] <= 0.0) &&
+      modalEnergy(x, mode, x->p0[mode], x->v[mode]) <= x->sleepThreshold) {
+    x->p0[mode] = 0.0;
+    x->p1[mode] = 0.0;
+    x->v[mode] = 0.0;
+    x->asleep[mode] = 1;
+    x->awakeModes--;
+  }
+}
+
+static void countAwakeModes(SDTResonator *x) {
   int mode;
 
+  x->awakeModes = 0;
   for (mode = 0; mode < x->activeModes; mode++) {
-    fs[mode] = x->gains[pickup][x->nModes] > 0.0
-                   ? f * x->gains[pickup][mode] / x->gains[pickup][x->nModes]
-                   : f / x->activeModes;
+    if (!x->asleep[mode]) x->awakeModes++;
   }
 }
 
-static void updateState(SDTResonator *x, unsigned int mode) {
-  x->p1[mode] = (x->v[mode] - x->b0v[mode] * x->p0[mode]) / x->b1v[mode];
+// Advances a mode by one sample, with input fin distributed with weights fw
+#define _SDT_MODAL_STEP(B1, D1, D2, B0V, B1V, FW, FIN, P0, P1, V, F, MODE) \
+  {                                                                       \
+    SDTModalReal p = P0[MODE] + (P0[MODE] - P1[MODE]) -                   \
+                     D1[MODE] * P0[MODE] + D2[MODE] * P1[MODE] +          \
+                     B1[MODE] * (F[MODE] + FIN * FW[MODE]);               \
+    p = p > (SDTModalReal)-MAX_POS ? p : (SDTModalReal)-MAX_POS;          \
+    p = p < (SDTModalReal)MAX_POS ? p : (SDTModalReal)MAX_POS;            \
+    V[MODE] = B0V[MODE] * p + B1V[MODE] * P0[MODE];                       \
+    P1[MODE] = P0[MODE];                                                  \
+    P0[MODE] = p;                                                         \
+    F[MODE] = 0.0;                                                        \
+  }
+
+/* Projects the positions of modes to a pickup, with a row of the projection
+   matrix. Rows are contiguous, so the product vectorizes over modes. */
+#define _SDT_MODAL_PROJECT(NMODES, P0, ROW, OUT) \
+  {                                              \
+    double acc_ = 0.0;                           \
+    int mode_;                                   \
+                                                 \
+    for (mode_ = 0; mode_ < NMODES; mode_++) {   \
+      acc_ += P0[mode_] * ROW[mode_];            \
+    }                                            \
+    OUT = acc_;                                  \
+  }
+
+/* Advances all modes by one sample. Modes are independent from each other, so
+   the loop carries no dependencies and can be vectorized by the compiler. */
+static void dspModes(int nModes, const SDTModalReal *restrict b1,
+                     const SDTModalReal *restrict d1,
+                     const SDTModalReal *restrict d2,
+                     const SDTModalReal *restrict b0v,
+                     const SDTModalReal *restrict b1v,
+                     const SDTModalReal *restrict fw, SDTModalReal fin,
+                     SDTModalReal *restrict p0, SDTModalReal *restrict p1,
+                     SDTModalReal *restrict v, SDTModalReal *restrict f) {
+  int mode;
+
+  for (mode = 0; mode < nModes; mode++) {
+    _SDT_MODAL_STEP(b1, d1, d2, b0v, b1v, fw, fin, p0, p1, v, f, mode)
+  }
 }
 
-static void updateMode(SDTResonator *x, unsigned int mode) {
-  double u, w, wt, m, k, d, g, r, coswt, sincwt, tsincwt;
+/* Processes a block of samples with the live modes packed in arrays.
+   Input is optional and distributed to the modes with weights fw. */
+static void modalKernel(SDTModalReal **arrays, const SDTModalReal *fw,
+                        const double *in, const double *projection,
+                        double **outs, int nModes, int nPickups,
+                        unsigned int n) {
+  double fin;
+  int k;
+  unsigned int i;
+
+  for (i = 0; i < n; i++) {
+    fin = in ? in[i] : 0.0;
+    if (!isnormal(fin)) fin = 0.0;
+    dspModes(nModes, arrays[PACK_B1], arrays[PACK_D1], arrays[PACK_D2],
+             arrays[PACK_B0V], arrays[PACK_B1V], fw, fin, arrays[PACK_P0],
+             arrays[PACK_P1], arrays[PACK_V], arrays[PACK_F]);
+    if (!outs) continue;
+    for (k = 0; k < nPickups; k++) {
+      if (!outs[k]) continue;
+      _SDT_MODAL_PROJECT(nModes, arrays[PACK_P0], (projection + k * nModes),
+                         outs[k][i])
+    }
+  }
+}
 
-  u = sqrt(x->fragmentSize);
+/* Same as modalKernel(), for a fixed number of modes. With a constant mode
+   count, the compiler unrolls all loops over modes and keeps coefficients and
+   state in registers for the whole block. */
+#define _SDT_MODAL_KERNEL(N)                                                   \
+  static void modalKernel##N(SDTModalReal **arrays, const SDTModalReal *fw,    \
+                             const double *in, const double *projection,       \
+                             double **outs, int nModes, int nPickups,          \
+                             unsigned int n) {                                 \
+    SDTModalReal c[N_PACKED][N], w[N];                                         \
+    double fin;                                                                \
+    int j, k, mode;                                                            \
+    unsigned int i;                                                            \
+                                                                               \
+    for (j = 0; j < N_PACKED; j++) {                                           \
+      for (mode = 0; mode < N; mode++) {                                       \
+        c[j][mode] = arrays[j][mode];                                          \
+      }                                                                        \
+    }                                                                          \
+    for (mode = 0; mode < N; mode++) {                                         \
+      w[mode] = fw[mode];                                                      \
+    }                                                                          \
+    for (i = 0; i < n; i++) {                                                  \
+      fin = in ? in[i] : 0.0;                                                  \
+      if (!isnormal(fin)) fin = 0.0;                                           \
+      for (mode = 0; mode < N; mode++) {                                       \
+        _SDT_MODAL_STEP(c[PACK_B1], c[PACK_D1], c[PACK_D2], c[PACK_B0V],       \
+                        c[PACK_B1V], w, fin, c[PACK_P0], c[PACK_P1],           \
+                        c[PACK_V], c[PACK_F], mode)                            \
+      }                                                                        \
+      if (!outs) continue;                                                     \
+      for (k = 0; k < nPickups; k++) {                                         \
+        if (!outs[k]) continue;                                                \
+        _SDT_MODAL_PROJECT(N, c[PACK_P0], (projection + k * N), outs[k][i])    \
+      }                                                                        \
+    }                                                                          \
+    for (j = PACK_P0; j <= PACK_F; j++) {                                      \
+      for (mode = 0; mode < N; mode++) {                                       \
+        arrays[j][mode] = c[j][mode];                                          \
+      }                                                                        \
+    }                                                                          \
+  }
+
+_SDT_MODAL_KERNEL(1)
+_SDT_MODAL_KERNEL(2)
+_SDT_MODAL_KERNEL(4)
+_SDT_MODAL_KERNEL(8)
+_SDT_MODAL_KERNEL(16)
+
+/* Rebuilds the index of live modes. Modes which can't be simulated or have
+   no gain on any pickup never reach an output: they are reset and kept
+   asleep, so that they are skipped by all loops. */
+static void updateLiveModes(SDTResonator *x) {
+  int i, mode, pickup, audible;
+
+  x->revision++;
+  x->liveModes = 0;
+  for (mode = 0; mode < x->activeModes; mode++) {
+    audible = 0;
+    for (pickup = 0; pickup < x->nPickups && !audible; pickup++) {
+      audible = x->gains[pickup][mode] > 0.0;
+    }
+    if (audible && x->m[mode] > 0.0) {
+      x->live[x->liveModes++] = mode;
+      continue;
+    }
+    x->p0[mode] = 0.0;
+    x->p1[mode] = 0.0;
+    x->v[mode] = 0.0;
+    x->f[mode] = 0.0;
+    if (!x->asleep[mode]) {
+      x->asleep[mode] = 1;
+      x->awakeModes--;
+    }
+  }
+  for (pickup = 0; pickup < x->nPickups; pickup++) {
+    for (i = 0; i < x->liveModes; i++) {
+      x->projection[pickup * x->liveModes + i] = x->gains[pickup][x->live[i]];
+    }
+  }
+  switch (x->liveModes) {
+    case 1:
+      x->kernel = modalKernel1;
+      break;
+    case 2:
+      x->kernel = modalKernel2;
+      break;
+    case 4:
+      x->kernel = modalKernel4;
+      break;
+    case 8:
+      x->kernel = modalKernel8;
+      break;
+    case 16:
+      x->kernel = modalKernel16;
+      break;
+    default:
+      x->kernel = modalKernel;
+      break;
+  }
+}
+
+static int isFading(const SDTResonator *x, unsigned int mode) {
+  return x->fadeSamples > 0 && mode >= x->fadeFrom;
+}
+
+/* Computes the coefficients of a mode for the given fragment size.
+   Returns zero if the mode can't be simulated, which makes it silent. */
+static int modeCoefficients(const SDTResonator *x, unsigned int mode,
+                            double s, double *c) {
+  double u, w, wt, d, g, r, coswt, sincwt, tsincwt;
+
+  u = sqrt(s);
   w = SDT_TWOPI * x->freqs[mode];
   wt = w * SDT_timeStep / u;
-  m = x->weights[mode] * x->fragmentSize;
-  k = w * w * x->weights[mode];
-  if (wt < acos(-0.9995) && m > SDT_MICRO) {
+  c[COEF_M] = x->weights[mode] * s;
+  c[COEF_K] = w * w * x->weights[mode];
+  if (wt < acos(-0.9995) && c[COEF_M] > SDT_MICRO) {
     d = x->decays[mode] * u;
+    if (isFading(x, mode) && (d <= 0.0 || d > FADE_DECAY)) d = FADE_DECAY;
     g = d > 0.0 ? 2.0 / d : 0.0;
     r = exp(-g * SDT_timeStep);
     coswt = cos(wt);
     sincwt = wt > 0.0 ? sin(wt) / wt : 1.0;
     tsincwt = sincwt * SDT_timeStep;
-    x->b1[mode] = r * sincwt * SDT_timeStep * SDT_timeStep / m;
-    x->a1[mode] = -2.0 * r * coswt;
-    x->a2[mode] = r * r;
-    x->b0v[mode] = coswt / tsincwt - g;
-    x->b1v[mode] = -r / tsincwt;
-    x->v[mode] *= sqrt(x->m[mode] / m);
-    x->p0[mode] *= k > 0.0 ? sqrt(x->k[mode] / k) : 1.0;
-    updateState(x, mode);
-    x->m[mode] = m;
-    x->k[mode] = k;
-  } else {
-    x->m[mode] = 0.0;
-    x->k[mode] = 0.0;
-    x->b1[mode] = 0.0;
-    x->a1[mode] = 0.0;
-    x->a2[mode] = 0.0;
-    x->b0v[mode] = 0.0;
-    x->b1v[mode] = 0.0;
+    c[COEF_B1] = r * sincwt * SDT_timeStep * SDT_timeStep / c[COEF_M];
+    // d1 = 2 - 2r cos(wt) and d2 = 1 - r^2, without cancellation
+    c[COEF_D1] = -2.0 * expm1(-g * SDT_timeStep) +
+                 4.0 * r * sin(0.5 * wt) * sin(0.5 * wt);
+    c[COEF_D2] = -expm1(-2.0 * g * SDT_timeStep);
+    c[COEF_B0V] = coswt / tsincwt - g;
+    c[COEF_B1V] = -r / tsincwt;
+    return 1;
+  }
+  c[COEF_M] = 0.0;
+  c[COEF_K] = 0.0;
+  c[COEF_B1] = 0.0;
+  c[COEF_D1] = 2.0;
+  c[COEF_D2] = 1.0;
+  c[COEF_B0V] = 0.0;
+  c[COEF_B1V] = 0.0;
+  return 0;
+}
+
+/* Sets the coefficients of a mode. The state of a mode which keeps being
+   simulated is rescaled to preserve its energy. */
+static void setCoefficients(SDTResonator *x, unsigned int mode,
+                            const double *c) {
+  if (c[COEF_M] > 0.0) {
+    x->v[mode] *= sqrt(x->m[mode] / c[COEF_M]);
+    x->p0[mode] *= c[COEF_K] > 0.0 ? sqrt(x->k[mode] / c[COEF_K]) : 1.0;
   }
+  x->m[mode] = c[COEF_M];
+  x->k[mode] = c[COEF_K];
+  x->b1[mode] = c[COEF_B1];
+  x->d1[mode] = c[COEF_D1];
+  x->d2[mode] = c[COEF_D2];
+  x->b0v[mode] = c[COEF_B0V];
+  x->b1v[mode] = c[COEF_B1V];
+  if (c[COEF_M] > 0.0) updateState(x, mode);
+}
+
+static void updateMode(SDTResonator *x, unsigned int mode) {
+  double c[N_COEFS];
+
+  modeCoefficients(x, mode, x->fragmentSize, c);
+  setCoefficients(x, mode, c);
 }
 
 static void updatePickup(SDTResonator *x, unsigned int pickup) {
+  double *g, *shares;
   int mode;
 
-  x->gains[pickup][x->nModes] = 0.0;
+  g = x->gains[pickup];
+  shares = forceShares(x, pickup);
+  g[x->nModes] = 0.0;
+  for (mode = 0; mode < x->activeModes; mode++) {
+    g[x->nModes] += g[mode];
+  }
   for (mode = 0; mode < x->activeModes; mode++) {
-    x->gains[pickup][x->nModes] += x->gains[pickup][mode];
+    shares[mode] = g[x->nModes] > 0.0 ? g[mode] / g[x->nModes]
+                                      : 1.0 / x->activeModes;
   }
 }
 
-static void updateModes(SDTResonator *x) {
+static void markMode(SDTResonator *x, unsigned int mode) {
+  x->dirty[mode] = 1;
+  x->dirtyModes = 1;
+  x->uA = -1.0;
+  x->uB = -1.0;
+}
+
+static void markModes(SDTResonator *x) {
   int mode;
 
   for (mode = 0; mode < x->activeModes; mode++) {
-    updateMode(x, mode);
+    markMode(x, mode);
   }
 }
 
@@ -113,159 +467,305 @@ static void updatePickups(SDTResonator *x) {
   }
 }
 
+/* Recomputes the coefficients of modified modes and pickups only, so that
+   several parameter changes cost a single pass */
+// Locates the parameter and state arrays in a storage block
+static void mapStorage(const SDTModalStorage *s, double **params,
+                       double **shares, double **projection,
+                       SDTModalReal **arrays, int **live,
+                       unsigned char **asleep, unsigned char **dirty) {
+  SDTModalReal *state;
+  int i, nModes, nPickups;
+
+  nModes = s->modeCapacity;
+  nPickups = s->pickupCapacity;
+  for (i = 0; i < 3; i++) {
+    params[i] = s->block + i * nModes;
+  }
+  *shares = s->block + 3 * nModes + nPickups * (nModes + 1);
+  *projection = *shares + nPickups * nModes;
+  state = (SDTModalReal *)(*projection + nPickups * nModes);
+  for (i = 0; i < N_ARRAYS; i++) {
+    arrays[i] = state + i * nModes;
+  }
+  *live = (int *)(state + N_ARRAYS * nModes);
+  *asleep = (unsigned char *)(*live + nModes);
+  *dirty = *asleep + nModes;
+}
+
+static SDTModalStorage *newStorage(int modeCapacity, int pickupCapacity) {
+  SDTModalStorage *s;
+  double *params[3], *shares, *projection;
+  SDTModalReal *arrays[N_ARRAYS];
+  unsigned char *asleep, *dirty;
+  size_t nParams;
+  int *live, pickup, mode;
+
+  s = (SDTModalStorage *)malloc(sizeof(SDTModalStorage));
+  s->modeCapacity = modeCapacity;
+  s->pickupCapacity = pickupCapacity;
+  nParams = 3 * modeCapacity + pickupCapacity * (3 * modeCapacity + 1);
+  s->block = (double *)calloc(
+      1, nParams * sizeof(double) +
+             N_ARRAYS * modeCapacity * sizeof(SDTModalReal) +
+             modeCapacity * sizeof(int) + 2 * modeCapacity);
+  s->gains = (double **)malloc(pickupCapacity * sizeof(double *));
+  for (pickup = 0; pickup < pickupCapacity; pickup++) {
+    s->gains[pickup] =
+        s->block + 3 * modeCapacity + pickup * (modeCapacity + 1);
+  }
+  mapStorage(s, params, &shares, &projection, arrays, &live, &asleep, &dirty);
+  for (mode = 0; mode < modeCapacity; mode++) {
+    asleep[mode] = 1;
+  }
+  return s;
+}
+
+static void freeStorage(SDTModalStorage *s) {
+  if (!s) return;
+  free(s->gains);
+  free(s->block);
+  free(s);
+}
+
+/* Moves the state to new storage, which must hold at least the current modes
+   and pickups. Returns the storage which was replaced. */
+static SDTModalStorage *swapStorage(SDTResonator *x, SDTModalStorage *s) {
+  SDTModalStorage *old;
+  double *params[3], *shares, *projection;
+  SDTModalReal *arrays[N_ARRAYS];
+  unsigned char *asleep, *dirty;
+  int *live, i, pickup;
+
+  mapStorage(s, params, &shares, &projection, arrays, &live, &asleep, &dirty);
+  old = x->storage;
+  if (old) {
+    memcpy(params[0], x->freqs, x->nModes * sizeof(double));
+    memcpy(params[1], x->decays, x->nModes * sizeof(double));
+    memcpy(params[2], x->weights, x->nModes * sizeof(double));
+    memcpy(arrays[0], x->m, x->nModes * sizeof(SDTModalReal));
+    memcpy(arrays[1], x->k, x->nModes * sizeof(SDTModalReal));
+    memcpy(arrays[2], x->b1, x->nModes * sizeof(SDTModalReal));
+    memcpy(arrays[3], x->d1, x->nModes * sizeof(SDTModalReal));
+    memcpy(arrays[4], x->d2, x->nModes * sizeof(SDTModalReal));
+    memcpy(arrays[5], x->b0v, x->nModes * sizeof(SDTModalReal));
+    memcpy(arrays[6], x->b1v, x->nModes * sizeof(SDTModalReal));
+    memcpy(arrays[7], x->p0, x->nModes * sizeof(SDTModalReal));
+    memcpy(arrays[8], x->p1, x->nModes * sizeof(SDTModalReal));
+    memcpy(arrays[9], x->v, x->nModes * sizeof(SDTModalReal));
+    memcpy(arrays[10], x->f, x->nModes * sizeof(SDTModalReal));
+    for (pickup = 0; pickup < x->nPickups; pickup++) {
+      memcpy(s->gains[pickup], x->gains[pickup],
+             (x->nModes + 1) * sizeof(double));
+    }
+    memcpy(live, x->live, x->liveModes * sizeof(int));
+    memcpy(projection, x->projection,
+           x->liveModes * x->nPickups * sizeof(double));
+    memcpy(asleep, x->asleep, x->nModes);
+    memcpy(dirty, x->dirty, x->nModes);
+  }
+  x->storage = s;
+  x->freqs = params[0];
+  x->decays = params[1];
+  x->weights = params[2];
+  x->m = arrays[0];
+  x->k = arrays[1];
+  x->b1 = arrays[2];
+  x->d1 = arrays[3];
+  x->d2 = arrays[4];
+  x->b0v = arrays[5];
+  x->b1v = arrays[6];
+  x->p0 = arrays[7];
+  x->p1 = arrays[8];
+  x->v = arrays[9];
+  x->f = arrays[10];
+  for (i = 0; i < N_COEFS; i++) {
+    x->cellA[i] = arrays[11 + i];
+    x->cellB[i] = arrays[11 + N_COEFS + i];
+  }
+  x->packed = arrays[11 + 2 * N_COEFS];
+  x->shares = shares;
+  x->projection = projection;
+  x->uA = -1.0;
+  x->uB = -1.0;
+  x->gains = s->gains;
+  x->live = live;
+  // Force shares are not copied, they are recomputed from the gains
+  x->dirtyPickups = 1;
+  x->asleep = asleep;
+  x->dirty = dirty;
+  x->modeCapacity = s->modeCapacity;
+  x->pickupCapacity = s->pickupCapacity;
+  return old;
+}
+
+/* Swaps in the storage built by SDTResonator_reserve(), if any. This neither
+   allocates nor frees memory: the replaced storage is handed back to be freed
+   outside DSP, and the swap waits until the previous one has been. */
+static void adoptStorage(SDTResonator *x) {
+  SDTModalStorage *s;
+
+  if (atomic_load(&x->retired)) return;
+  s = atomic_exchange(&x->staged, NULL);
+  if (!s) return;
+  // Storage grown synchronously in the meantime is kept
+  if (s->modeCapacity < x->modeCapacity ||
+      s->pickupCapacity < x->pickupCapacity) {
+    atomic_store(&x->retired, s);
+    return;
+  }
+  atomic_store(&x->retired, swapStorage(x, s));
+}
+
+// Grows the storage on the calling thread
+static void allocateStorage(SDTResonator *x, int modeCapacity,
+                            int pickupCapacity) {
+  freeStorage(atomic_exchange(&x->retired, NULL));
+  freeStorage(swapStorage(x, newStorage(modeCapacity, pickupCapacity)));
+  if (modeCapacity > x->reservedModes) x->reservedModes = modeCapacity;
+  if (pickupCapacity > x->reservedPickups) x->reservedPickups = pickupCapacity;
+}
+
+void SDTResonator_commit(SDTResonator *x) {
+  int mode, dirty;
+
+  if (atomic_load_explicit(&x->staged, memory_order_relaxed)) adoptStorage(x);
+  dirty = x->dirtyModes || x->dirtyPickups;
+  if (x->dirtyModes) {
+    for (mode = 0; mode < x->nModes; mode++) {
+      if (x->dirty[mode]) {
+        updateMode(x, mode);
+        x->dirty[mode] = 0;
+      }
+    }
+    x->dirtyModes = 0;
+  }
+  if (x->dirtyPickups) {
+    updatePickups(x);
+    x->dirtyPickups = 0;
+  }
+  if (dirty) updateLiveModes(x);
+}
+
 void SDTResonator_update(SDTResonator *x) {
-  updateModes(x);
-  updatePickups(x);
+  markModes(x);
+  x->dirtyPickups = 1;
+  SDTResonator_commit(x);
 }
 
 SDTResonator *SDTResonator_new(unsigned int nModes, unsigned int nPickups) {
   SDTResonator *x;
-  int pickup, mode;
 
   x = (SDTResonator *)malloc(sizeof(SDTResonator));
-  x->freqs = (double *)malloc(nModes * sizeof(double));
-  x->decays = (double *)malloc(nModes * sizeof(double));
-  x->weights = (double *)malloc(nModes * sizeof(double));
-  x->gains = (double **)malloc(nPickups * sizeof(double *));
-  for (pickup = 0; pickup < nPickups; pickup++) {
-    x->gains[pickup] = (double *)malloc((nModes + 1) * sizeof(double));
-  }
-  x->m = (double *)malloc(nModes * sizeof(double));
-  x->k = (double *)malloc(nModes * sizeof(double));
-  x->b1 = (double *)malloc(nModes * sizeof(double));
-  x->a1 = (double *)malloc(nModes * sizeof(double));
-  x->a2 = (double *)malloc(nModes * sizeof(double));
-  x->b0v = (double *)malloc(nModes * sizeof(double));
-  x->b1v = (double *)malloc(nModes * sizeof(double));
-  x->p0 = (double *)malloc(nModes * sizeof(double));
-  x->p1 = (double *)malloc(nModes * sizeof(double));
-  x->v = (double *)malloc(nModes * sizeof(double));
-  x->f = (double *)malloc(nModes * sizeof(double));
+  x->storage = NULL;
+  atomic_init(&x->staged, NULL);
+  atomic_init(&x->retired, NULL);
+  x->reservedModes = 0;
+  x->reservedPickups = 0;
   x->fragmentSize = 0.0;
-  for (mode = 0; mode < nModes; mode++) {
-    x->freqs[mode] = 0.0;
-    x->decays[mode] = 0.0;
-    x->weights[mode] = 0.0;
-    x->m[mode] = 0.0;
-    x->k[mode] = 0.0;
-    x->b1[mode] = 0.0;
-    x->a1[mode] = 0.0;
-    x->a2[mode] = 0.0;
-    x->b0v[mode] = 0.0;
-    x->b1v[mode] = 0.0;
-    x->p0[mode] = 0.0;
-    x->p1[mode] = 0.0;
-    x->v[mode] = 0.0;
-    x->f[mode] = 0.0;
-  }
-  for (pickup = 0; pickup < nPickups; pickup++) {
-    for (mode = 0; mode <= nModes; mode++) {
-      x->gains[pickup][mode] = 0.0;
-    }
-  }
+  x->sleepThreshold = 0.0;
+  x->priority = 1.0;
+  x->requestedModes = 0;
+  x->modeLimit = INT_MAX;
+  x->fadeFrom = 0;
+  x->fadeSamples = 0;
+  x->sleepClock = 0;
+  x->nModes = 0;
+  x->nPickups = 0;
+  x->dirtyModes = 0;
+  x->dirtyPickups = 0;
+  allocateStorage(x, nModes, nPickups);
   x->nModes = nModes;
   x->nPickups = nPickups;
   x->activeModes = 0;
+  x->awakeModes = 0;
+  x->liveModes = 0;
+  x->kernel = modalKernel;
+  x->revision = 0;
+  x->paramRevision = 0;
   return x;
 }
 
 void SDTResonator_free(SDTResonator *x) {
-  int pickup;
-
-  free(x->freqs);
-  free(x->decays);
-  free(x->weights);
-  for (pickup = 0; pickup < x->nPickups; pickup++) {
-    free(x->gains[pickup]);
-  }
-  free(x->gains);
-  free(x->m);
-  free(x->k);
-  free(x->b1);
-  free(x->a1);
-  free(x->a2);
-  free(x->b0v);
-  free(x->b1v);
-  free(x->p0);
-  free(x->p1);
-  free(x->v);
-  free(x->f);
+  freeStorage(x->storage);
+  freeStorage(atomic_load(&x->staged));
+  freeStorage(atomic_load(&x->retired));
   free(x);
 }
 
+void SDTResonator_reserve(SDTResonator *x, int nModes, int nPickups) {
+  if (nModes <= x->reservedModes && nPickups <= x->reservedPickups) return;
+  if (nModes > x->reservedModes) x->reservedModes = nModes;
+  if (nPickups > x->reservedPickups) x->reservedPickups = nPickups;
+  /* Storage is built here, and swapped in by the next commit. Storage staged
+     earlier and not swapped in yet is replaced. */
+  freeStorage(atomic_exchange(&x->retired, NULL));
+  freeStorage(atomic_exchange(
+      &x->staged, newStorage(x->reservedModes, x->reservedPickups)));
+  freeStorage(atomic_exchange(&x->retired, NULL));
+}
+
 void SDTResonator_setNPickups(SDTResonator *x, int f) {
-  if (f == x->nPickups) return;
+  int pickup;
 
-  if (f > x->nPickups) {
-    double **new_gains = (double **)malloc(f * sizeof(double *));
-    int pickup = 0;
-    // Copy over first old arrays
-    for (; pickup < x->nPickups; pickup++) {
-      new_gains[pickup] = x->gains[pickup];
-    }
-    free(x->gains);
-    x->gains = new_gains;
-    // Allocate and clear new arrays
-    for (; pickup < f; pickup++) {
-      new_gains[pickup] = (double *)malloc((x->nModes + 1) * sizeof(double));
-      for (int mode = 0; mode <= x->nModes; mode++) {
-        new_gains[pickup][mode] = 0.0;
-      }
-    }
-  } else {
-    // Deallocate last old arrays
-    for (int pickup = f; pickup < x->nPickups; pickup++) {
-      free(x->gains[pickup]);
-    }
+  if (f < 0) f = 0;
+  if (f == x->nPickups) return;
+  if (f > x->pickupCapacity) adoptStorage(x);
+  if (f > x->pickupCapacity) allocateStorage(x, x->modeCapacity, f);
+  // Clear pickups coming back into use
+  for (pickup = x->nPickups; pickup < f; pickup++) {
+    SDT_zeros(x->gains[pickup], x->nModes + 1);
   }
-
   x->nPickups = f;
+  x->paramRevision++;
   SDTResonator_update(x);
 }
 
-#define _SDTResonator_setNModes_loopHelp(X)         \
-  __new_mem = (double *)malloc(f * sizeof(double)); \
-  for (mode = 0; mode < x->nModes; mode++) {        \
-    __new_mem[mode] = x->X[mode];                   \
-  }                                                 \
-  for (; mode < f; mode++) {                        \
-    __new_mem[mode] = 0.0;                          \
-  }                                                 \
-  free(x->X);                                       \
-  x->X = __new_mem;
-
 void SDTResonator_setNModes(SDTResonator *x, int f) {
-  if (f == x->nModes) return;
-
-  if (f > x->nModes) {
-    double *__new_mem;
-    int mode;
-    _SDTResonator_setNModes_loopHelp(freqs);
-    _SDTResonator_setNModes_loopHelp(decays);
-    _SDTResonator_setNModes_loopHelp(weights);
-    _SDTResonator_setNModes_loopHelp(m);
-    _SDTResonator_setNModes_loopHelp(k);
-    _SDTResonator_setNModes_loopHelp(b1);
-    _SDTResonator_setNModes_loopHelp(a1);
-    _SDTResonator_setNModes_loopHelp(a2);
-    _SDTResonator_setNModes_loopHelp(b0v);
-    _SDTResonator_setNModes_loopHelp(b1v);
-    _SDTResonator_setNModes_loopHelp(p0);
-    _SDTResonator_setNModes_loopHelp(p1);
-    _SDTResonator_setNModes_loopHelp(v);
-    _SDTResonator_setNModes_loopHelp(f);
-    for (int pickup = 0; pickup < x->nPickups; pickup++) {
-      _SDTResonator_setNModes_loopHelp(gains[pickup]);
-    }
-  }  // Else, just update nModes, no deallocation needed
+  int pickup, mode;
 
+  if (f < 0) f = 0;
+  if (f == x->nModes) return;
+  if (f > x->modeCapacity) adoptStorage(x);
+  if (f > x->modeCapacity) allocateStorage(x, f, x->pickupCapacity);
+  // Clear modes coming back into use, including the old gain sums
+  for (mode = x->nModes; mode < f; mode++) {
+    x->freqs[mode] = 0.0;
+    x->decays[mode] = 0.0;
+    x->weights[mode] = 0.0;
+    x->m[mode] = 0.0;
+    x->k[mode] = 0.0;
+    x->b1[mode] = 0.0;
+    x->d1[mode] = 0.0;
+    x->d2[mode] = 0.0;
+    x->b0v[mode] = 0.0;
+    x->b1v[mode] = 0.0;
+    x->p0[mode] = 0.0;
+    x->p1[mode] = 0.0;
+    x->v[mode] = 0.0;
+    x->f[mode] = 0.0;
+    x->asleep[mode] = 1;
+    x->dirty[mode] = 0;
+    for (pickup = 0; pickup < x->nPickups; pickup++) {
+      x->gains[pickup][mode] = 0.0;
+    }
+  }
   x->nModes = f;
+  if (x->activeModes > f) {
+    x->activeModes = f;
+    countAwakeModes(x);
+  }
+  if (x->fadeFrom > f) x->fadeFrom = f;
+  x->paramRevision++;
   SDTResonator_update(x);
 }
 
 _SDT_COPY_FUNCTION(Resonator)
 
 static SDTHashmap *hashmap_Resonator = NULL;
+static int nResonators = 0;
+
+static void reserveBudgetItems(int n);
 
 int SDT_registerResonator(SDTResonator *x, const char *key) {
   if (!hashmap_Resonator) hashmap_Resonator = SDTHashmap_new(59);
@@ -273,6 +773,8 @@ int SDT_registerResonator(SDTResonator *x, const char *key) {
     SDT_LOGA(WARN, "Not registering. Key already present: %s\n", key);
     return 1;
   }
+  nResonators++;
+  reserveBudgetItems(nResonators);
   SDT_updateInteractors(key);
   return 0;
 }
@@ -284,6 +786,7 @@ SDTResonator *SDT_getResonator(const char *key) {
 int SDT_unregisterResonator(const char *key) {
   if (!hashmap_Resonator) return 1;
   if (SDTHashmap_del(hashmap_Resonator, key)) return 1;
+  nResonators--;
   if (SDTHashmap_empty(hashmap_Resonator)) {
     SDT_LOGA(DEBUG, "Deleting hashmap (was emptied): %p\n", hashmap_Resonator);
     SDTHashmap_free(hashmap_Resonator);
@@ -295,30 +798,81 @@ int SDT_unregisterResonator(const char *key) {
 
 double SDTResonator_getPosition(const SDTResonator *x, unsigned int pickup) {
   double out;
-  int mode;
+  int i, mode;
 
   out = 0.0;
   if (pickup < x->nPickups) {
-    for (mode = 0; mode < x->activeModes; mode++) {
+    for (i = 0; i < x->liveModes; i++) {
+      mode = x->live[i];
       out += x->p0[mode] * x->gains[pickup][mode];
     }
   }
   return out;
 }
 
+void SDTResonator_getPositions(const SDTResonator *x, double *outs) {
+#ifdef _WIN32
+  SDTModalReal *packed = _malloca(x->liveModes * sizeof(SDTModalReal));
+#else
+  SDTModalReal packed[x->liveModes];
+#endif
+  const SDTModalReal *p0;
+  int i, k;
+
+  // Sleeping object: all modes are at rest
+  if (!x->awakeModes) {
+    for (k = 0; k < x->nPickups; k++) {
+      outs[k] = 0.0;
+    }
+    return;
+  }
+  // Live positions are gathered once, and projected to all pickups
+  p0 = x->p0;
+  if (x->liveModes < x->activeModes) {
+    for (i = 0; i < x->liveModes; i++) {
+      packed[i] = x->p0[x->live[i]];
+    }
+    p0 = packed;
+  }
+  for (k = 0; k < x->nPickups; k++) {
+    _SDT_MODAL_PROJECT(x->liveModes, p0, (x->projection + k * x->liveModes),
+                       outs[k])
+  }
+}
+
 double SDTResonator_getVelocity(const SDTResonator *x, unsigned int pickup) {
   double out;
-  int mode;
+  int i, mode;
 
   out = 0.0;
   if (pickup < x->nPickups) {
-    for (mode = 0; mode < x->activeModes; mode++) {
+    for (i = 0; i < x->liveModes; i++) {
+      mode = x->live[i];
       out += x->v[mode] * x->gains[pickup][mode];
     }
   }
   return out;
 }
 
+void SDTResonator_getPositionBounds(const SDTResonator *x,
+                                   unsigned int pickup, double *lo,
+                                   double *hi) {
+  double g, a, b;
+  int i, mode;
+
+  *lo = 0.0;
+  *hi = 0.0;
+  if (pickup >= x->nPickups) return;
+  for (i = 0; i < x->liveModes; i++) {
+    mode = x->live[i];
+    if (x->asleep[mode]) continue;
+    g = x->gains[pickup][mode];
+    modalBounds(x, mode, &a, &b);
+    *lo += fmin(g * a, g * b);
+    *hi += fmax(g * a, g * b);
+  }
+}
+
 double SDTResonator_getFrequency(const SDTResonator *x, unsigned int mode) {
   return (mode < x->nModes) ? x->freqs[mode] : 0.0;
 }
@@ -341,54 +895,95 @@ int SDTResonator_getNPickups(const SDTResonator *x) { return x->nPickups; }
 
 int SDTResonator_getNModes(const SDTResonator *x) { return x->nModes; }
 
+int SDTResonator_getModeCapacity(const SDTResonator *x) {
+  return x->reservedModes;
+}
+
+int SDTResonator_getPickupCapacity(const SDTResonator *x) {
+  return x->reservedPickups;
+}
+
 int SDTResonator_getActiveModes(const SDTResonator *x) {
   return x->activeModes;
 }
 
+int SDTResonator_getAwakeModes(const SDTResonator *x) {
+  return x->awakeModes;
+}
+
+int SDTResonator_getLiveModes(const SDTResonator *x) { return x->liveModes; }
+
+unsigned long SDTResonator_getRevision(const SDTResonator *x) {
+  return x->revision;
+}
+
+unsigned long SDTResonator_getParamRevision(const SDTResonator *x) {
+  return x->paramRevision;
+}
+
+double SDTResonator_getSleepThreshold(const SDTResonator *x) {
+  return x->sleepThreshold;
+}
+
+int SDTResonator_getModeLimit(const SDTResonator *x) { return x->modeLimit; }
+
+double SDTResonator_getPriority(const SDTResonator *x) { return x->priority; }
+
 double SDTResonator_getFragmentSize(const SDTResonator *x) {
   return x->fragmentSize;
 }
 
 void SDTResonator_setPosition(SDTResonator *x, unsigned int pickup, double f) {
-  int mode;
+  int i, mode;
 
+  SDTResonator_commit(x);
   if (pickup < x->nPickups && x->gains[pickup][x->nModes] > 0.0) {
-    for (mode = 0; mode < x->activeModes; mode++) {
+    for (i = 0; i < x->liveModes; i++) {
+      mode = x->live[i];
       x->p0[mode] = f / x->gains[pickup][x->nModes];
       updateState(x, mode);
+      wakeMode(x, mode);
     }
+    x->revision++;
   }
 }
 
 void SDTResonator_setVelocity(SDTResonator *x, unsigned int pickup, double f) {
-  int mode;
+  int i, mode;
 
+  SDTResonator_commit(x);
   if (pickup < x->nPickups && x->gains[pickup][x->nModes] > 0.0) {
-    for (mode = 0; mode < x->activeModes; mode++) {
+    for (i = 0; i < x->liveModes; i++) {
+      mode = x->live[i];
       x->v[mode] = f / x->gains[pickup][x->nModes];
       updateState(x, mode);
+      wakeMode(x, mode);
     }
+    x->revision++;
   }
 }
 
 void SDTResonator_setFrequency(SDTResonator *x, unsigned int mode, double f) {
   if (mode < x->nModes) {
     x->freqs[mode] = f;
-    updateMode(x, mode);
+    markMode(x, mode);
+    x->paramRevision++;
   }
 }
 
 void SDTResonator_setDecay(SDTResonator *x, unsigned int mode, double f) {
   if (mode < x->nModes) {
     x->decays[mode] = fmax(0.0, f);
-    updateMode(x, mode);
+    markMode(x, mode);
+    x->paramRevision++;
   }
 }
 
 void SDTResonator_setWeight(SDTResonator *x, unsigned int mode, double f) {
   if (mode < x->nModes) {
     x->weights[mode] = fmax(0.0, f);
-    updateMode(x, mode);
+    markMode(x, mode);
+    x->paramRevision++;
   }
 }
 
@@ -396,74 +991,1062 @@ void SDTResonator_setGain(SDTResonator *x, unsigned int pickup,
                           unsigned int mode, double f) {
   if (mode < x->nModes && pickup < x->nPickups) {
     x->gains[pickup][mode] = fmax(f, 0.0);
-    updatePickup(x, pickup);
+    x->dirtyPickups = 1;
+    x->paramRevision++;
   }
 }
 
 void SDTResonator_setFragmentSize(SDTResonator *x, double f) {
-  x->fragmentSize = SDT_fclip(f, 0.0, 1.0);
-  updateModes(x);
+  f = SDT_fclip(f, 0.0, 1.0);
+  if (f == x->fragmentSize) return;
+  x->fragmentSize = f;
+  markModes(x);
+}
+
+static void computeCell(SDTResonator *x, double u, SDTModalReal **cell) {
+  double c[N_COEFS];
+  int mode, i;
+
+  for (mode = 0; mode < x->activeModes; mode++) {
+    modeCoefficients(x, mode, u * u, c);
+    for (i = 0; i < N_COEFS; i++) {
+      cell[i][mode] = c[i];
+    }
+  }
+}
+
+void SDTResonator_modulateFragmentSize(SDTResonator *x, double f) {
+  double c[N_COEFS], u, t;
+  int mode, i, live, changed;
+
+  f = SDT_fclip(f, 0.0, 1.0);
+  if (f == x->fragmentSize) return;
+  SDTResonator_commit(x);
+  x->revision++;
+  u = sqrt(f);
+  // A small step after a jump opens a cell in the direction of motion
+  if (x->uA > 0.0 && x->uB < 0.0 && fabs(u - x->uA) <= FRAGMENT_CELL) {
+    x->uB = u > x->uA ? fmin(x->uA + FRAGMENT_CELL, 1.0)
+                      : fmax(x->uA - FRAGMENT_CELL, 0.0);
+    if (x->uB > 0.0) computeCell(x, x->uB, x->cellB);
+  }
+  if (x->uA > 0.0 && x->uB > 0.0 && x->uB != x->uA &&
+      u >= fmin(x->uA, x->uB) && u <= fmax(x->uA, x->uB)) {
+    // Angular frequencies and damping are linear in the reciprocal
+    t = (1.0 / u - 1.0 / x->uA) / (1.0 / x->uB - 1.0 / x->uA);
+  } else {
+    // Jump: exact coefficients, anchoring a new cell
+    x->uA = u;
+    x->uB = -1.0;
+    computeCell(x, u, x->cellA);
+    t = 0.0;
+  }
+  x->fragmentSize = f;
+  changed = 0;
+  for (mode = 0; mode < x->activeModes; mode++) {
+    if (!isFading(x, mode) && x->m[mode] > 0.0 &&
+        x->cellA[COEF_M][mode] > 0.0 &&
+        (t == 0.0 || x->cellB[COEF_M][mode] > 0.0)) {
+      for (i = 0; i < N_COEFS; i++) {
+        c[i] = x->cellA[i][mode];
+        if (t != 0.0) c[i] += t * (x->cellB[i][mode] - x->cellA[i][mode]);
+      }
+      c[COEF_M] = x->weights[mode] * f;
+      setCoefficients(x, mode, c);
+    } else {
+      // Modes starting or stopping being simulated are updated exactly
+      live = x->m[mode] > 0.0;
+      updateMode(x, mode);
+      changed |= live != (x->m[mode] > 0.0);
+    }
+  }
+  if (changed) updateLiveModes(x);
+}
+
+/* Applies the requested number of active modes, within the mode limit.
+   Modes beyond the limit are faded out before being dropped, all other
+   changes take effect immediately. */
+static void updateActiveModes(SDTResonator *x, int fade) {
+  int target, mode, active;
+
+  target = x->requestedModes < x->modeLimit ? x->requestedModes : x->modeLimit;
+  target = SDT_clip(target, 0, x->nModes);
+  if (fade && target < x->activeModes) {
+    // A fade already heading to the same target is not restarted
+    if (x->fadeSamples > 0 && x->fadeFrom == target) return;
+    mode = x->fadeSamples > 0 && x->fadeFrom < target ? x->fadeFrom : target;
+    x->fadeFrom = target;
+    x->fadeSamples = FADE_TIME * SDT_sampleRate;
+    for (; mode < x->activeModes; mode++) {
+      markMode(x, mode);
+    }
+    return;
+  }
+  if (x->fadeSamples <= 0 && target == x->activeModes) return;
+  // Modes which were fading out get their own decay back
+  x->fadeSamples = 0;
+  for (mode = x->fadeFrom; mode < x->activeModes; mode++) {
+    markMode(x, mode);
+  }
+  active = x->activeModes;
+  x->activeModes = target;
+  x->fadeFrom = target;
+  // Only the modes starting to be simulated need new coefficients
+  for (mode = active; mode < target; mode++) {
+    markMode(x, mode);
+  }
+  countAwakeModes(x);
+  updateLiveModes(x);
+  x->dirtyPickups = 1;
+  x->paramRevision++;
+}
+
+// Drops modes faded out by a mode limit, once they are silent
+static void advanceFade(SDTResonator *x, unsigned int n) {
+  int mode;
+
+  if (x->fadeSamples <= 0) return;
+  x->fadeSamples -= n;
+  if (x->fadeSamples > 0) return;
+  x->fadeSamples = 0;
+  for (mode = x->fadeFrom; mode < x->activeModes; mode++) {
+    x->p0[mode] = 0.0;
+    x->p1[mode] = 0.0;
+    x->v[mode] = 0.0;
+    x->f[mode] = 0.0;
+    x->asleep[mode] = 1;
+    markMode(x, mode);
+  }
+  x->activeModes = x->fadeFrom;
+  countAwakeModes(x);
+  updateLiveModes(x);
+  x->dirtyPickups = 1;
+  x->paramRevision++;
 }
 
 void SDTResonator_setActiveModes(SDTResonator *x, unsigned int i) {
-  x->activeModes = SDT_clip(i, 0, x->nModes);
-  SDTResonator_update(x);
+  x->requestedModes = i < INT_MAX ? i : INT_MAX;
+  updateActiveModes(x, 0);
+}
+
+void SDTResonator_setModeLimit(SDTResonator *x, int i) {
+  i = i > 0 ? i : 0;
+  if (i == x->modeLimit) return;
+  x->modeLimit = i;
+  updateActiveModes(x, 1);
+}
+
+void SDTResonator_setPriority(SDTResonator *x, double f) {
+  x->priority = fmax(0.0, f);
+}
+
+void SDTResonator_setSleepThreshold(SDTResonator *x, double f) {
+  x->sleepThreshold = fmax(0.0, f);
+  x->paramRevision++;
 }
 
 void SDTResonator_applyForce(SDTResonator *x, unsigned int pickup, double f) {
-#ifdef _WIN32
-  double *fs = _malloca(x->activeModes * sizeof(double));
-#else
-  double fs[x->activeModes];
-#endif
-  int mode;
+  double *shares, fm;
+  int i, mode;
 
+  SDTResonator_commit(x);
   if (pickup < x->nPickups) {
-    if (!isnormal(f)) f = 0.0;
-    distributeForce(x, pickup, fs, f);
-    for (mode = 0; mode < x->activeModes; mode++) {
-      x->f[mode] += fs[mode];
+    if (!isnormal(f)) return;
+    shares = forceShares(x, pickup);
+    for (i = 0; i < x->liveModes; i++) {
+      mode = x->live[i];
+      fm = f * shares[mode];
+      x->f[mode] += fm;
+      if (fm != 0.0) wakeMode(x, mode);
     }
+    x->revision++;
   }
 }
 
 double SDTResonator_computeEnergy(SDTResonator *x, unsigned int pickup,
                                   double f) {
-#ifdef _WIN32
-  double *fs = _malloca(x->activeModes * sizeof(double));
-#else
-  double fs[x->activeModes];
-#endif
-  double out, p, v;
-  int mode;
+  double *g, *shares, out, p, v;
+  int i, mode;
 
+  SDTResonator_commit(x);
   out = 0.0;
   if (pickup < x->nPickups) {
     if (!isnormal(f)) f = 0.0;
-    distributeForce(x, pickup, fs, f);
-    for (mode = 0; mode < x->activeModes; mode++) {
-      p = modalPosition(x, mode, x->f[mode] + fs[mode]);
+    g = x->gains[pickup];
+    shares = forceShares(x, pickup);
+    for (i = 0; i < x->liveModes; i++) {
+      mode = x->live[i];
+      p = modalPosition(x, mode, x->f[mode] + f * shares[mode]);
       v = modalVelocity(x, mode, p);
-      out += modalEnergy(x, mode, p, v) * x->gains[pickup][mode];
+      out += modalEnergy(x, mode, p, v) * g[mode];
     }
   }
   return out;
 }
 
+int SDTResonator_computeEnergyCoefficients(SDTResonator *x,
+                                           unsigned int pickup, double fMax,
+                                           double *c0, double *c1,
+                                           double *c2) {
+  double *g, *shares, w, pa, pb, va, vb, ga, gb;
+  int i, mode;
+
+  SDTResonator_commit(x);
+  *c0 = 0.0;
+  *c1 = 0.0;
+  *c2 = 0.0;
+  if (pickup >= x->nPickups) return 0;
+  g = x->gains[pickup];
+  shares = forceShares(x, pickup);
+  fMax = fabs(fMax);
+  for (i = 0; i < x->liveModes; i++) {
+    mode = x->live[i];
+    // Modal position and velocity are affine in the applied force
+    w = shares[mode];
+    pa = x->p0[mode] + (x->p0[mode] - x->p1[mode]) -
+         x->d1[mode] * x->p0[mode] + x->d2[mode] * x->p1[mode] +
+         x->b1[mode] * x->f[mode];
+    pb = x->b1[mode] * w;
+    if (fabs(pa) + fabs(pb) * fMax >= MAX_POS) return 1;
+    va = x->b0v[mode] * pa + x->b1v[mode] * x->p0[mode];
+    vb = x->b0v[mode] * pb;
+    ga = 0.5 * g[mode];
+    gb = g[mode];
+    *c0 += ga * (x->k[mode] * pa * pa + x->m[mode] * va * va);
+    *c1 += gb * (x->k[mode] * pa * pb + x->m[mode] * va * vb);
+    *c2 += ga * (x->k[mode] * pb * pb + x->m[mode] * vb * vb);
+  }
+  return !(isfinite(*c0) && isfinite(*c1) && isfinite(*c2));
+}
+
 void SDTResonator_dsp(SDTResonator *x) {
   double p;
-  int mode;
-
-  for (mode = 0; mode < x->activeModes; mode++) {
+  int i, mode, check;
+
+  advanceFade(x, 1);
+  SDTResonator_commit(x);
+  if (!x->awakeModes) return;
+  /* Modal energies are only checked every few samples, as once per block in
+     SDTResonator_dspBlock() */
+  check = ++x->sleepClock >= SLEEP_INTERVAL;
+  if (check) x->sleepClock = 0;
+  for (i = 0; i < x->liveModes; i++) {
+    mode = x->live[i];
+    if (x->asleep[mode]) continue;
     p = modalPosition(x, mode, x->f[mode]);
     x->v[mode] = modalVelocity(x, mode, p);
     x->p1[mode] = x->p0[mode];
     x->p0[mode] = p;
     x->f[mode] = 0.0;
+    if (check) trySleepMode(x, mode);
   }
 }
 
-//-------------------------------------------------------------------------------------//
+/* Gets contiguous arrays of coefficients and state of the live modes.
+   When some active modes are not live, these are packed in scratch memory. */
+static void packLiveModes(SDTResonator *x, SDTModalReal **arrays) {
+  SDTModalReal *src[N_PACKED] = {x->b1, x->d1, x->d2, x->b0v, x->b1v,
+                                 x->p0, x->p1, x->v,  x->f};
+  int i, j;
+
+  for (j = 0; j < N_PACKED; j++) {
+    if (x->liveModes == x->activeModes) {
+      arrays[j] = src[j];
+      continue;
+    }
+    arrays[j] = x->packed + j * x->modeCapacity;
+    for (i = 0; i < x->liveModes; i++) {
+      arrays[j][i] = src[j][x->live[i]];
+    }
+  }
+}
+
+// Stores back the state of packed live modes
+static void unpackLiveModes(SDTResonator *x, SDTModalReal **arrays) {
+  int i, mode;
+
+  if (x->liveModes == x->activeModes) return;
+  for (i = 0; i < x->liveModes; i++) {
+    mode = x->live[i];
+    x->p0[mode] = arrays[PACK_P0][i];
+    x->p1[mode] = arrays[PACK_P1][i];
+    x->v[mode] = arrays[PACK_V][i];
+    x->f[mode] = arrays[PACK_F][i];
+  }
+}
+
+void SDTResonator_dspBlock(SDTResonator *x, unsigned int pickup,
+                           const double *in, double **outs, unsigned int n) {
+#ifdef _WIN32
+  SDTModalReal *fw = _malloca(x->activeModes * sizeof(SDTModalReal));
+#else
+  SDTModalReal fw[x->activeModes];
+#endif
+  SDTModalReal *arrays[N_PACKED];
+  double *shares;
+  int mode, hasInput, j;
+  unsigned int i, k;
+
+  advanceFade(x, n);
+  SDTResonator_commit(x);
+  // Force distribution weights are constant across the block
+  hasInput = 0;
+  if (in && pickup < x->nPickups) {
+    for (i = 0; i < n && !hasInput; i++) {
+      hasInput = isnormal(in[i]);
+    }
+  }
+  if (hasInput) {
+    shares = forceShares(x, pickup);
+    for (j = 0; j < x->liveModes; j++) {
+      mode = x->live[j];
+      fw[j] = shares[mode];
+      if (fw[j] != 0.0) wakeMode(x, mode);
+    }
+    x->revision++;
+  } else {
+    for (j = 0; j < x->liveModes; j++) {
+      fw[j] = 0.0;
+    }
+  }
+
+  // Sleeping object: all modes are at rest and the output is zero
+  if (!x->awakeModes) {
+    if (outs) {
+      for (k = 0; k < x->nPickups; k++) {
+        if (!outs[k]) continue;
+        for (i = 0; i < n; i++) {
+          outs[k][i] = 0.0;
+        }
+      }
+    }
+    return;
+  }
+
+  /* Sleeping modes have zero state and input, they stay at rest and it is
+     cheaper to keep them in the vectorized loop than to branch on them */
+  packLiveModes(x, arrays);
+  x->kernel(arrays, fw, hasInput ? in : NULL, x->projection, outs,
+            x->liveModes, x->nPickups, n);
+  unpackLiveModes(x, arrays);
+  for (j = 0; j < x->liveModes; j++) {
+    mode = x->live[j];
+    if (!x->asleep[mode]) trySleepMode(x, mode);
+  }
+}
+
+//-------------------------------------------------------------------------------------//
+
+// Instances processed together, one per vector lane
+#define BANK_LANES 8
+
+/* Coefficients and state of a mode, for a group of instances. Groups are
+   stored one after the other, mode by mode (array of structures of arrays). */
+typedef struct SDTBankMode {
+  SDTModalReal b1[BANK_LANES], d1[BANK_LANES], d2[BANK_LANES],
+      b0v[BANK_LANES], b1v[BANK_LANES], m[BANK_LANES], k[BANK_LANES],
+      p0[BANK_LANES], p1[BANK_LANES], f[BANK_LANES];
+} SDTBankMode;
+
+struct SDTResonatorBank {
+  SDTResonator *model;
+  SDTBankMode *modes;
+  double *fragmentSizes, *fw;
+  unsigned char *awake;
+  int nInstances, nGroups, nModes, nPickups;
+};
+
+static SDTBankMode *bankMode(const SDTResonatorBank *x, unsigned int instance,
+                             unsigned int mode) {
+  return &x->modes[(instance / BANK_LANES) * x->nModes + mode];
+}
+
+/* Sets the coefficients of an instance for its fragment size, rescaling the
+   state as SDTResonator_setFragmentSize() does */
+static void updateInstance(SDTResonatorBank *x, unsigned int instance) {
+  SDTBankMode *b;
+  double c[N_COEFS], v;
+  int mode, lane;
+
+  lane = instance % BANK_LANES;
+  for (mode = 0; mode < x->nModes; mode++) {
+    b = bankMode(x, instance, mode);
+    modeCoefficients(x->model, mode, x->fragmentSizes[instance], c);
+    if (c[COEF_M] > 0.0) {
+      v = b->b0v[lane] * b->p0[lane] + b->b1v[lane] * b->p1[lane];
+      v *= sqrt(b->m[lane] / c[COEF_M]);
+      b->p0[lane] *= c[COEF_K] > 0.0 ? sqrt(b->k[lane] / c[COEF_K]) : 1.0;
+      b->p1[lane] = (v - c[COEF_B0V] * b->p0[lane]) / c[COEF_B1V];
+    }
+    b->m[lane] = c[COEF_M];
+    b->k[lane] = c[COEF_K];
+    b->b1[lane] = c[COEF_B1];
+    b->d1[lane] = c[COEF_D1];
+    b->d2[lane] = c[COEF_D2];
+    b->b0v[lane] = c[COEF_B0V];
+    b->b1v[lane] = c[COEF_B1V];
+  }
+}
+
+SDTResonatorBank *SDTResonatorBank_new(const SDTResonator *model,
+                                       unsigned int nInstances) {
+  SDTResonatorBank *x;
+  double sum;
+  int i, mode, pickup, lane;
+
+  x = (SDTResonatorBank *)malloc(sizeof(SDTResonatorBank));
+  x->nInstances = nInstances;
+  x->nGroups = (nInstances + BANK_LANES - 1) / BANK_LANES;
+  x->nModes = model->activeModes;
+  x->nPickups = model->nPickups;
+  x->model = SDTResonator_new(model->nModes, model->nPickups);
+  for (mode = 0; mode < model->nModes; mode++) {
+    SDTResonator_setFrequency(x->model, mode, model->freqs[mode]);
+    SDTResonator_setDecay(x->model, mode, model->decays[mode]);
+    SDTResonator_setWeight(x->model, mode, model->weights[mode]);
+    for (pickup = 0; pickup < model->nPickups; pickup++) {
+      SDTResonator_setGain(x->model, pickup, mode, model->gains[pickup][mode]);
+    }
+  }
+  SDTResonator_setActiveModes(x->model, model->activeModes);
+  SDTResonator_setSleepThreshold(x->model, model->sleepThreshold);
+  // One spare element keeps allocations valid for empty banks
+  x->modes = (SDTBankMode *)calloc(x->nGroups * x->nModes + 1,
+                                   sizeof(SDTBankMode));
+  x->fragmentSizes = (double *)calloc(nInstances + 1, sizeof(double));
+  x->fw = (double *)calloc(x->nPickups * x->nModes + 1, sizeof(double));
+  x->awake = (unsigned char *)calloc(x->nGroups + 1, 1);
+  for (pickup = 0; pickup < x->nPickups; pickup++) {
+    sum = 0.0;
+    for (mode = 0; mode < x->nModes; mode++) {
+      sum += model->gains[pickup][mode];
+    }
+    for (mode = 0; mode < x->nModes; mode++) {
+      x->fw[pickup * x->nModes + mode] =
+          sum > 0.0 ? model->gains[pickup][mode] / sum : 1.0 / x->nModes;
+    }
+  }
+  // Padding lanes hold dead modes, which stay at rest
+  for (i = 0; i < x->nGroups * x->nModes; i++) {
+    for (lane = 0; lane < BANK_LANES; lane++) {
+      x->modes[i].d1[lane] = 2.0;
+      x->modes[i].d2[lane] = 1.0;
+    }
+  }
+  for (i = 0; i < x->nInstances; i++) {
+    x->fragmentSizes[i] = model->fragmentSize;
+    updateInstance(x, i);
+  }
+  return x;
+}
+
+void SDTResonatorBank_free(SDTResonatorBank *x) {
+  SDTResonator_free(x->model);
+  free(x->modes);
+  free(x->fragmentSizes);
+  free(x->fw);
+  free(x->awake);
+  free(x);
+}
+
+int SDTResonatorBank_getNInstances(const SDTResonatorBank *x) {
+  return x->nInstances;
+}
+
+int SDTResonatorBank_getNModes(const SDTResonatorBank *x) {
+  return x->nModes;
+}
+
+int SDTResonatorBank_getNPickups(const SDTResonatorBank *x) {
+  return x->nPickups;
+}
+
+double SDTResonatorBank_getFragmentSize(const SDTResonatorBank *x,
+                                        unsigned int instance) {
+  return instance < x->nInstances ? x->fragmentSizes[instance] : 0.0;
+}
+
+double SDTResonatorBank_getPosition(const SDTResonatorBank *x,
+                                    unsigned int instance,
+                                    unsigned int pickup) {
+  const double *g;
+  double out;
+  int mode, lane;
+
+  out = 0.0;
+  if (instance < x->nInstances && pickup < x->nPickups) {
+    g = x->model->gains[pickup];
+    lane = instance % BANK_LANES;
+    for (mode = 0; mode < x->nModes; mode++) {
+      out += bankMode(x, instance, mode)->p0[lane] * g[mode];
+    }
+  }
+  return out;
+}
+
+double SDTResonatorBank_getVelocity(const SDTResonatorBank *x,
+                                    unsigned int instance,
+                                    unsigned int pickup) {
+  const SDTBankMode *b;
+  const double *g;
+  double out;
+  int mode, lane;
+
+  out = 0.0;
+  if (instance < x->nInstances && pickup < x->nPickups) {
+    g = x->model->gains[pickup];
+    lane = instance % BANK_LANES;
+    for (mode = 0; mode < x->nModes; mode++) {
+      b = bankMode(x, instance, mode);
+      out += (b->b0v[lane] * b->p0[lane] + b->b1v[lane] * b->p1[lane]) *
+             g[mode];
+    }
+  }
+  return out;
+}
+
+void SDTResonatorBank_setFragmentSize(SDTResonatorBank *x,
+                                      unsigned int instance, double f) {
+  if (instance >= x->nInstances) return;
+  f = SDT_fclip(f, 0.0, 1.0);
+  if (f == x->fragmentSizes[instance]) return;
+  x->fragmentSizes[instance] = f;
+  updateInstance(x, instance);
+}
+
+void SDTResonatorBank_reset(SDTResonatorBank *x, unsigned int instance) {
+  SDTBankMode *b;
+  int mode, lane;
+
+  if (instance >= x->nInstances) return;
+  lane = instance % BANK_LANES;
+  for (mode = 0; mode < x->nModes; mode++) {
+    b = bankMode(x, instance, mode);
+    b->p0[lane] = 0.0;
+    b->p1[lane] = 0.0;
+    b->f[lane] = 0.0;
+  }
+}
+
+void SDTResonatorBank_applyForce(SDTResonatorBank *x, unsigned int instance,
+                                 unsigned int pickup, double f) {
+  const double *fw;
+  int mode, lane;
+
+  if (instance >= x->nInstances || pickup >= x->nPickups) return;
+  if (!isnormal(f)) return;
+  fw = &x->fw[pickup * x->nModes];
+  lane = instance % BANK_LANES;
+  for (mode = 0; mode < x->nModes; mode++) {
+    bankMode(x, instance, mode)->f[lane] += f * fw[mode];
+  }
+  x->awake[instance / BANK_LANES] = 1;
+}
+
+/* Advances a group of instances by one sample. Lanes are independent from each
+   other, so the inner loop can be vectorized by the compiler. */
+static void dspGroup(SDTBankMode *restrict modes, int nModes) {
+  SDTBankMode *b;
+  SDTModalReal p;
+  int mode, lane;
+
+  for (mode = 0; mode < nModes; mode++) {
+    b = &modes[mode];
+    for (lane = 0; lane < BANK_LANES; lane++) {
+      p = b->p0[lane] + (b->p0[lane] - b->p1[lane]) -
+          b->d1[lane] * b->p0[lane] + b->d2[lane] * b->p1[lane] +
+          b->b1[lane] * b->f[lane];
+      p = p > (SDTModalReal)-MAX_POS ? p : (SDTModalReal)-MAX_POS;
+      p = p < (SDTModalReal)MAX_POS ? p : (SDTModalReal)MAX_POS;
+      b->p1[lane] = b->p0[lane];
+      b->p0[lane] = p;
+      b->f[lane] = 0.0;
+    }
+  }
+}
+
+/* Puts a group to sleep when every mode of every instance can sleep, with the
+   same criterion as single resonators */
+static void trySleepGroup(SDTResonatorBank *x, int group) {
+  SDTBankMode *modes, *b;
+  double v, e;
+  int mode, lane;
+
+  modes = &x->modes[group * x->nModes];
+  for (mode = 0; mode < x->nModes; mode++) {
+    b = &modes[mode];
+    for (lane = 0; lane < BANK_LANES; lane++) {
+      if (b->k[lane] <= 0.0 && b->m[lane] > 0.0 &&
+          (b->p0[lane] != 0.0 || b->p1[lane] != 0.0))
+        return;
+      v = b->b0v[lane] * b->p0[lane] + b->b1v[lane] * b->p1[lane];
+      e = 0.5 * (b->k[lane] * b->p0[lane] * b->p0[lane] +
+                 b->m[lane] * v * v);
+      if (e > x->model->sleepThreshold) return;
+    }
+  }
+  for (mode = 0; mode < x->nModes; mode++) {
+    b = &modes[mode];
+    for (lane = 0; lane < BANK_LANES; lane++) {
+      b->p0[lane] = 0.0;
+      b->p1[lane] = 0.0;
+    }
+  }
+  x->awake[group] = 0;
+}
+
+void SDTResonatorBank_dsp(SDTResonatorBank *x) {
+  int group;
+
+  for (group = 0; group < x->nGroups; group++) {
+    if (x->awake[group]) dspGroup(&x->modes[group * x->nModes], x->nModes);
+  }
+}
+
+void SDTResonatorBank_dspBlock(SDTResonatorBank *x, unsigned int pickup,
+                               double *out, unsigned int n) {
+  SDTBankMode *modes, *b;
+  const double *g;
+  SDTModalReal acc[BANK_LANES];
+  int group, mode, lane;
+  unsigned int i;
+
+  if (out) memset(out, 0, n * sizeof(double));
+  g = pickup < x->nPickups ? x->model->gains[pickup] : NULL;
+  /* Each group is run through the whole block while its state is in cache.
+     Sleeping groups are at rest and contribute nothing to the output. */
+  for (group = 0; group < x->nGroups; group++) {
+    if (!x->awake[group]) continue;
+    modes = &x->modes[group * x->nModes];
+    for (i = 0; i < n; i++) {
+      dspGroup(modes, x->nModes);
+      if (!out || !g) continue;
+      for (lane = 0; lane < BANK_LANES; lane++) {
+        acc[lane] = 0.0;
+      }
+      for (mode = 0; mode < x->nModes; mode++) {
+        b = &modes[mode];
+        for (lane = 0; lane < BANK_LANES; lane++) {
+          acc[lane] += b->p0[lane] * (SDTModalReal)g[mode];
+        }
+      }
+      for (lane = 0; lane < BANK_LANES; lane++) {
+        out[i] += acc[lane];
+      }
+    }
+    trySleepGroup(x, group);
+  }
+}
+
+//-------------------------------------------------------------------------------------//
+
+// Blackman-Harris synthesis kernel: half width in bins and table oversampling
+#define KERNEL_WIDTH 4
+#define KERNEL_OVERSAMPLING 64
+
+struct SDTSpectralResonator {
+  SDTFFT *fft;
+  SDTComplex *z, *step, *spectrum;
+  double fragmentSize, *freqs, *decays, *weights, **gains, *bins, *amps,
+      *dampings, *kernel, *window, *frame, **ola;
+  int nModes, nPickups, activeModes, hopSize, frameSize, pos, dirty;
+};
+
+SDTSpectralResonator *SDTSpectralResonator_new(unsigned int nModes,
+                                               unsigned int nPickups) {
+  SDTSpectralResonator *x;
+  double a, u;
+  int i, pickup, t;
+
+  x = (SDTSpectralResonator *)malloc(sizeof(SDTSpectralResonator));
+  x->hopSize = SDT_SPECTRAL_RESONATOR_HOPSIZE;
+  x->frameSize = 4 * x->hopSize;
+  x->fft = SDTFFT_new(x->frameSize / 2);
+  x->z = (SDTComplex *)calloc(nModes + 1, sizeof(SDTComplex));
+  x->step = (SDTComplex *)calloc(nModes + 1, sizeof(SDTComplex));
+  x->spectrum = (SDTComplex *)calloc(
+      nPickups * (x->frameSize / 2 + 1) + 1, sizeof(SDTComplex));
+  x->freqs = (double *)calloc(nModes + 1, sizeof(double));
+  x->decays = (double *)calloc(nModes + 1, sizeof(double));
+  x->weights = (double *)calloc(nModes + 1, sizeof(double));
+  x->bins = (double *)calloc(nModes + 1, sizeof(double));
+  x->amps = (double *)calloc(nModes + 1, sizeof(double));
+  x->dampings = (double *)calloc(nModes + 1, sizeof(double));
+  x->kernel = (double *)calloc(KERNEL_WIDTH * KERNEL_OVERSAMPLING + 2,
+                               sizeof(double));
+  x->window = (double *)calloc(2 * x->hopSize, sizeof(double));
+  x->frame = (double *)calloc(x->frameSize, sizeof(double));
+  x->gains = (double **)malloc((nPickups + 1) * sizeof(double *));
+  x->ola = (double **)malloc((nPickups + 1) * sizeof(double *));
+  for (pickup = 0; pickup < nPickups; pickup++) {
+    x->gains[pickup] = (double *)calloc(nModes + 1, sizeof(double));
+    x->ola[pickup] = (double *)calloc(2 * x->hopSize, sizeof(double));
+  }
+  /* Spectrum of a zero-phase Blackman-Harris window, as a function of the
+     distance from its center in bins */
+  for (i = 0; i <= KERNEL_WIDTH * KERNEL_OVERSAMPLING; i++) {
+    a = SDT_TWOPI * i / KERNEL_OVERSAMPLING / x->frameSize;
+    for (t = 0; t < x->frameSize; t++) {
+      u = SDT_TWOPI * (t - x->frameSize / 2) / x->frameSize;
+      x->kernel[i] += (0.35875 + 0.48829 * cos(u) + 0.14128 * cos(2.0 * u) +
+                       0.01168 * cos(3.0 * u)) *
+                      cos(a * (t - x->frameSize / 2));
+    }
+  }
+  /* Synthesis window: replaces the Blackman-Harris window with a triangular
+     one around the frame center, so that frames overlap-add to unity */
+  for (t = 0; t < 2 * x->hopSize; t++) {
+    u = SDT_TWOPI * (t - x->hopSize) / x->frameSize;
+    x->window[t] = (1.0 - fabs(t - x->hopSize) / x->hopSize) /
+                   (0.35875 + 0.48829 * cos(u) + 0.14128 * cos(2.0 * u) +
+                    0.01168 * cos(3.0 * u)) /
+                   x->frameSize;
+  }
+  x->fragmentSize = 1.0;
+  x->nModes = nModes;
+  x->nPickups = nPickups;
+  x->activeModes = nModes;
+  x->pos = x->hopSize;
+  x->dirty = 1;
+  return x;
+}
+
+void SDTSpectralResonator_free(SDTSpectralResonator *x) {
+  int pickup;
+
+  for (pickup = 0; pickup < x->nPickups; pickup++) {
+    free(x->gains[pickup]);
+    free(x->ola[pickup]);
+  }
+  SDTFFT_free(x->fft);
+  free(x->z);
+  free(x->step);
+  free(x->spectrum);
+  free(x->freqs);
+  free(x->decays);
+  free(x->weights);
+  free(x->bins);
+  free(x->amps);
+  free(x->dampings);
+  free(x->kernel);
+  free(x->window);
+  free(x->frame);
+  free(x->gains);
+  free(x->ola);
+  free(x);
+}
+
+/* Modes follow the same fragment size scaling and stability limits as the
+   recursive resonator. Inertial and unstable modes are silent. */
+static void updateSpectralModes(SDTSpectralResonator *x) {
+  double u, w, wt, m, d, g, r;
+  int mode;
+
+  if (!x->dirty) return;
+  u = sqrt(x->fragmentSize);
+  for (mode = 0; mode < x->nModes; mode++) {
+    w = SDT_TWOPI * x->freqs[mode] / u;
+    wt = w * SDT_timeStep;
+    m = x->weights[mode] * x->fragmentSize;
+    if (wt > 0.0 && wt < acos(-0.9995) && m > SDT_MICRO) {
+      d = x->decays[mode] * u;
+      g = d > 0.0 ? 2.0 / d : 0.0;
+      r = exp(-g * SDT_timeStep * x->hopSize);
+      x->bins[mode] = wt * x->frameSize / SDT_TWOPI;
+      x->amps[mode] = SDT_timeStep / (m * w);
+      x->dampings[mode] = g * SDT_timeStep;
+      x->step[mode].r = r * cos(wt * x->hopSize);
+      x->step[mode].i = r * sin(wt * x->hopSize);
+    } else {
+      x->bins[mode] = -1.0;
+      x->amps[mode] = 0.0;
+      x->dampings[mode] = 0.0;
+      x->z[mode].r = 0.0;
+      x->z[mode].i = 0.0;
+    }
+  }
+  x->dirty = 0;
+}
+
+void SDTSpectralResonator_update(SDTSpectralResonator *x) {
+  x->dirty = 1;
+  updateSpectralModes(x);
+}
+
+int SDTSpectralResonator_getNModes(const SDTSpectralResonator *x) {
+  return x->nModes;
+}
+
+int SDTSpectralResonator_getNPickups(const SDTSpectralResonator *x) {
+  return x->nPickups;
+}
+
+int SDTSpectralResonator_getActiveModes(const SDTSpectralResonator *x) {
+  return x->activeModes;
+}
+
+int SDTSpectralResonator_getHopSize(const SDTSpectralResonator *x) {
+  return x->hopSize;
+}
+
+double SDTSpectralResonator_getFrequency(const SDTSpectralResonator *x,
+                                         unsigned int mode) {
+  return mode < x->nModes ? x->freqs[mode] : 0.0;
+}
+
+double SDTSpectralResonator_getDecay(const SDTSpectralResonator *x,
+                                     unsigned int mode) {
+  return mode < x->nModes ? x->decays[mode] : 0.0;
+}
+
+double SDTSpectralResonator_getWeight(const SDTSpectralResonator *x,
+                                      unsigned int mode) {
+  return mode < x->nModes ? x->weights[mode] : 0.0;
+}
+
+double SDTSpectralResonator_getGain(const SDTSpectralResonator *x,
+                                    unsigned int pickup, unsigned int mode) {
+  return mode < x->nModes && pickup < x->nPickups ? x->gains[pickup][mode]
+                                                  : 0.0;
+}
+
+double SDTSpectralResonator_getFragmentSize(const SDTSpectralResonator *x) {
+  return x->fragmentSize;
+}
+
+void SDTSpectralResonator_setFrequency(SDTSpectralResonator *x,
+                                       unsigned int mode, double f) {
+  if (mode < x->nModes) {
+    x->freqs[mode] = f;
+    x->dirty = 1;
+  }
+}
+
+void SDTSpectralResonator_setDecay(SDTSpectralResonator *x, unsigned int mode,
+                                   double f) {
+  if (mode < x->nModes) {
+    x->decays[mode] = fmax(0.0, f);
+    x->dirty = 1;
+  }
+}
+
+void SDTSpectralResonator_setWeight(SDTSpectralResonator *x, unsigned int mode,
+                                    double f) {
+  if (mode < x->nModes) {
+    x->weights[mode] = fmax(0.0, f);
+    x->dirty = 1;
+  }
+}
+
+void SDTSpectralResonator_setGain(SDTSpectralResonator *x, unsigned int pickup,
+                                  unsigned int mode, double f) {
+  if (mode < x->nModes && pickup < x->nPickups) {
+    x->gains[pickup][mode] = fmax(f, 0.0);
+  }
+}
+
+void SDTSpectralResonator_setFragmentSize(SDTSpectralResonator *x, double f) {
+  f = SDT_fclip(f, 0.0, 1.0);
+  if (f == x->fragmentSize) return;
+  x->fragmentSize = f;
+  x->dirty = 1;
+}
+
+void SDTSpectralResonator_setActiveModes(SDTSpectralResonator *x,
+                                         unsigned int i) {
+  x->activeModes = i < x->nModes ? i : x->nModes;
+}
+
+void SDTSpectralResonator_applyForce(SDTSpectralResonator *x,
+                                     unsigned int pickup, double f) {
+  double sum, a, phase;
+  int mode, n;
+
+  if (pickup >= x->nPickups || !isnormal(f)) return;
+  updateSpectralModes(x);
+  sum = 0.0;
+  for (mode = 0; mode < x->activeModes; mode++) {
+    sum += x->gains[pickup][mode];
+  }
+  /* The impulse response starts one sample before the next output sample,
+     as in the recursive resonator. It is added to the modal states, which are
+     analytic signals taken at the center of the next frame. */
+  n = 2 * x->hopSize - x->pos + 1;
+  for (mode = 0; mode < x->activeModes; mode++) {
+    if (x->bins[mode] < 0.0) continue;
+    a = sum > 0.0 ? f * x->gains[pickup][mode] / sum : f / x->activeModes;
+    a *= x->amps[mode] * exp(-x->dampings[mode] * n);
+    phase = SDT_TWOPI * x->bins[mode] / x->frameSize * n;
+    x->z[mode].r += a * sin(phase);
+    x->z[mode].i -= a * cos(phase);
+  }
+}
+
+/* Synthesizes the next frame and overlap-adds it to the output buffers */
+static void spectralFrame(SDTSpectralResonator *x) {
+  SDTComplex *spectrum, c;
+  double b, d, w, g;
+  int nBins, mode, pickup, k, kk, i, t, active;
+
+  nBins = x->frameSize / 2;
+  for (pickup = 0; pickup < x->nPickups; pickup++) {
+    memmove(x->ola[pickup], x->ola[pickup] + x->hopSize,
+            x->hopSize * sizeof(double));
+    memset(x->ola[pickup] + x->hopSize, 0, x->hopSize * sizeof(double));
+  }
+  memset(x->spectrum, 0, x->nPickups * (nBins + 1) * sizeof(SDTComplex));
+  active = 0;
+  for (mode = 0; mode < x->activeModes; mode++) {
+    if (x->bins[mode] < 0.0) continue;
+    if (fabs(x->z[mode].r) + fabs(x->z[mode].i) < 1e-30) {
+      x->z[mode].r = 0.0;
+      x->z[mode].i = 0.0;
+      continue;
+    }
+    active = 1;
+    // Only the main lobe of the window spectrum is synthesized
+    b = x->bins[mode];
+    for (k = (int)ceil(b - KERNEL_WIDTH); k <= (int)floor(b + KERNEL_WIDTH);
+         k++) {
+      d = fabs(k - b) * KERNEL_OVERSAMPLING;
+      i = (int)d;
+      w = x->kernel[i] + (d - i) * (x->kernel[i + 1] - x->kernel[i]);
+      // Half amplitude, and a phase shift centering the window in the frame
+      w *= (k & 1) ? -0.5 : 0.5;
+      c.r = w * x->z[mode].r;
+      c.i = w * x->z[mode].i;
+      // Bins outside [0, nBins] fold back as complex conjugates
+      kk = k;
+      if (k < 0 || k > nBins) {
+        kk = k < 0 ? -k : x->frameSize - k;
+        c.i = -c.i;
+      }
+      for (pickup = 0; pickup < x->nPickups; pickup++) {
+        g = x->gains[pickup][mode];
+        spectrum = x->spectrum + pickup * (nBins + 1);
+        spectrum[kk].r += g * c.r;
+        spectrum[kk].i += g * c.i;
+        // DC and Nyquist bins also receive their own conjugates
+        if (kk == 0 || kk == nBins) spectrum[kk].r += g * c.r;
+      }
+    }
+    c = x->z[mode];
+    x->z[mode].r = c.r * x->step[mode].r - c.i * x->step[mode].i;
+    x->z[mode].i = c.r * x->step[mode].i + c.i * x->step[mode].r;
+  }
+  if (!active) return;
+  for (pickup = 0; pickup < x->nPickups; pickup++) {
+    SDTFFT_ifftr(x->fft, x->spectrum + pickup * (nBins + 1), x->frame);
+    for (t = 0; t < 2 * x->hopSize; t++) {
+      x->ola[pickup][t] += x->frame[nBins - x->hopSize + t] * x->window[t];
+    }
+  }
+}
+
+void SDTSpectralResonator_dspBlock(SDTSpectralResonator *x, double **outs,
+                                   unsigned int n) {
+  unsigned int i, m;
+  int pickup;
+
+  updateSpectralModes(x);
+  i = 0;
+  while (i < n) {
+    if (x->pos == x->hopSize) {
+      spectralFrame(x);
+      x->pos = 0;
+    }
+    m = x->hopSize - x->pos;
+    if (m > n - i) m = n - i;
+    if (outs) {
+      for (pickup = 0; pickup < x->nPickups; pickup++) {
+        if (!outs[pickup]) continue;
+        memcpy(outs[pickup] + i, x->ola[pickup] + x->pos, m * sizeof(double));
+      }
+    }
+    x->pos += m;
+    i += m;
+  }
+}
+
+json_value *SDTSpectralResonator_toJSON(const SDTSpectralResonator *x) {
+  json_value *obj = json_object_new(0), *freqs, *decays, *weights, *gains, *a;
+  int mode, pickup;
+
+  freqs = json_array_new(0);
+  decays = json_array_new(0);
+  weights = json_array_new(0);
+  gains = json_array_new(0);
+  for (mode = 0; mode < x->nModes; mode++) {
+    json_array_push(freqs, json_double_new(x->freqs[mode]));
+    json_array_push(decays, json_double_new(x->decays[mode]));
+    json_array_push(weights, json_double_new(x->weights[mode]));
+  }
+  for (pickup = 0; pickup < x->nPickups; pickup++) {
+    a = json_array_new(0);
+    for (mode = 0; mode < x->nModes; mode++) {
+      json_array_push(a, json_double_new(x->gains[pickup][mode]));
+    }
+    json_array_push(gains, a);
+  }
+  json_object_push(obj, "freqs", freqs);
+  json_object_push(obj, "decays", decays);
+  json_object_push(obj, "weights", weights);
+  json_object_push(obj, "gains", gains);
+  json_object_push(obj, "nModes", json_integer_new(x->nModes));
+  json_object_push(obj, "nPickups", json_integer_new(x->nPickups));
+  json_object_push(obj, "activeModes", json_integer_new(x->activeModes));
+  json_object_push(obj, "fragmentSize", json_double_new(x->fragmentSize));
+  return obj;
+}
+
+SDTSpectralResonator *SDTSpectralResonator_fromJSON(const json_value *x) {
+  if (!x || x->type != json_object) return 0;
+
+  int nModes = SDT_RESONATOR_NMODES_DEFAULT;
+  int nPickups = SDT_RESONATOR_NPICKUPS_DEFAULT;
+  _SDT_GET_PARAM_FROM_JSON(nModes, x, nModes, integer);
+  _SDT_GET_PARAM_FROM_JSON(nPickups, x, nPickups, integer);
+
+  SDTSpectralResonator *y = SDTSpectralResonator_new(nModes, nPickups);
+  return SDTSpectralResonator_setParams(y, x);
+}
+
+SDTSpectralResonator *SDTSpectralResonator_setParams(SDTSpectralResonator *x,
+                                                     const json_value *j) {
+  unsigned int mode, pickup;
+  const json_value *v_f, *v_d, *v_w, *v_g;
+
+  _SDT_SET_PARAM_FROM_JSON(SpectralResonator, x, j, ActiveModes, activeModes,
+                           integer);
+  _SDT_SET_DOUBLE_FROM_JSON(SpectralResonator, x, j, FragmentSize,
+                            fragmentSize);
+  v_f = SDTJSON_object_get_by_key(j, "freqs");
+  v_d = SDTJSON_object_get_by_key(j, "decays");
+  v_w = SDTJSON_object_get_by_key(j, "weights");
+  for (mode = 0; mode < x->nModes; ++mode) {
+    SDTSpectralResonator_setFrequency(
+        x, mode, SDTJSON_array_get_number(v_f, mode, x->freqs[mode]));
+    SDTSpectralResonator_setDecay(
+        x, mode, SDTJSON_array_get_number(v_d, mode, x->decays[mode]));
+    SDTSpectralResonator_setWeight(
+        x, mode, SDTJSON_array_get_number(v_w, mode, x->weights[mode]));
+  }
+  v_g = SDTJSON_object_get_by_key(j, "gains");
+  if (v_g && v_g->type == json_array) {
+    for (pickup = 0; pickup < x->nPickups && pickup < v_g->u.array.length;
+         ++pickup) {
+      for (mode = 0; mode < x->nModes; ++mode) {
+        SDTSpectralResonator_setGain(
+            x, pickup, mode,
+            SDTJSON_array_get_number(v_g->u.array.values[pickup], mode,
+                                     x->gains[pickup][mode]));
+      }
+    }
+  }
+  return x;
+}
+
+//-------------------------------------------------------------------------------------//
 
 #define _SDTResonator_toArrayJSON(ATTR)                                  \
   json_value *_SDTResonator_to##ATTR##JSON(const SDTResonator *x) {      \
@@ -509,10 +2092,17 @@ json_value *SDTResonator_toJSON(const SDTResonator *x) {
   json_object_push(obj, "nModes", json_integer_new(SDTResonator_getNModes(x)));
   json_object_push(obj, "nPickups",
                    json_integer_new(SDTResonator_getNPickups(x)));
-  json_object_push(obj, "activeModes",
-                   json_integer_new(SDTResonator_getActiveModes(x)));
+  json_object_push(obj, "modeCapacity",
+                   json_integer_new(SDTResonator_getModeCapacity(x)));
+  json_object_push(obj, "pickupCapacity",
+                   json_integer_new(SDTResonator_getPickupCapacity(x)));
+  json_object_push(obj, "activeModes", json_integer_new(x->requestedModes));
   json_object_push(obj, "fragmentSize",
                    json_double_new(SDTResonator_getFragmentSize(x)));
+  json_object_push(obj, "sleepThreshold",
+                   json_double_new(SDTResonator_getSleepThreshold(x)));
+  json_object_push(obj, "priority",
+                   json_double_new(SDTResonator_getPriority(x)));
   return obj;
 }
 
@@ -524,20 +2114,45 @@ SDTResonator *SDTResonator_fromJSON(const json_value *x) {
   _SDT_GET_PARAM_FROM_JSON(nModes, x, nModes, integer);
   _SDT_GET_PARAM_FROM_JSON(nPickups, x, nPickups, integer);
 
+  int modeCapacity = nModes;
+  int pickupCapacity = nPickups;
+  _SDT_GET_PARAM_FROM_JSON(modeCapacity, x, modeCapacity, integer);
+  _SDT_GET_PARAM_FROM_JSON(pickupCapacity, x, pickupCapacity, integer);
+
   SDTResonator *y = SDTResonator_new(nModes, nPickups);
+  SDTResonator_reserve(y, modeCapacity, pickupCapacity);
   return SDTResonator_setParams(y, x, 0);
 }
 
+// Changing size is safe while within capacity
+static int fitsCapacity(const json_value *j, const char *key, int capacity) {
+  const json_value *v = SDTJSON_object_get_by_key(j, key);
+  return v && v->type == json_integer && v->u.integer <= capacity;
+}
+
 SDTResonator *SDTResonator_setParams(SDTResonator *x, const json_value *j,
                                      unsigned char unsafe) {
-  // Set n modes/pickups (unsafe)
-  _SDT_SET_UNSAFE_PARAM_FROM_JSON(Resonator, x, j, NModes, nModes, integer,
-                                  unsafe);
-  _SDT_SET_UNSAFE_PARAM_FROM_JSON(Resonator, x, j, NPickups, nPickups, integer,
-                                  unsafe);
+  // Reserve memory (unsafe)
+  if (unsafe) {
+    int modeCapacity = x->reservedModes;
+    int pickupCapacity = x->reservedPickups;
+    _SDT_GET_PARAM_FROM_JSON(modeCapacity, j, modeCapacity, integer);
+    _SDT_GET_PARAM_FROM_JSON(pickupCapacity, j, pickupCapacity, integer);
+    SDTResonator_reserve(x, modeCapacity, pickupCapacity);
+  }
+  // Set n modes/pickups (unsafe beyond capacity)
+  adoptStorage(x);
+  _SDT_SET_UNSAFE_PARAM_FROM_JSON(
+      Resonator, x, j, NModes, nModes, integer,
+      unsafe || fitsCapacity(j, "nModes", x->modeCapacity));
+  _SDT_SET_UNSAFE_PARAM_FROM_JSON(
+      Resonator, x, j, NPickups, nPickups, integer,
+      unsafe || fitsCapacity(j, "nPickups", x->pickupCapacity));
   // Scalar members
   _SDT_SET_PARAM_FROM_JSON(Resonator, x, j, ActiveModes, activeModes, integer);
   _SDT_SET_DOUBLE_FROM_JSON(Resonator, x, j, FragmentSize, fragmentSize);
+  _SDT_SET_DOUBLE_FROM_JSON(Resonator, x, j, SleepThreshold, sleepThreshold);
+  _SDT_SET_DOUBLE_FROM_JSON(Resonator, x, j, Priority, priority);
 
   // Array members
   unsigned int mode, pickup;
@@ -570,6 +2185,233 @@ SDTResonator *SDTResonator_setParams(SDTResonator *x, const json_value *j,
     }
   }
 
-  SDTResonator_update(x);
+  SDTResonator_commit(x);
+  return x;
+}
+
+//-------------------------------------------------------------------------------------//
+
+// Maximum growth of the mode budget per update, under a CPU load target
+#define BUDGET_GROWTH 1.1
+
+typedef struct SDTBudgetItem {
+  SDTResonator *x;
+  double score;
+  int modes;
+} SDTBudgetItem;
+
+struct SDTModalBudget {
+  SDTBudgetItem *items;
+  SDTModalBudget *next;
+  double targetLoad, load, budget;
+  int maxModes, minModes, usedModes, requestedModes, nItems, itemCapacity;
+};
+
+// Every budget in existence, so their items can grow when resonators are
+// registered rather than in SDTModalBudget_update()
+static SDTModalBudget *budgets = NULL;
+
+static void reserveItems(SDTModalBudget *x, int n) {
+  SDTBudgetItem *items;
+
+  if (n <= x->itemCapacity) return;
+  n = 2 * n > 8 ? 2 * n : 8;
+  items = (SDTBudgetItem *)malloc(n * sizeof(SDTBudgetItem));
+  if (x->items) free(x->items);
+  x->items = items;
+  x->itemCapacity = n;
+}
+
+static void reserveBudgetItems(int n) {
+  SDTModalBudget *x;
+
+  for (x = budgets; x; x = x->next) reserveItems(x, n);
+}
+
+SDTModalBudget *SDTModalBudget_new() {
+  SDTModalBudget *x;
+
+  x = (SDTModalBudget *)malloc(sizeof(SDTModalBudget));
+  x->items = NULL;
+  x->next = budgets;
+  budgets = x;
+  x->targetLoad = 0.0;
+  x->load = 0.0;
+  x->budget = SDT_MODALBUDGET_MAXMODES_DEFAULT;
+  x->maxModes = SDT_MODALBUDGET_MAXMODES_DEFAULT;
+  x->minModes = SDT_MODALBUDGET_MINMODES_DEFAULT;
+  x->usedModes = 0;
+  x->requestedModes = 0;
+  x->nItems = 0;
+  x->itemCapacity = 0;
+  reserveItems(x, nResonators);
+  return x;
+}
+
+void SDTModalBudget_free(SDTModalBudget *x) {
+  SDTModalBudget **p;
+
+  for (p = &budgets; *p; p = &(*p)->next) {
+    if (*p == x) {
+      *p = x->next;
+      break;
+    }
+  }
+  if (x->items) free(x->items);
+  free(x);
+}
+
+_SDT_COPY_FUNCTION(ModalBudget)
+_SDT_HASHMAP_FUNCTIONS(ModalBudget)
+
+int SDTModalBudget_getMaxModes(const SDTModalBudget *x) { return x->maxModes; }
+
+int SDTModalBudget_getMinModes(const SDTModalBudget *x) { return x->minModes; }
+
+double SDTModalBudget_getTargetLoad(const SDTModalBudget *x) {
+  return x->targetLoad;
+}
+
+double SDTModalBudget_getLoad(const SDTModalBudget *x) { return x->load; }
+
+int SDTModalBudget_getBudget(const SDTModalBudget *x) { return x->budget; }
+
+int SDTModalBudget_getUsedModes(const SDTModalBudget *x) {
+  return x->usedModes;
+}
+
+int SDTModalBudget_getRequestedModes(const SDTModalBudget *x) {
+  return x->requestedModes;
+}
+
+double SDTModalBudget_getUsage(const SDTModalBudget *x) {
+  return x->budget > 0.0 ? x->usedModes / x->budget : 0.0;
+}
+
+void SDTModalBudget_setMaxModes(SDTModalBudget *x, int i) {
+  x->maxModes = i > 0 ? i : 0;
+  x->budget = fmin(x->budget, x->maxModes);
+  if (x->targetLoad <= 0.0) x->budget = x->maxModes;
+}
+
+void SDTModalBudget_setMinModes(SDTModalBudget *x, int i) {
+  x->minModes = i > 0 ? i : 0;
+}
+
+void SDTModalBudget_setTargetLoad(SDTModalBudget *x, double f) {
+  x->targetLoad = SDT_fclip(f, 0.0, 1.0);
+  if (x->targetLoad <= 0.0) x->budget = x->maxModes;
+}
+
+void SDTModalBudget_setLoad(SDTModalBudget *x, double f) {
+  x->load = fmax(0.0, f);
+}
+
+static void collectResonator(const char *key, void *value, void *data) {
+  SDTModalBudget *x = (SDTModalBudget *)data;
+  SDTResonator *r = (SDTResonator *)value;
+  double score;
+  int i, mode;
+
+  // Sleeping resonators cost nothing and are left unrestricted
+  if (!r->awakeModes) {
+    SDTResonator_setModeLimit(r, INT_MAX);
+    return;
+  }
+  // Items are reserved on registration, never allocated here
+  if (x->nItems == x->itemCapacity) return;
+  // Audibility estimate: modal energy, weighted by priority
+  score = 0.0;
+  for (i = 0; i < r->liveModes; i++) {
+    mode = r->live[i];
+    score += modalEnergy(r, mode, r->p0[mode], r->v[mode]);
+  }
+  x->items[x->nItems].x = r;
+  x->items[x->nItems].score = score * r->priority;
+  x->items[x->nItems].modes =
+      r->requestedModes < r->nModes ? r->requestedModes : r->nModes;
+  x->nItems++;
+}
+
+static int compareItems(const void *a, const void *b) {
+  double sa = ((const SDTBudgetItem *)a)->score;
+  double sb = ((const SDTBudgetItem *)b)->score;
+  return (sa < sb) - (sa > sb);
+}
+
+void SDTModalBudget_update(SDTModalBudget *x) {
+  SDTBudgetItem *item;
+  double estimate;
+  int i, base, extra, remaining;
+
+  // Under a load target, the budget follows the cost measured per used mode
+  if (x->targetLoad > 0.0 && x->load > 0.0 && x->usedModes > 0) {
+    estimate = x->usedModes * x->targetLoad / x->load;
+    if (estimate > x->budget)
+      estimate = fmin(estimate, x->budget * BUDGET_GROWTH + 1.0);
+    x->budget = fmin(estimate, x->maxModes);
+  }
+  x->nItems = 0;
+  if (hashmap_Resonator) {
+    SDTHashmap_forEach(hashmap_Resonator, collectResonator, x);
+  }
+  if (x->nItems > 1) {
+    qsort(x->items, x->nItems, sizeof(SDTBudgetItem), compareItems);
+  }
+  // Every resonator keeps a few modes, the rest goes to the most audible ones
+  remaining = x->budget;
+  x->requestedModes = 0;
+  for (i = 0; i < x->nItems; i++) {
+    x->requestedModes += x->items[i].modes;
+    remaining -= x->items[i].modes < x->minModes ? x->items[i].modes
+                                                 : x->minModes;
+  }
+  x->usedModes = 0;
+  for (i = 0; i < x->nItems; i++) {
+    item = &x->items[i];
+    base = item->modes < x->minModes ? item->modes : x->minModes;
+    extra = item->modes - base;
+    if (extra > remaining) extra = remaining > 0 ? remaining : 0;
+    remaining -= extra;
+    x->usedModes += base + extra;
+    SDTResonator_setModeLimit(item->x,
+                              base + extra < item->modes ? base + extra
+                                                         : INT_MAX);
+  }
+}
+
+json_value *SDTModalBudget_toJSON(const SDTModalBudget *x) {
+  json_value *obj = json_object_new(0);
+  json_object_push(obj, "maxModes",
+                   json_integer_new(SDTModalBudget_getMaxModes(x)));
+  json_object_push(obj, "minModes",
+                   json_integer_new(SDTModalBudget_getMinModes(x)));
+  json_object_push(obj, "targetLoad",
+                   json_double_new(SDTModalBudget_getTargetLoad(x)));
+  // Current state, ignored when loading
+  json_object_push(obj, "load", json_double_new(SDTModalBudget_getLoad(x)));
+  json_object_push(obj, "budget",
+                   json_integer_new(SDTModalBudget_getBudget(x)));
+  json_object_push(obj, "usedModes",
+                   json_integer_new(SDTModalBudget_getUsedModes(x)));
+  json_object_push(obj, "requestedModes",
+                   json_integer_new(SDTModalBudget_getRequestedModes(x)));
+  json_object_push(obj, "usage", json_double_new(SDTModalBudget_getUsage(x)));
+  return obj;
+}
+
+SDTModalBudget *SDTModalBudget_fromJSON(const json_value *x) {
+  if (!x || x->type != json_object) return 0;
+  SDTModalBudget *y = SDTModalBudget_new();
+  return SDTModalBudget_setParams(y, x, 0);
+}
+
+SDTModalBudget *SDTModalBudget_setParams(SDTModalBudget *x,
+                                         const json_value *j,
+                                         unsigned char unsafe) {
+  if (!x || !j || j->type != json_object) return 0;
+  _SDT_SET_PARAM_FROM_JSON(ModalBudget, x, j, MaxModes, maxModes, integer);
+  _SDT_SET_PARAM_FROM_JSON(ModalBudget, x, j, MinModes, minModes, integer);
+  _SDT_SET_DOUBLE_FROM_JSON(ModalBudget, x, j, TargetLoad, targetLoad);
   return x;
 }
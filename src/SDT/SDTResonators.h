@@ -13,6 +13,12 @@ pickup points on the resonating object. A single mode with a resonant frequency
 of 0 Hz, infinite decay time and unity pickup gain behaves like an inertial
 point mass. The model uses the impulse invariant method as discretization
 scheme.
+
+Modal state and filter coefficients are stored in double precision. Defining
+SDT_RESONATOR_FLOAT32 at build time stores them in single precision instead,
+which halves memory traffic and doubles the vector width of the modal kernel
+in large resonators. Parameters and the programming interface stay in double
+precision.
 @{
 */
 
@@ -29,6 +35,8 @@ typedef struct SDTResonator SDTResonator;
 #define SDT_RESONATOR_NMODES_DEFAULT 1
 #define SDT_RESONATOR_NPICKUPS_DEFAULT 1
 #define SDT_RESONATOR_NPICKUPS_MAX 16
+// Modes reserved by the Pd and Max externals, for presets loaded while running
+#define SDT_RESONATOR_NMODES_RESERVE 256
 
 /** @brief Object constructor.
 @param[in] nModes Number of resonant modes
@@ -46,6 +54,15 @@ Call this function whenever you change the SDT sample rate.
 @param[in] x Pointer to the instance to update */
 extern void SDTResonator_update(SDTResonator *x);
 
+/** @brief Applies pending parameter changes.
+Setting frequencies, decays, weights, gains, fragment size or active modes
+only marks the affected modes and pickups as modified. Their coefficients are
+recomputed all at once by this function, which is called automatically before
+processing, applying forces or computing energies. Call it explicitly to
+control when the cost of the update is paid.
+@param[in] x Pointer to the instance to update */
+extern void SDTResonator_commit(SDTResonator *x);
+
 /** @brief Deep-copies a resonator.
 @param[in] dest Pointer to the instance to modify
 @param[in] src Pointer to the instance to copy
@@ -107,12 +124,30 @@ extern SDTResonator *SDTResonator_fromJSON(const json_value *x);
 extern double SDTResonator_getPosition(const SDTResonator *x,
                                        unsigned int pickup);
 
+/** @brief Gets the displacement of the object at all pickup points.
+Reading all pickups at once costs about as much as reading a single one.
+Displacements are as of the last committed update.
+@param[out] outs Object displacements, in m, one per pickup point */
+extern void SDTResonator_getPositions(const SDTResonator *x, double *outs);
+
 /** @brief Gets the velocity of the object at a given pickup point.
 @param[in] pickup Pickup point
 @return Object velocity, in m/s */
 extern double SDTResonator_getVelocity(const SDTResonator *x,
                                        unsigned int pickup);
 
+/** @brief Bounds the displacement of the object at a given pickup point, over
+the free evolution of the resonator. The bounds hold for as long as no force,
+position, velocity or parameter change is applied, i.e. until the revision
+number changes. Oscillating modes are bounded by their current amplitude,
+undamped inertial modes by their direction of motion.
+@param[in] pickup Pickup point
+@param[out] lo Lower bound of the displacement, in m
+@param[out] hi Upper bound of the displacement, in m */
+extern void SDTResonator_getPositionBounds(const SDTResonator *x,
+                                           unsigned int pickup, double *lo,
+                                           double *hi);
+
 /** @brief Gets the resonant frequency for a given mode
 @param[in] mode Mode number
 @return Modal frequency, in Hz */
@@ -145,21 +180,84 @@ extern int SDTResonator_getNPickups(const SDTResonator *x);
 @return Number of resonant modes */
 extern int SDTResonator_getNModes(const SDTResonator *x);
 
+/** @brief Gets the number of resonant modes allocated in memory
+@return Maximum number of resonant modes before reallocation */
+extern int SDTResonator_getModeCapacity(const SDTResonator *x);
+
+/** @brief Gets the number of pickup points allocated in memory
+@return Maximum number of pickup points before reallocation */
+extern int SDTResonator_getPickupCapacity(const SDTResonator *x);
+
 /** @brief Gets the number of active modes
 @return Number of active modes */
 extern int SDTResonator_getActiveModes(const SDTResonator *x);
 
+/** @brief Gets the number of awake modes.
+Awake modes are the active modes currently computed, i.e. those that have not
+been put to sleep because their energy fell below the sleep threshold.
+@return Number of awake modes */
+extern int SDTResonator_getAwakeModes(const SDTResonator *x);
+
+/** @brief Gets the number of live modes.
+Live modes are the active modes that can reach an output. Modes above the
+Nyquist frequency, modes with negligible mass and modes with zero gain on every
+pickup are not live: they are kept at rest and skipped by all computations.
+@return Number of live modes */
+extern int SDTResonator_getLiveModes(const SDTResonator *x);
+
+/** @brief Gets the revision number of the resonator state.
+The revision changes whenever the free evolution of the resonator is perturbed:
+when a force, a position or a velocity is applied, and when its modes change.
+@return Revision number */
+extern unsigned long SDTResonator_getRevision(const SDTResonator *x);
+
+/** @brief Gets the revision number of the resonator parameters.
+The revision changes whenever a parameter shaping the response of the resonator
+changes: frequencies, decays, weights, gains, number of modes, pickups or active
+modes, and sleep threshold. Unlike SDTResonator_getRevision(), it does not
+change when the resonator is excited, nor with the fragment size.
+@return Parameter revision number */
+extern unsigned long SDTResonator_getParamRevision(const SDTResonator *x);
+
 /** @brief Gets the fragment size
 @return Fragment size */
 extern double SDTResonator_getFragmentSize(const SDTResonator *x);
 
+/** @brief Gets the sleep threshold
+@return Modal energy below which a mode is put to sleep, in J */
+extern double SDTResonator_getSleepThreshold(const SDTResonator *x);
+
+/** @brief Gets the mode limit
+@return Maximum number of computed modes */
+extern int SDTResonator_getModeLimit(const SDTResonator *x);
+
+/** @brief Gets the priority
+@return Priority of the resonator when sharing a mode budget */
+extern double SDTResonator_getPriority(const SDTResonator *x);
+
+/** @brief Allocates memory for the given number of modes and pickup points.
+Capacity is only ever grown. After reserving, setting the number of modes and
+pickup points up to the reserved amounts does not allocate memory.
+The memory is allocated by this function, and swapped in by the next commit of
+the resonator, which does not allocate. It can therefore be called from a host
+thread while the audio thread is processing, but not inside a DSP cycle.
+@param[in] nModes Number of resonant modes
+@param[in] nPickups Number of pickup points */
+extern void SDTResonator_reserve(SDTResonator *x, int nModes, int nPickups);
+
 /** @brief Sets the number of pickup points.
-This function allocates memory and should not be called inside a DSP cycle.
+This function allocates memory when exceeding the pickup capacity, and in that
+case it should not be called inside a DSP cycle. Hosts which resize resonators
+while running should call SDTResonator_reserve() up front, and stay within the
+reserved capacity, as the Pd and Max externals do.
 @param[in] f Number of pickup points */
 extern void SDTResonator_setNPickups(SDTResonator *x, int f);
 
 /** @brief Sets the number of resonant modes.
-This function allocates memory and should not be called inside a DSP cycle.
+This function allocates memory when exceeding the mode capacity, and in that
+case it should not be called inside a DSP cycle. Hosts which resize resonators
+while running should call SDTResonator_reserve() up front, and stay within the
+reserved capacity.
 @param[in] f Number of resonant modes */
 extern void SDTResonator_setNModes(SDTResonator *x, int f);
 
@@ -206,10 +304,45 @@ resonate louder and at higher frequencies, but with shorter decay times.
 @param[in] f Fragment size, compared to the whole object [0,1] */
 extern void SDTResonator_setFragmentSize(SDTResonator *x, double f);
 
+/** @brief Changes the fragment size at audio rate.
+Meant to be called once per sample, as interactors do with their fragment
+size inputs. Small steps interpolate coefficients precomputed at the ends of a
+narrow cell around the current size, so that a smooth sweep recomputes the
+modes only when leaving the cell. Larger jumps and modes starting or stopping
+being simulated are updated exactly, as with SDTResonator_setFragmentSize().
+@param[in] f Fragment size, compared to the whole object [0,1] */
+extern void SDTResonator_modulateFragmentSize(SDTResonator *x, double f);
+
 /** @brief Sets the number of active (actually computed) modes.
 @param[in] i Number of active (computed) modes */
 extern void SDTResonator_setActiveModes(SDTResonator *x, unsigned int i);
 
+/** @brief Sets the sleep threshold.
+When the energy of an oscillating mode falls to or below this threshold, its
+state is cleared and the mode is no longer computed, until a force, a position
+or a velocity is applied to the resonator again. When all modes are asleep, the
+DSP routines return immediately. The energy is checked at the end of each
+block by SDTResonator_dspBlock(), and every 64 samples by SDTResonator_dsp().
+The default value of 0 only puts to sleep modes which are exactly at rest.
+@param[in] f Modal energy below which a mode is put to sleep, in J */
+extern void SDTResonator_setSleepThreshold(SDTResonator *x, double f);
+
+/** @brief Limits the number of computed modes, below the active modes.
+Used by #SDTModalBudget to lower the level of detail of busy scenes. Raising
+the limit takes effect immediately, with the restored modes starting at rest.
+Lowering it fades out the modes beyond the limit in a few milliseconds, and
+stops computing them after 50 ms, to avoid clicks. The number of active modes
+set by the user is not changed, and is restored when the limit is lifted.
+@param[in] i Maximum number of computed modes */
+extern void SDTResonator_setModeLimit(SDTResonator *x, int i);
+
+/** @brief Sets the priority of the resonator when sharing a mode budget.
+#SDTModalBudget weights the energy of each resonator by its priority, to decide
+which resonators lose modes first. Lower the priority of distant or masked
+objects, for example in inverse proportion to the squared distance.
+@param[in] f Priority, non-negative. Defaults to 1 */
+extern void SDTResonator_setPriority(SDTResonator *x, double f);
+
 /** @brief Applies a force to the resonator at a given pickup point.
 The force is distributed across the modes according to their normalized pickup
 gains (modal gain/sum of all gains). If the function is called multiple times in
@@ -227,6 +360,25 @@ forces.
 extern double SDTResonator_computeEnergy(SDTResonator *x, unsigned int pickup,
                                          double f);
 
+/** @brief Computes the total energy of the object as a quadratic function of
+an external force.
+Modal positions and velocities are affine in the applied force, so that the
+value returned by SDTResonator_computeEnergy() can be written as
+c0 + c1 * f + c2 * f^2. The coefficients are computed in a single pass over the
+modes. The quadratic form is exact as long as no modal displacement gets
+clipped, which is checked for all forces up to the given magnitude.
+@param[in] pickup Pickup point
+@param[in] fMax Maximum magnitude of the external force, in N
+@param[out] c0 Constant coefficient, in J
+@param[out] c1 Linear coefficient, in J/N
+@param[out] c2 Quadratic coefficient, in J/N^2
+@return Zero on success, non-zero if the quadratic form is not exact or not
+finite within the given range */
+extern int SDTResonator_computeEnergyCoefficients(SDTResonator *x,
+                                                  unsigned int pickup,
+                                                  double fMax, double *c0,
+                                                  double *c1, double *c2);
+
 /** @brief Signal processing routine.
 Call this function at sample rate to update the internal state of the resonator.
 DO NOT call this function if you plan to use any of the interactor DSP methods
@@ -234,6 +386,422 @@ instead!
 See the SDTInteractors.h module documentation for further information. */
 extern void SDTResonator_dsp(SDTResonator *x);
 
+/** @brief Block signal processing routine.
+Equivalent to calling SDTResonator_applyForce() and SDTResonator_dsp() once per
+sample for n samples, reading back the displacement at every pickup point after
+each update. Forces already accumulated with SDTResonator_applyForce() are
+consumed by the first sample of the block. The inner loops run over the modes,
+which are independent from each other and can be vectorized by the compiler.
+Results match the per-sample routine within floating point rounding of the
+force distribution.
+DO NOT call this function on resonators driven by an interactor.
+@param[in] pickup Pickup point the input forces are applied to
+@param[in] in Input forces, in N, one per sample. Can be NULL for no input
+@param[out] outs Array of nPickups output buffers of n samples, receiving the
+object displacement at each pickup point, in m. Can be NULL, and so can be any
+of its elements, to skip the corresponding outputs
+@param[in] n Number of samples to process */
+extern void SDTResonator_dspBlock(SDTResonator *x, unsigned int pickup,
+                                  const double *in, double **outs,
+                                  unsigned int n);
+
+/** @brief Opaque data structure representing a bank of resonators.
+A bank simulates many copies of the same modal object, such as the fragments of
+a breaking or crumpling scene, sharing frequencies, decays, weights and pickup
+gains but each with its own fragment size and state. Instances are processed in
+groups, interleaving the same mode of several instances in memory, so that the
+compiler can vectorize the modal recursion across instances. Groups at rest are
+put to sleep with the same criterion as single resonators, and skipped until a
+force is applied to one of their instances. */
+typedef struct SDTResonatorBank SDTResonatorBank;
+
+/** @brief Object constructor.
+The modal parameters, active modes, fragment size and sleep threshold of the
+model are copied in the bank. Later changes to the model do not affect it.
+@param[in] model Resonator used as a model for all instances
+@param[in] nInstances Number of instances
+@return Pointer to the new instance */
+extern SDTResonatorBank *SDTResonatorBank_new(const SDTResonator *model,
+                                              unsigned int nInstances);
+
+/** @brief Object destructor.
+@param[in] x Pointer to the instance to destroy */
+extern void SDTResonatorBank_free(SDTResonatorBank *x);
+
+/** @brief Gets the number of instances.
+@return Number of instances */
+extern int SDTResonatorBank_getNInstances(const SDTResonatorBank *x);
+
+/** @brief Gets the number of modes computed for each instance.
+@return Number of active modes of the model */
+extern int SDTResonatorBank_getNModes(const SDTResonatorBank *x);
+
+/** @brief Gets the number of pickup points of each instance.
+@return Number of pickup points */
+extern int SDTResonatorBank_getNPickups(const SDTResonatorBank *x);
+
+/** @brief Gets the fragment size of an instance.
+@param[in] instance Instance number
+@return Fragment size, compared to the whole object [0,1] */
+extern double SDTResonatorBank_getFragmentSize(const SDTResonatorBank *x,
+                                               unsigned int instance);
+
+/** @brief Gets the displacement of an instance at a given pickup point.
+@param[in] instance Instance number
+@param[in] pickup Pickup point
+@return Displacement, in m */
+extern double SDTResonatorBank_getPosition(const SDTResonatorBank *x,
+                                           unsigned int instance,
+                                           unsigned int pickup);
+
+/** @brief Gets the velocity of an instance at a given pickup point.
+@param[in] instance Instance number
+@param[in] pickup Pickup point
+@return Velocity, in m/s */
+extern double SDTResonatorBank_getVelocity(const SDTResonatorBank *x,
+                                           unsigned int instance,
+                                           unsigned int pickup);
+
+/** @brief Sets the fragment size of an instance.
+Works as SDTResonator_setFragmentSize() on a single resonator.
+@param[in] instance Instance number
+@param[in] f Fragment size, compared to the whole object [0,1] */
+extern void SDTResonatorBank_setFragmentSize(SDTResonatorBank *x,
+                                             unsigned int instance, double f);
+
+/** @brief Brings an instance to rest, to reuse it for a new fragment.
+@param[in] instance Instance number */
+extern void SDTResonatorBank_reset(SDTResonatorBank *x, unsigned int instance);
+
+/** @brief Applies a force to an instance at a given pickup point.
+Works as SDTResonator_applyForce() on a single resonator.
+@param[in] instance Instance number
+@param[in] pickup Pickup point
+@param[in] f Applied force, in N */
+extern void SDTResonatorBank_applyForce(SDTResonatorBank *x,
+                                        unsigned int instance,
+                                        unsigned int pickup, double f);
+
+/** @brief Signal processing routine.
+Advances all instances by one sample. Groups are only put to sleep by
+SDTResonatorBank_dspBlock(). */
+extern void SDTResonatorBank_dsp(SDTResonatorBank *x);
+
+/** @brief Block signal processing routine.
+Equivalent to calling SDTResonatorBank_dsp() once per sample for n samples,
+summing the displacement of all instances at a pickup point after each update.
+Forces already applied are consumed by the first sample of the block.
+@param[in] pickup Pickup point read for the output
+@param[out] out Output buffer of n samples, receiving the sum of the
+displacements of all instances, in m. Can be NULL
+@param[in] n Number of samples to process */
+extern void SDTResonatorBank_dspBlock(SDTResonatorBank *x, unsigned int pickup,
+                                      double *out, unsigned int n);
+
+/** @brief Opaque data structure representing a spectral resonator.
+A spectral resonator synthesizes the free response of a modal object in the
+frequency domain, for objects with thousands of modes such as bells, gongs and
+plates. Every hop, the spectrum of each decaying mode is approximated by the
+main lobe of a Blackman-Harris window, added to a frame in a handful of bins,
+and the frame is brought back to the time domain by a single inverse FFT and
+overlap-added to the output. Modal amplitudes are interpolated linearly from
+one hop to the next.
+
+The cost of a mode depends on the hop rate rather than on the sample rate,
+while every frame has the fixed cost of an inverse FFT per pickup point.
+Measured at 44.1 kHz with the default build flags, a mode costs about a
+seventh of a mode of SDTResonator, and the inverse FFT as much as a dozen
+recursive modes. The spectral resonator is therefore faster than the
+recursive one from a few tens of modes per pickup point, and about seven
+times faster with thousands of modes.
+
+The trade-offs are a latency of up to two hops between an applied force and
+the full response, an onset smoothed over one hop, and modes decaying in less
+than a few hops losing accuracy. Inertial modes, with a frequency of 0 Hz, are
+not supported. The object can only be struck with forces, and can't be coupled
+to interactors. Parameters are read from and written to the same JSON
+representation as SDTResonator, so presets are interchangeable.
+*/
+typedef struct SDTSpectralResonator SDTSpectralResonator;
+
+/** @brief Hop size of the spectral resonator, in samples.
+Frames are four hops long. */
+#define SDT_SPECTRAL_RESONATOR_HOPSIZE 128
+
+/** @brief Object constructor.
+@param[in] nModes Number of resonant modes
+@param[in] nPickups Number of pickup points
+@return Pointer to the new instance */
+extern SDTSpectralResonator *SDTSpectralResonator_new(unsigned int nModes,
+                                                      unsigned int nPickups);
+
+/** @brief Object destructor.
+@param[in] x Pointer to the instance to destroy */
+extern void SDTSpectralResonator_free(SDTSpectralResonator *x);
+
+/** @brief Update inner coefficients.
+Call this function whenever you change the SDT sample rate.
+@param[in] x Pointer to the instance to update */
+extern void SDTSpectralResonator_update(SDTSpectralResonator *x);
+
+/** @brief Represent a spectral resonator as a JSON object.
+Keys are the same as in SDTResonator_toJSON().
+@param[in] x Pointer to the instance
+@return JSON object */
+extern json_value *SDTSpectralResonator_toJSON(const SDTSpectralResonator *x);
+
+/** @brief Set parameters of a spectral resonator from a JSON object.
+Keys specific to SDTResonator are ignored.
+@param[in] x Pointer to the instance
+@param[in] j JSON object
+@return Pointer to destination instance */
+extern SDTSpectralResonator *SDTSpectralResonator_setParams(
+    SDTSpectralResonator *x, const json_value *j);
+
+/** @brief Initialize a spectral resonator from a JSON object.
+Accepts the output of SDTResonator_toJSON().
+@param[in] x JSON object
+@return Pointer to the instance */
+extern SDTSpectralResonator *SDTSpectralResonator_fromJSON(
+    const json_value *x);
+
+/** @brief Gets the number of modes.
+@return Number of modes */
+extern int SDTSpectralResonator_getNModes(const SDTSpectralResonator *x);
+
+/** @brief Gets the number of pickup points.
+@return Number of pickup points */
+extern int SDTSpectralResonator_getNPickups(const SDTSpectralResonator *x);
+
+/** @brief Gets the number of active modes.
+@return Number of active (computed) modes */
+extern int SDTSpectralResonator_getActiveModes(const SDTSpectralResonator *x);
+
+/** @brief Gets the hop size.
+@return Hop size, in samples */
+extern int SDTSpectralResonator_getHopSize(const SDTSpectralResonator *x);
+
+/** @brief Gets the resonance frequency of a mode.
+@param[in] mode Mode number
+@return Frequency, in Hz */
+extern double SDTSpectralResonator_getFrequency(const SDTSpectralResonator *x,
+                                                unsigned int mode);
+
+/** @brief Gets the decay time of a mode.
+@param[in] mode Mode number
+@return Decay time, in s */
+extern double SDTSpectralResonator_getDecay(const SDTSpectralResonator *x,
+                                            unsigned int mode);
+
+/** @brief Gets the weight of a mode.
+@param[in] mode Mode number
+@return Mode weight */
+extern double SDTSpectralResonator_getWeight(const SDTSpectralResonator *x,
+                                             unsigned int mode);
+
+/** @brief Gets the gain of a mode at a given pickup point.
+@param[in] pickup Pickup number
+@param[in] mode Mode number
+@return Pickup gain */
+extern double SDTSpectralResonator_getGain(const SDTSpectralResonator *x,
+                                           unsigned int pickup,
+                                           unsigned int mode);
+
+/** @brief Gets the fragment size.
+@return Fragment size, compared to the whole object [0,1] */
+extern double SDTSpectralResonator_getFragmentSize(
+    const SDTSpectralResonator *x);
+
+/** @brief Sets the resonance frequency of a mode.
+@param[in] mode Mode number
+@param[in] f Frequency, in Hz */
+extern void SDTSpectralResonator_setFrequency(SDTSpectralResonator *x,
+                                              unsigned int mode, double f);
+
+/** @brief Sets the decay time of a mode.
+@param[in] mode Mode number
+@param[in] f Decay time, in s */
+extern void SDTSpectralResonator_setDecay(SDTSpectralResonator *x,
+                                          unsigned int mode, double f);
+
+/** @brief Sets the weight of a mode.
+@param[in] mode Mode number
+@param[in] f Mode weight */
+extern void SDTSpectralResonator_setWeight(SDTSpectralResonator *x,
+                                           unsigned int mode, double f);
+
+/** @brief Sets the gain of a mode at a given pickup point.
+@param[in] pickup Pickup number
+@param[in] mode Mode number
+@param[in] f Pickup gain */
+extern void SDTSpectralResonator_setGain(SDTSpectralResonator *x,
+                                         unsigned int pickup,
+                                         unsigned int mode, double f);
+
+/** @brief Reduces the object into a smaller fragment.
+Works as SDTResonator_setFragmentSize().
+@param[in] f Fragment size, compared to the whole object [0,1] */
+extern void SDTSpectralResonator_setFragmentSize(SDTSpectralResonator *x,
+                                                 double f);
+
+/** @brief Sets the number of active (actually computed) modes.
+@param[in] i Number of active (computed) modes */
+extern void SDTSpectralResonator_setActiveModes(SDTSpectralResonator *x,
+                                                unsigned int i);
+
+/** @brief Applies an impulsive force to the object at a given pickup point.
+The force is distributed across the modes as in SDTResonator_applyForce(), and
+acts before the next output sample. Each call costs a few transcendental
+functions per mode, so the object is meant to be struck, not driven by a
+continuous force signal.
+@param[in] pickup Pickup point
+@param[in] f Applied force, in N */
+extern void SDTSpectralResonator_applyForce(SDTSpectralResonator *x,
+                                            unsigned int pickup, double f);
+
+/** @brief Block signal processing routine.
+Produces the next n samples of the object displacement at every pickup point.
+Blocks can have any size, frames are computed whenever a hop boundary is
+crossed.
+@param[out] outs Array of nPickups output buffers of n samples, receiving the
+object displacement at each pickup point, in m. Can be NULL, and so can be any
+of its elements, to skip the corresponding outputs
+@param[in] n Number of samples to process */
+extern void SDTSpectralResonator_dspBlock(SDTSpectralResonator *x,
+                                          double **outs, unsigned int n);
+
+/** @brief Opaque data structure representing a mode budget manager.
+A mode budget manager shares a maximum number of computed modes among all the
+registered resonators, lowering their level of detail when a scene gets busy.
+Resonators whose modes are all asleep cost nothing and are not restricted.
+Awake resonators are ranked by their modal energy, weighted by their priority:
+each keeps a minimum number of modes, and the rest of the budget is given to
+the highest ranked resonators first. Modes beyond a resonator's share are
+faded out, and are restored as soon as the budget allows.
+
+The budget can also follow a CPU load target. In that case, the host reports
+the measured DSP load before each update, and the budget is scaled by the
+ratio between target and measured load. It shrinks at once when the load is
+too high, and grows back by at most 10% per update, up to the maximum.
+
+Call SDTModalBudget_update() at control rate, for example once per audio
+block, from the thread running the resonators. It does not allocate memory:
+every budget keeps room for all the registered resonators, and grows it in
+SDTModalBudget_new() and SDT_registerResonator().
+*/
+typedef struct SDTModalBudget SDTModalBudget;
+
+#define SDT_MODALBUDGET_MAXMODES_DEFAULT 1024
+#define SDT_MODALBUDGET_MINMODES_DEFAULT 4
+
+/** @brief Object constructor.
+@return Pointer to the new instance */
+extern SDTModalBudget *SDTModalBudget_new();
+
+/** @brief Object destructor.
+@param[in] x Pointer to the instance to destroy */
+extern void SDTModalBudget_free(SDTModalBudget *x);
+
+/** @brief Deep-copies a mode budget manager.
+@param[in] dest Pointer to the instance to modify
+@param[in] src Pointer to the instance to copy
+@param[in] unsafe If false, do not perform any memory-related changes
+@return Pointer to destination instance */
+extern SDTModalBudget *SDTModalBudget_copy(SDTModalBudget *dest,
+                                           const SDTModalBudget *src,
+                                           unsigned char unsafe);
+
+/** @brief Registers a mode budget manager into the managers list with a unique
+ID.
+@param[in] x Mode budget manager instance to register
+@param[in] key Unique ID assigned to the instance
+@return Zero on success, otherwise one */
+extern int SDT_registerModalBudget(SDTModalBudget *x, const char *key);
+
+/** @brief Queries the mode budget managers list by its unique ID.
+If a manager with the given ID is found, a pointer to it is returned.
+@param[in] key Unique ID of the instance to query
+@return Instance pointer */
+extern SDTModalBudget *SDT_getModalBudget(const char *key);
+
+/** @brief Unregisters a mode budget manager from the managers list.
+@param[in] key Unique ID of the instance to unregister
+@return Zero on success, otherwise one */
+extern int SDT_unregisterModalBudget(const char *key);
+
+/** @brief Represent a mode budget manager as a JSON object.
+Besides the parameters, the object reports the current budget, the used and
+requested modes and the budget usage, which are ignored when loading.
+@param[in] x Pointer to the instance
+@return JSON object */
+extern json_value *SDTModalBudget_toJSON(const SDTModalBudget *x);
+
+/** @brief Initialize a mode budget manager from a JSON object.
+@param[in] x JSON object
+@return Pointer to the instance */
+extern SDTModalBudget *SDTModalBudget_fromJSON(const json_value *x);
+
+/** @brief Set parameters of a mode budget manager from a JSON object.
+@param[in] x Pointer to the instance
+@param[in] j JSON object
+@param[in] unsafe If false, do not perform any memory-related changes
+@return Pointer to destination instance */
+extern SDTModalBudget *SDTModalBudget_setParams(SDTModalBudget *x,
+                                                const json_value *j,
+                                                unsigned char unsafe);
+
+/** @brief Gets the maximum number of computed modes.
+@return Maximum number of modes, over all resonators */
+extern int SDTModalBudget_getMaxModes(const SDTModalBudget *x);
+
+/** @brief Gets the minimum number of modes of each awake resonator.
+@return Minimum number of modes */
+extern int SDTModalBudget_getMinModes(const SDTModalBudget *x);
+
+/** @brief Gets the CPU load target.
+@return Target DSP load [0,1], 0 if disabled */
+extern double SDTModalBudget_getTargetLoad(const SDTModalBudget *x);
+
+/** @brief Gets the last reported CPU load.
+@return Measured DSP load */
+extern double SDTModalBudget_getLoad(const SDTModalBudget *x);
+
+/** @brief Gets the current mode budget.
+@return Number of modes that can be computed */
+extern int SDTModalBudget_getBudget(const SDTModalBudget *x);
+
+/** @brief Gets the number of modes computed after the last update.
+@return Number of modes allowed to awake resonators */
+extern int SDTModalBudget_getUsedModes(const SDTModalBudget *x);
+
+/** @brief Gets the number of modes requested at the last update.
+@return Number of active modes of awake resonators */
+extern int SDTModalBudget_getRequestedModes(const SDTModalBudget *x);
+
+/** @brief Gets the budget usage.
+@return Ratio between used modes and budget */
+extern double SDTModalBudget_getUsage(const SDTModalBudget *x);
+
+/** @brief Sets the maximum number of computed modes.
+@param[in] i Maximum number of modes, over all resonators */
+extern void SDTModalBudget_setMaxModes(SDTModalBudget *x, int i);
+
+/** @brief Sets the minimum number of modes of each awake resonator.
+@param[in] i Minimum number of modes */
+extern void SDTModalBudget_setMinModes(SDTModalBudget *x, int i);
+
+/** @brief Sets the CPU load target.
+@param[in] f Target DSP load [0,1], as a fraction of the block duration.
+0 disables CPU control, and the budget is the maximum number of modes */
+extern void SDTModalBudget_setTargetLoad(SDTModalBudget *x, double f);
+
+/** @brief Reports the measured CPU load.
+@param[in] f Measured DSP load, as a fraction of the block duration */
+extern void SDTModalBudget_setLoad(SDTModalBudget *x, double f);
+
+/** @brief Shares the budget among the registered resonators. */
+extern void SDTModalBudget_update(SDTModalBudget *x);
+
 /** @} */
 
 #ifdef __cplusplus
@@ -109,3 +109,15 @@ int SDTHashmap_empty(const SDTHashmap *x) {
     if (x->bins[i]) return 0;
   return 1;
 }
+
+void SDTHashmap_forEach(const SDTHashmap *x,
+                        void (*f)(const char *key, void *value, void *data),
+                        void *data) {
+  SDTHashItem *item;
+
+  for (int i = 0; i < x->size; i++) {
+    for (item = x->bins[i]; item; item = item->next) {
+      f(item->key, item->value, data);
+    }
+  }
+}
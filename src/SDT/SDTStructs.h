@@ -43,6 +43,15 @@ extern void SDTHashmap_clear(SDTHashmap *x);
 /** @brief Returns 1 if the hashmap is empty, otherwise 0. */
 extern int SDTHashmap_empty(const SDTHashmap *x);
 
+/** @brief Calls a function on every key/value pair in the hashmap.
+The hashmap should not be modified by the called function.
+@param[in] f Function to call, receiving the key, the value and the user data
+@param[in] data User data, passed on to the function */
+extern void SDTHashmap_forEach(const SDTHashmap *x,
+                               void (*f)(const char *key, void *value,
+                                         void *data),
+                               void *data);
+
 /** --- Macros ------------------------------------------------------------- */
 #define SDT_HASHMAP_SIZE_DEFAULT 59
 
@@ -246,6 +246,28 @@ void TestSDT_gaussian1D(CuTest *tc) {
   SDT_TEST_END()
 }
 
+void TestSDT_geomRand(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  unsigned int size = 1 << 18;
+  long k;
+  double m;
+  SDTRandomSequence *x = SDTRandomSequence_newLog(4, 0.001, 0.5);
+  CuAssertIntEquals_Msg(tc, "Check certain", 0, SDT_geomRand(1.0));
+  CuAssertIntEquals_Msg(tc, "Check impossible", -1, SDT_geomRand(0.0));
+  FOR_RANDOM_ITER_FLOAT (x, p) {
+    m = 0.0;
+    for (unsigned int i = 0; i < size; ++i) {
+      k = SDT_geomRand(p);
+      CuAssert(tc, "Check non-negative", k >= 0);
+      m += ((double)k) / size;
+    }
+    CuAssertDblEquals_Msg(tc, "Check average", (1.0 - p) / p, m,
+                          0.05 / p);
+  }
+  SDTRandomSequence_free(x);
+  SDT_TEST_END()
+}
+
 void TestSDT_gravity(CuTest *tc) {
   SDT_TEST_BEGIN()
   SDTRandomSequence *x = SDTRandomSequence_newExp(1024, 0, 0.1);
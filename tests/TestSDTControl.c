@@ -0,0 +1,166 @@
+/**
+ * @file TestSDTControl.c
+ * @brief Test SDT/SDTControl.h
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ */
+#include <math.h>
+#include <stdio.h>
+
+#include "CuTest.h"
+#include "SDT/SDTControl.h"
+#include "SDTTestUtils.h"
+
+#define TEST_CONTROL_NMODES 8
+#define TEST_CONTROL_LENGTH 8820
+
+static SDTResonator *_TestHelper_newHammer() {
+  SDTResonator *x = SDTResonator_new(1, 1);
+  SDTResonator_setFragmentSize(x, 1.0);
+  SDTResonator_setWeight(x, 0, 0.01);
+  SDTResonator_setGain(x, 0, 0, 1.0);
+  SDTResonator_setActiveModes(x, 1);
+  return x;
+}
+
+static SDTResonator *_TestHelper_newPlate() {
+  SDTResonator *x = SDTResonator_new(TEST_CONTROL_NMODES, 1);
+  unsigned int mode;
+
+  SDTResonator_setFragmentSize(x, 1.0);
+  for (mode = 0; mode < TEST_CONTROL_NMODES; ++mode) {
+    SDTResonator_setFrequency(x, mode, 500.0 * (mode + 1) * (1.0 + 0.1 * mode));
+    SDTResonator_setDecay(x, mode, 0.03 / (mode + 1));
+    SDTResonator_setWeight(x, mode, 1.0);
+    SDTResonator_setGain(x, 0, mode, 100.0);
+  }
+  SDTResonator_setActiveModes(x, TEST_CONTROL_NMODES);
+  return x;
+}
+
+static SDTInteractor *_TestHelper_newImpact(SDTResonator *obj0,
+                                            SDTResonator *obj1) {
+  SDTInteractor *x = SDTImpact_new();
+  SDTImpact_setStiffness(x, 1e7);
+  SDTImpact_setDissipation(x, 0.001);
+  SDTImpact_setShape(x, 1.5);
+  SDTInteractor_setFirstResonator(x, obj0);
+  SDTInteractor_setSecondResonator(x, obj1);
+  return x;
+}
+
+/* Checks a grain against the simulation of the same impact, driven like the
+   grain cache drives its private copy */
+static void _TestHelper_checkGrain(CuTest *tc, SDTGrainCache *x,
+                                   SDTInteractor *impact, double energy,
+                                   double size) {
+  SDTResonator *hammer = _TestHelper_newHammer();
+  SDTResonator *plate = SDTResonator_new(TEST_CONTROL_NMODES, 1);
+  SDTInteractor *y = SDTImpact_new();
+  double ins[2], outs[2], y0, y1, peak, err;
+  unsigned int i;
+
+  SDTResonator_copy(plate, SDTInteractor_getSecondResonator(impact), 0);
+  SDTResonator_update(plate);
+  SDTInteractor_copy(y, impact, 0);
+  SDTInteractor_setFirstResonator(y, hammer);
+  SDTInteractor_setSecondResonator(y, plate);
+  peak = 0.0;
+  err = 0.0;
+  for (i = 0; i < TEST_CONTROL_LENGTH; ++i) {
+    ins[0] = i ? 0.0 : energy;
+    ins[1] = size;
+    y0 = SDTGrainCache_dsp(x, ins);
+    SDTInteractor_dsp(y, -ins[0], 0.0, i ? 0.0 : size, 0.0, 0.0,
+                      i ? 0.0 : size, outs);
+    y1 = outs[1];
+    peak = fmax(peak, fabs(y1));
+    err = fmax(err, fabs(y0 - y1));
+  }
+  CuAssert(tc, "Check the plate has been hit", peak > 0.0);
+  CuAssertDblEquals_Msg(tc, "Check grain", 0.0, err, 1e-3 * peak);
+  CuAssertIntEquals_Msg(tc, "Check grain has ended", 0,
+                        SDTGrainCache_getActiveVoices(x));
+  SDTImpact_free(y);
+  SDTResonator_free(hammer);
+  SDTResonator_free(plate);
+}
+
+void TestSDTGrainCache_dsp(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTResonator *hammer = _TestHelper_newHammer();
+  SDTResonator *plate = _TestHelper_newPlate();
+  SDTInteractor *impact = _TestHelper_newImpact(hammer, plate);
+  SDTGrainCache *x = SDTGrainCache_new(4);
+
+  SDTGrainCache_setImpact(x, impact);
+  SDTGrainCache_setOutput(x, 1);
+  SDTGrainCache_setDuration(x, 0.2);
+  SDTGrainCache_setMinEnergy(x, 0.5);
+  SDTGrainCache_setMaxEnergy(x, 8.0);
+  SDTGrainCache_setEnergyLevels(x, 5);
+  SDTGrainCache_setSizeLevels(x, 4);
+  // Events on the grid are rendered exactly
+  _TestHelper_checkGrain(tc, x, impact, 2.0, 0.5);
+  _TestHelper_checkGrain(tc, x, impact, 8.0, 1.0);
+  // Parameter changes invalidate the grains
+  SDTResonator_setFrequency(plate, 0, 350.0);
+  SDTResonator_update(plate);
+  _TestHelper_checkGrain(tc, x, impact, 2.0, 0.5);
+  SDTImpact_setStiffness(impact, 1e8);
+  _TestHelper_checkGrain(tc, x, impact, 2.0, 0.5);
+  // Exciting the resonators keeps the grains, and the playing voices
+  SDTGrainCache_trigger(x, 2.0, 0.5);
+  SDTResonator_applyForce(plate, 0, 1.0);
+  SDTResonator_dsp(plate);
+  SDTGrainCache_trigger(x, 2.0, 0.5);
+  CuAssertIntEquals(tc, 2, SDTGrainCache_getActiveVoices(x));
+  SDTGrainCache_free(x);
+  SDTImpact_free(impact);
+  SDTResonator_free(hammer);
+  SDTResonator_free(plate);
+  SDT_TEST_END()
+}
+
+void TestSDTGrainCache_dspBlock(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTResonator *hammer = _TestHelper_newHammer();
+  SDTResonator *plate = _TestHelper_newPlate();
+  SDTInteractor *impact = _TestHelper_newImpact(hammer, plate);
+  SDTGrainCache *x = SDTGrainCache_new(8);
+  SDTGrainCache *y = SDTGrainCache_new(8);
+  SDTCrumpling *c = SDTCrumpling_new();
+  double energy[TEST_CONTROL_LENGTH], size[TEST_CONTROL_LENGTH],
+      out[TEST_CONTROL_LENGTH], ins[2];
+  unsigned int i;
+
+  SDTCrumpling_setCrushingEnergy(c, 1.0);
+  SDTCrumpling_setGranularity(c, 0.005);
+  SDTCrumpling_setFragmentation(c, 0.5);
+  for (i = 0; i < TEST_CONTROL_LENGTH; ++i) {
+    SDTCrumpling_dsp(c, ins);
+    energy[i] = ins[0];
+    size[i] = ins[1];
+  }
+  SDTGrainCache_setImpact(x, impact);
+  SDTGrainCache_setOutput(x, 1);
+  SDTGrainCache_setImpact(y, impact);
+  SDTGrainCache_setOutput(y, 1);
+  SDTGrainCache_dspBlock(x, energy, size, out, TEST_CONTROL_LENGTH);
+  for (i = 0; i < TEST_CONTROL_LENGTH; ++i) {
+    ins[0] = energy[i];
+    ins[1] = size[i];
+    CuAssertDblEquals_Msg(tc, "Check block", SDTGrainCache_dsp(y, ins),
+                          out[i], 1e-12);
+  }
+  SDTCrumpling_free(c);
+  SDTGrainCache_free(x);
+  SDTGrainCache_free(y);
+  SDTImpact_free(impact);
+  SDTResonator_free(hammer);
+  SDTResonator_free(plate);
+  SDT_TEST_END()
+}
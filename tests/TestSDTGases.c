@@ -0,0 +1,110 @@
+/**
+ * @file TestSDTGases.c
+ * @brief Test SDT/SDTGases.h
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ */
+#include <math.h>
+#include <stdio.h>
+
+#include "CuTest.h"
+#include "SDT/SDTGases.h"
+#include "SDTTestUtils.h"
+
+#define TEST_GASES_LENGTH 22050
+
+void TestSDTExplosion_dsp(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTExplosion *x0 = SDTExplosion_new(4410, 200000);
+  SDTExplosion *x1 = SDTExplosion_new(4410, 200000);
+  double near[TEST_GASES_LENGTH], far[TEST_GASES_LENGTH], outs[2], peak, error;
+  long i, delay0, delay1;
+
+  // Same shockwave, reaching the listener after about 0.003 s and 2.3 s
+  SDTExplosion_setBlastTime(x0, 0.02);
+  SDTExplosion_setDispersion(x0, 0.0);
+  SDTExplosion_setDistance(x0, 1.0);
+  SDTExplosion_setWaveSpeed(x0, 340.0);
+  SDTExplosion_setWindSpeed(x0, 340.0);
+  SDTExplosion_copy(x1, x0, 0);
+  SDTExplosion_setWaveSpeed(x1, 0.441);
+  delay0 = (long)(44100.0 / 340.0);
+  delay1 = (long)(44100.0 / 0.441);
+  SDTExplosion_trigger(x0);
+  SDTExplosion_trigger(x1);
+  for (i = 0; i < delay1 + TEST_GASES_LENGTH; ++i) {
+    SDTExplosion_dsp(x0, outs);
+    if (i >= delay0 && i < delay0 + TEST_GASES_LENGTH) {
+      near[i - delay0] = outs[0];
+    }
+    SDTExplosion_dsp(x1, outs);
+    if (i < delay1) CuAssertDblEquals(tc, 0.0, outs[0], 0.0);
+    if (i >= delay1) far[i - delay1] = outs[0];
+  }
+  peak = 0.0;
+  error = 0.0;
+  for (i = 0; i < TEST_GASES_LENGTH; ++i) {
+    peak = fmax(peak, fabs(near[i]));
+    error = fmax(error, fabs(far[i] - near[i]));
+  }
+  CuAssert(tc, "Check the shockwave arrives", peak > 0.0);
+  CuAssert(tc, "Check the delay", error <= 1e-9 * peak);
+
+  SDTExplosion_free(x0);
+  SDTExplosion_free(x1);
+  SDT_TEST_END()
+}
+
+void TestSDTExplosionCache_dspBlock(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTExplosion *x0 = SDTExplosion_new(4410, 44100);
+  SDTExplosionCache *x1 = SDTExplosionCache_new(2);
+  double expected[TEST_GASES_LENGTH], wave[TEST_GASES_LENGTH],
+      wind[TEST_GASES_LENGTH], outs[2], peak, error;
+  unsigned int i;
+
+  // Without scattering, the shockwave is deterministic
+  SDTExplosion_setBlastTime(x0, 0.02);
+  SDTExplosion_setScatterTime(x0, 0.1);
+  SDTExplosion_setDispersion(x0, 0.0);
+  SDTExplosion_setDistance(x0, 50.0);
+  SDTExplosion_setWaveSpeed(x0, 340.0);
+  SDTExplosion_setWindSpeed(x0, 100.0);
+  SDTExplosionCache_setExplosion(x1, x0);
+  SDTExplosionCache_render(x1);
+  CuAssert(tc, "Check the source is rendered",
+           SDTExplosionCache_getLength(x1) > 0);
+
+  SDTExplosion_trigger(x0);
+  for (i = 0; i < TEST_GASES_LENGTH; ++i) {
+    SDTExplosion_dsp(x0, outs);
+    expected[i] = outs[0];
+  }
+  SDTExplosionCache_trigger(x1, 50.0, 1.0);
+  for (i = 0; i < TEST_GASES_LENGTH; i += 100) {
+    SDTExplosionCache_dspBlock(
+        x1, wave + i, wind + i,
+        i + 100 > TEST_GASES_LENGTH ? TEST_GASES_LENGTH - i : 100);
+  }
+  peak = 0.0;
+  error = 0.0;
+  for (i = 0; i < TEST_GASES_LENGTH; ++i) {
+    peak = fmax(peak, fabs(expected[i]));
+    error = fmax(error, fabs(wave[i] - expected[i]));
+  }
+  CuAssert(tc, "Check the shockwave arrives", peak > 0.0);
+  CuAssert(tc, "Check accuracy", error <= 1e-3 * peak);
+  // The shockwave is delayed by the distance
+  CuAssertDblEquals(tc, 0.0, wave[(int)(50.0 * 44100.0 / 340.0) - 1], 0.0);
+
+  // Finished explosions release their voice
+  SDTExplosionCache_dspBlock(x1, wave, wind, TEST_GASES_LENGTH);
+  CuAssertIntEquals(tc, 0, SDTExplosionCache_getActiveVoices(x1));
+
+  SDTExplosionCache_free(x1);
+  SDTExplosion_free(x0);
+  SDT_TEST_END()
+}
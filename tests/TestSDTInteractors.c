@@ -0,0 +1,507 @@
+/**
+ * @file TestSDTInteractors.c
+ * @brief Test SDT/SDTInteractors.h
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ */
+#include <math.h>
+#include <stdio.h>
+
+#include "CuTest.h"
+#include "SDT/SDTInteractors.h"
+#include "SDTTestUtils.h"
+
+#define TEST_INTERACTOR_NMODES 16
+#define TEST_INTERACTOR_NISLANDS 4
+#define TEST_INTERACTOR_BLOCKSIZE 64
+
+static SDTResonator *_TestHelper_newHammer() {
+  SDTResonator *x = SDTResonator_new(1, 1);
+  SDTResonator_setFragmentSize(x, 1.0);
+  SDTResonator_setWeight(x, 0, 0.01);
+  SDTResonator_setGain(x, 0, 0, 1.0);
+  SDTResonator_setActiveModes(x, 1);
+  return x;
+}
+
+static SDTResonator *_TestHelper_newPlate() {
+  SDTResonator *x = SDTResonator_new(TEST_INTERACTOR_NMODES, 1);
+  unsigned int mode;
+
+  SDTResonator_setFragmentSize(x, 1.0);
+  for (mode = 0; mode < TEST_INTERACTOR_NMODES; ++mode) {
+    SDTResonator_setFrequency(x, mode, 180.0 * (mode + 1) * (1.0 + 0.1 * mode));
+    SDTResonator_setDecay(x, mode, 0.3 / (mode + 1));
+    SDTResonator_setWeight(x, mode, 0.05);
+    SDTResonator_setGain(x, 0, mode, 80.0 / (mode + 1));
+  }
+  SDTResonator_setActiveModes(x, TEST_INTERACTOR_NMODES);
+  return x;
+}
+
+void TestSDTInteractor_computeForce(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTResonator *hammer = _TestHelper_newHammer();
+  SDTResonator *plate = _TestHelper_newPlate();
+  SDTInteractor *x = SDTImpact_new();
+  double outs[2], f, e0, e1, slack, peak;
+  unsigned int i;
+
+  SDTImpact_setStiffness(x, 1e8);
+  SDTImpact_setDissipation(x, 0.8);
+  SDTImpact_setShape(x, 1.5);
+  SDTInteractor_setFirstResonator(x, hammer);
+  SDTInteractor_setSecondResonator(x, plate);
+  SDTInteractor_dsp(x, 0.0, -2.0, 0.0, 0.0, 0.0, 0.0, outs);
+  slack = 0.0;
+  peak = 0.0;
+  for (i = 0; i < 4410; ++i) {
+    /* The correction never lets the interaction add energy to the system,
+       except for what was previously dissipated during the same contact */
+    e0 = SDTResonator_computeEnergy(hammer, 0, 0.0) +
+         SDTResonator_computeEnergy(plate, 0, 0.0);
+    f = SDTInteractor_computeForce(x);
+    e1 = SDTResonator_computeEnergy(hammer, 0, f) +
+         SDTResonator_computeEnergy(plate, 0, -f);
+    CuAssert(tc, "Check energy does not increase",
+             e1 <= (e0 + slack) * (1.0 + 1e-9));
+    slack = (f == 0.0) ? 0.0 : e0 + slack - e1;
+    SDTResonator_applyForce(hammer, 0, f);
+    SDTResonator_applyForce(plate, 0, -f);
+    SDTResonator_dsp(hammer);
+    SDTResonator_dsp(plate);
+    peak = fmax(peak, fabs(SDTResonator_getPosition(plate, 0)));
+  }
+  CuAssert(tc, "Check the plate has been hit", peak > 0.0);
+  CuAssertIntEquals_Msg(tc, "Check closed-form solution is used", 0,
+                        SDTInteractor_getFallbacks(x));
+
+  // Clipped displacements can't be solved in closed form
+  SDTResonator_setPosition(hammer, 0, -15000.0);
+  SDTResonator_setPosition(plate, 0, 0.0);
+  SDTInteractor_computeForce(x);
+  CuAssertIntEquals_Msg(tc, "Check fallback to iterative solution", 1,
+                        SDTInteractor_getFallbacks(x));
+
+  SDTImpact_free(x);
+  SDTResonator_free(hammer);
+  SDTResonator_free(plate);
+  SDT_TEST_END()
+}
+
+void TestSDTInteractor_sleep(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTResonator *hammer = _TestHelper_newHammer();
+  SDTResonator *plate = _TestHelper_newPlate();
+  SDTResonator *refHammer = _TestHelper_newHammer();
+  SDTResonator *refPlate = _TestHelper_newPlate();
+  SDTInteractor *x = SDTImpact_new();
+  SDTInteractor *ref = SDTImpact_new();
+  SDTInteractor *xs[2] = {x, ref};
+  double outs[2], f, lo, hi;
+  unsigned int i, k, slept;
+
+  for (k = 0; k < 2; ++k) {
+    SDTImpact_setStiffness(xs[k], 1e8);
+    SDTImpact_setDissipation(xs[k], 0.8);
+    SDTImpact_setShape(xs[k], 1.5);
+  }
+  SDTResonator_setSleepThreshold(plate, 1e-12);
+  SDTResonator_setSleepThreshold(refPlate, 1e-12);
+  SDTInteractor_setFirstResonator(x, hammer);
+  SDTInteractor_setSecondResonator(x, plate);
+  SDTInteractor_setFirstResonator(ref, refHammer);
+  SDTInteractor_setSecondResonator(ref, refPlate);
+  SDTResonator_setVelocity(refHammer, 0, -2.0);
+
+  // Sleeping does not change the output of the interaction
+  SDTInteractor_dsp(x, 0.0, -2.0, 0.0, 0.0, 0.0, 0.0, outs);
+  slept = 0;
+  lo = 0.0;
+  hi = 0.0;
+  for (i = 0; i < 44100; ++i) {
+    if (i) SDTInteractor_dsp(x, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, outs);
+    f = SDTInteractor_computeForce(ref);
+    SDTResonator_applyForce(refHammer, 0, f);
+    SDTResonator_applyForce(refPlate, 0, -f);
+    SDTResonator_dsp(refHammer);
+    SDTResonator_dsp(refPlate);
+    CuAssertDblEquals(tc, SDTResonator_getPosition(refHammer, 0), outs[0], 0.0);
+    CuAssertDblEquals(tc, SDTResonator_getPosition(refPlate, 0), outs[1], 0.0);
+    if (SDTInteractor_isAsleep(x) && !slept) {
+      slept = i;
+      SDTResonator_getPositionBounds(plate, 0, &lo, &hi);
+      CuAssert(tc, "Check the plate keeps ringing after the interactor sleeps",
+               SDTResonator_getAwakeModes(plate) > 0);
+    }
+    if (slept) {
+      CuAssert(tc, "Check the displacement stays within its bounds",
+               outs[1] >= lo && outs[1] <= hi);
+    }
+  }
+  CuAssert(tc, "Check the interactor falls asleep", slept > 0);
+  CuAssertIntEquals_Msg(tc, "Check the plate falls asleep", 0,
+                        SDTResonator_getAwakeModes(plate));
+  CuAssertDblEquals(tc, 0.0, outs[1], 0.0);
+
+  // A new strike wakes the interactor up
+  SDTInteractor_dsp(x, 0.0, -2.0, 0.0, 0.0, 0.0, 0.0, outs);
+  CuAssertIntEquals(tc, 0, SDTInteractor_isAsleep(x));
+  for (i = 0; i < 441; ++i) {
+    SDTInteractor_dsp(x, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, outs);
+  }
+  CuAssert(tc, "Check the plate has been hit again",
+           SDTResonator_getAwakeModes(plate) > 0);
+
+  SDTImpact_free(x);
+  SDTImpact_free(ref);
+  SDTResonator_free(hammer);
+  SDTResonator_free(plate);
+  SDTResonator_free(refHammer);
+  SDTResonator_free(refPlate);
+  SDT_TEST_END()
+}
+
+void TestSDTInteractor_dspBlock(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTResonator *hammers[2] = {_TestHelper_newHammer(),
+                              _TestHelper_newHammer()};
+  SDTResonator *plates[2] = {_TestHelper_newPlate(), _TestHelper_newPlate()};
+  SDTInteractor *xs[2] = {SDTImpact_new(), SDTImpact_new()};
+  double strikes[TEST_INTERACTOR_BLOCKSIZE], expected[2];
+  double buf[2][TEST_INTERACTOR_BLOCKSIZE], *outs[2] = {buf[0], buf[1]};
+  const double *ins[6] = {NULL, strikes, NULL, NULL, NULL, NULL};
+  unsigned int block, i, k, slept;
+
+  for (k = 0; k < 2; ++k) {
+    SDTImpact_setStiffness(xs[k], 1e8);
+    SDTImpact_setDissipation(xs[k], 0.8);
+    SDTImpact_setShape(xs[k], 1.5);
+    SDTInteractor_setFirstResonator(xs[k], hammers[k]);
+    SDTInteractor_setSecondResonator(xs[k], plates[k]);
+  }
+
+  // Sparse strikes, in the middle of a block
+  slept = 0;
+  for (block = 0; block < 2048; ++block) {
+    for (i = 0; i < TEST_INTERACTOR_BLOCKSIZE; ++i) {
+      strikes[i] = (block % 512 == 0 && i == 17) ? -1.0 - block / 512 : 0.0;
+    }
+    SDTInteractor_dspBlock(xs[1], ins, outs, TEST_INTERACTOR_BLOCKSIZE);
+    for (i = 0; i < TEST_INTERACTOR_BLOCKSIZE; ++i) {
+      SDTInteractor_dsp(xs[0], 0.0, strikes[i], 0.0, 0.0, 0.0, 0.0, expected);
+      CuAssertDblEquals(tc, expected[0], buf[0][i], 0.0);
+      CuAssertDblEquals(tc, expected[1], buf[1][i], 0.0);
+    }
+    CuAssertIntEquals(tc, SDTInteractor_isAsleep(xs[0]),
+                      SDTInteractor_isAsleep(xs[1]));
+    slept += SDTInteractor_isAsleep(xs[1]);
+  }
+  CuAssert(tc, "Check the interactor has slept", slept > 0);
+  CuAssert(tc, "Check the plate has been hit", buf[1][0] != 0.0);
+
+  for (k = 0; k < 2; ++k) {
+    SDTImpact_free(xs[k]);
+    SDTResonator_free(hammers[k]);
+    SDTResonator_free(plates[k]);
+  }
+  SDT_TEST_END()
+}
+
+// Slides a hammer on a plate with a constant force, returns its final velocity
+static double _TestHelper_rub(double sampleRate, double *peak) {
+  SDT_setSampleRate(sampleRate);
+  SDTResonator *rubber = _TestHelper_newHammer();
+  SDTResonator *plate = _TestHelper_newPlate();
+  SDTInteractor *x = SDTFriction_new();
+  double outs[2], v;
+  unsigned int i;
+
+  SDTFriction_setNormalForce(x, 1.0);
+  SDTFriction_setStiffness(x, 1e6);
+  SDTFriction_setDissipation(x, 40.0);
+  SDTFriction_setViscosity(x, 1.0);
+  SDTFriction_setNoisiness(x, 0.0);
+  SDTInteractor_setFirstResonator(x, rubber);
+  SDTInteractor_setSecondResonator(x, plate);
+  *peak = 0.0;
+  for (i = 0; i < 0.5 * sampleRate; ++i) {
+    SDTInteractor_dsp(x, 1.0, 0.0, 0.0, 0.0, 0.0, 0.0, outs);
+    *peak = fmax(*peak, fabs(outs[1]));
+  }
+  v = SDTResonator_getVelocity(rubber, 0);
+  SDTFriction_free(x);
+  SDTResonator_free(rubber);
+  SDTResonator_free(plate);
+  return v;
+}
+
+void TestSDTFriction_stiffness(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  double v0, v1, peak0, peak1;
+
+  // Stiff bristles behave at 44.1 kHz as they do at twice the rate
+  v0 = _TestHelper_rub(44100.0, &peak0);
+  v1 = _TestHelper_rub(88200.0, &peak1);
+  CuAssert(tc, "Check the rubber slides", v1 > 0.1);
+  CuAssertDblEquals(tc, v1, v0, 0.05 * v1);
+  CuAssertDblEquals(tc, peak1, peak0, 0.2 * peak1);
+  SDT_setSampleRate(44100.0);
+  SDT_TEST_END()
+}
+
+void TestSDTFriction_setSeed(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTResonator *rubbers[4], *plates[4];
+  SDTInteractor *xs[4];
+  double outs[4][2];
+  unsigned int i, k, same;
+
+  for (k = 0; k < 4; ++k) {
+    rubbers[k] = _TestHelper_newHammer();
+    plates[k] = _TestHelper_newPlate();
+    xs[k] = SDTFriction_new();
+    SDTFriction_setNormalForce(xs[k], 1.0);
+    SDTFriction_setStiffness(xs[k], 1e6);
+    SDTFriction_setDissipation(xs[k], 40.0);
+    SDTFriction_setViscosity(xs[k], 1.0);
+    SDTFriction_setNoisiness(xs[k], 1.0);
+    SDTInteractor_setFirstResonator(xs[k], rubbers[k]);
+    SDTInteractor_setSecondResonator(xs[k], plates[k]);
+  }
+  // The last two frictions share a seed, the first two are left to differ
+  SDTFriction_setSeed(xs[2], 7);
+  SDTFriction_setSeed(xs[3], 7);
+  same = 1;
+  for (i = 0; i < 4410; ++i) {
+    for (k = 0; k < 4; ++k) {
+      SDTInteractor_dsp(xs[k], 1.0, 0.0, 0.0, 0.0, 0.0, 0.0, outs[k]);
+    }
+    same = same && outs[0][1] == outs[1][1];
+    CuAssertDblEquals(tc, outs[2][1], outs[3][1], 0.0);
+  }
+  CuAssert(tc, "Check new frictions draw different noise", !same);
+  CuAssert(tc, "Check the plates have been rubbed", outs[3][1] != 0.0);
+
+  for (k = 0; k < 4; ++k) {
+    SDTFriction_free(xs[k]);
+    SDTResonator_free(rubbers[k]);
+    SDTResonator_free(plates[k]);
+  }
+  SDT_TEST_END()
+}
+
+void TestSDTScheduler_dsp(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTResonator *hammer0 = _TestHelper_newHammer();
+  SDTResonator *plate0 = _TestHelper_newPlate();
+  SDTResonator *hammer1 = _TestHelper_newHammer();
+  SDTResonator *plate1 = _TestHelper_newPlate();
+  SDTResonator *hammer2 = _TestHelper_newHammer();
+  SDTInteractor *x0 = SDTImpact_new();
+  SDTInteractor *x1 = SDTImpact_new();
+  SDTInteractor *x2 = SDTImpact_new();
+  SDTInteractor *xs[3] = {x0, x1, x2};
+  SDTScheduler *scheduler = SDTScheduler_new();
+  double outs[2];
+  unsigned int i;
+
+  for (i = 0; i < 3; ++i) {
+    SDTImpact_setStiffness(xs[i], 1e8);
+    SDTImpact_setDissipation(xs[i], 0.8);
+    SDTImpact_setShape(xs[i], 1.5);
+  }
+  SDTInteractor_setFirstResonator(x0, hammer0);
+  SDTInteractor_setSecondResonator(x0, plate0);
+  SDT_registerResonator(hammer1, "hammer1");
+  SDT_registerResonator(plate1, "plate1");
+  SDT_registerInteractor(x1, "hammer1", "plate1");
+
+  // A single interaction behaves as a standalone interactor
+  SDTInteractor_dsp(x0, 0.0, -2.0, 0.0, 0.0, 0.0, 0.0, outs);
+  SDTInteractor_setInputs(x1, 0.0, -2.0, 0.0, 0.0, 0.0, 0.0);
+  SDTScheduler_dsp(scheduler);
+  CuAssertIntEquals(tc, 1, SDTScheduler_getNInteractors(scheduler));
+  CuAssertIntEquals(tc, 2, SDTScheduler_getNResonators(scheduler));
+  for (i = 0; i < 4410; ++i) {
+    SDTInteractor_dsp(x0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, outs);
+    SDTScheduler_dsp(scheduler);
+    CuAssertDblEquals(tc, outs[0], SDTInteractor_getOutput(x1, 0), 0.0);
+    CuAssertDblEquals(tc, outs[1], SDTInteractor_getOutput(x1, 1), 0.0);
+  }
+  CuAssert(tc, "Check the plate has been hit", outs[1] != 0.0);
+
+  // A shared resonator is updated only once per sample
+  SDT_registerResonator(hammer2, "hammer2");
+  SDT_registerInteractor(x2, "plate1", "hammer2");
+  SDTScheduler_dsp(scheduler);
+  CuAssertIntEquals(tc, 2, SDTScheduler_getNInteractors(scheduler));
+  CuAssertIntEquals(tc, 3, SDTScheduler_getNResonators(scheduler));
+  CuAssertDblEquals(tc, SDTResonator_getPosition(plate1, 0),
+                    SDTInteractor_getOutput(x2, 0), 0.0);
+
+  SDT_unregisterInteractor("plate1", "hammer2");
+  SDT_unregisterInteractor("hammer1", "plate1");
+  SDT_unregisterResonator("hammer2");
+  SDT_unregisterResonator("plate1");
+  SDT_unregisterResonator("hammer1");
+  SDTScheduler_dsp(scheduler);
+  CuAssertIntEquals(tc, 0, SDTScheduler_getNInteractors(scheduler));
+  SDTScheduler_free(scheduler);
+  SDTImpact_free(x0);
+  SDTImpact_free(x1);
+  SDTImpact_free(x2);
+  SDTResonator_free(hammer0);
+  SDTResonator_free(plate0);
+  SDTResonator_free(hammer1);
+  SDTResonator_free(plate1);
+  SDTResonator_free(hammer2);
+  SDT_TEST_END()
+}
+
+void TestSDTScheduler_dspBlock(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTResonator *hammers[2][TEST_INTERACTOR_NISLANDS];
+  SDTResonator *plates[2][TEST_INTERACTOR_NISLANDS];
+  SDTInteractor *xs[2][TEST_INTERACTOR_NISLANDS];
+  SDTScheduler *scheduler = SDTScheduler_new();
+  double buf[TEST_INTERACTOR_NISLANDS][2][TEST_INTERACTOR_BLOCKSIZE];
+  double *outs[TEST_INTERACTOR_NISLANDS][2], expected[2];
+  char key0[16], key1[16];
+  unsigned int block, i, j, k;
+
+  for (j = 0; j < TEST_INTERACTOR_NISLANDS; ++j) {
+    for (k = 0; k < 2; ++k) {
+      hammers[k][j] = _TestHelper_newHammer();
+      plates[k][j] = _TestHelper_newPlate();
+      // Odd islands rub, with noisy friction
+      if (j % 2) {
+        xs[k][j] = SDTFriction_new();
+        SDTFriction_setNormalForce(xs[k][j], 1.0);
+        SDTFriction_setStiffness(xs[k][j], 1e6);
+        SDTFriction_setDissipation(xs[k][j], 40.0);
+        SDTFriction_setViscosity(xs[k][j], 1.0);
+        SDTFriction_setNoisiness(xs[k][j], 1.0);
+        SDTFriction_setSeed(xs[k][j], j);
+        continue;
+      }
+      xs[k][j] = SDTImpact_new();
+      SDTImpact_setStiffness(xs[k][j], 1e8);
+      SDTImpact_setDissipation(xs[k][j], 0.8);
+      SDTImpact_setShape(xs[k][j], 1.5);
+    }
+    // Unregistered interactors are the reference
+    SDTInteractor_setFirstResonator(xs[0][j], hammers[0][j]);
+    SDTInteractor_setSecondResonator(xs[0][j], plates[0][j]);
+    snprintf(key0, 16, "hammer%u", j);
+    snprintf(key1, 16, "plate%u", j);
+    SDT_registerResonator(hammers[1][j], key0);
+    SDT_registerResonator(plates[1][j], key1);
+    SDT_registerInteractor(xs[1][j], key0, key1);
+    outs[j][0] = buf[j][0];
+    outs[j][1] = buf[j][1];
+    SDTInteractor_setOutputBuffers(xs[1][j], outs[j]);
+  }
+  CuAssertIntEquals(tc, 0, SDTScheduler_setNThreads(scheduler, 3));
+  CuAssertIntEquals(tc, 3, SDTScheduler_getNThreads(scheduler));
+
+  for (block = 0; block < 32; ++block) {
+    for (j = 0; j < TEST_INTERACTOR_NISLANDS; ++j) {
+      if (block % (j + 2)) continue;
+      SDTInteractor_dsp(xs[0][j], 0.0, -1.0 - j, 0.0, 0.0, 0.0, 0.0, expected);
+      SDTInteractor_setInputs(xs[1][j], 0.0, -1.0 - j, 0.0, 0.0, 0.0, 0.0);
+    }
+    SDTScheduler_dspBlock(scheduler, TEST_INTERACTOR_BLOCKSIZE);
+    CuAssertIntEquals(tc, TEST_INTERACTOR_NISLANDS,
+                      SDTScheduler_getNIslands(scheduler));
+    for (j = 0; j < TEST_INTERACTOR_NISLANDS; ++j) {
+      for (i = (block % (j + 2)) ? 0 : 1; i < TEST_INTERACTOR_BLOCKSIZE; ++i) {
+        SDTInteractor_dsp(xs[0][j], 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, expected);
+        CuAssertDblEquals(tc, expected[0], buf[j][0][i], 0.0);
+        CuAssertDblEquals(tc, expected[1], buf[j][1][i], 0.0);
+      }
+    }
+  }
+  CuAssert(tc, "Check the plates have been hit", buf[2][1][0] != 0.0);
+  CuAssert(tc, "Check the plates have been rubbed", buf[3][1][0] != 0.0);
+
+  SDTScheduler_free(scheduler);
+  for (j = 0; j < TEST_INTERACTOR_NISLANDS; ++j) {
+    snprintf(key0, 16, "hammer%u", j);
+    snprintf(key1, 16, "plate%u", j);
+    SDT_unregisterInteractor(key0, key1);
+    SDT_unregisterResonator(key0);
+    SDT_unregisterResonator(key1);
+    for (k = 0; k < 2; ++k) {
+      if (j % 2)
+        SDTFriction_free(xs[k][j]);
+      else
+        SDTImpact_free(xs[k][j]);
+      SDTResonator_free(hammers[k][j]);
+      SDTResonator_free(plates[k][j]);
+    }
+  }
+  SDT_TEST_END()
+}
+
+void TestSDTScheduler_islands(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  // Resonators a..f, chained so that a, b, e and f share an island
+  const char *keys[4][2] = {{"a", "b"}, {"c", "d"}, {"b", "e"}, {"e", "f"}};
+  SDTResonator *resonators[6];
+  SDTInteractor *xs[4];
+  SDTScheduler *scheduler = SDTScheduler_new();
+  double buf[4][2][TEST_INTERACTOR_BLOCKSIZE], *outs[4][2];
+  char key[2] = "a";
+  unsigned int block, i, j;
+
+  for (j = 0; j < 6; ++j) {
+    resonators[j] = _TestHelper_newHammer();
+    key[0] = 'a' + j;
+    SDT_registerResonator(resonators[j], key);
+  }
+  for (j = 0; j < 4; ++j) {
+    xs[j] = SDTImpact_new();
+    SDTImpact_setStiffness(xs[j], 1e8);
+    SDTImpact_setDissipation(xs[j], 0.8);
+    SDTImpact_setShape(xs[j], 1.5);
+    SDT_registerInteractor(xs[j], keys[j][0], keys[j][1]);
+    outs[j][0] = buf[j][0];
+    outs[j][1] = buf[j][1];
+    SDTInteractor_setOutputBuffers(xs[j], outs[j]);
+  }
+
+  // Interactors sharing a resonator read it at the same time
+  for (block = 0; block < 8; ++block) {
+    SDTInteractor_setInputs(xs[0], 1.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+    SDTInteractor_setInputs(xs[3], 1.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+    SDTScheduler_dspBlock(scheduler, TEST_INTERACTOR_BLOCKSIZE);
+    CuAssertIntEquals(tc, 2, SDTScheduler_getNIslands(scheduler));
+    for (i = 0; i < TEST_INTERACTOR_BLOCKSIZE; ++i) {
+      CuAssertDblEquals(tc, buf[0][1][i], buf[2][0][i], 0.0);
+      CuAssertDblEquals(tc, buf[2][1][i], buf[3][0][i], 0.0);
+    }
+  }
+  CuAssert(tc, "Check the shared resonator moves",
+           buf[3][0][0] != buf[3][0][TEST_INTERACTOR_BLOCKSIZE - 1]);
+
+  SDTScheduler_free(scheduler);
+  for (j = 0; j < 4; ++j) {
+    SDT_unregisterInteractor(keys[j][0], keys[j][1]);
+    SDTImpact_free(xs[j]);
+  }
+  for (j = 0; j < 6; ++j) {
+    key[0] = 'a' + j;
+    SDT_unregisterResonator(key);
+    SDTResonator_free(resonators[j]);
+  }
+  SDT_TEST_END()
+}
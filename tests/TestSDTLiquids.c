@@ -0,0 +1,336 @@
+/**
+ * @file TestSDTLiquids.c
+ * @brief Test SDT/SDTLiquids.h
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "CuTest.h"
+#include "SDT/SDTLiquids.h"
+#include "SDTTestUtils.h"
+
+#define TEST_LIQUIDS_LENGTH 8192
+#define TEST_LIQUIDS_NBUBBLES 256
+
+void TestSDTBubble_dsp(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTBubble *x = SDTBubble_new();
+  double radius, decay, amp, step, rise, phase, expected;
+  unsigned int i;
+
+  // A rising bubble, with a unit initial amplitude
+  radius = 0.01;
+  SDTBubble_setRadius(x, radius);
+  SDTBubble_setDepth(x, 1.0);
+  SDTBubble_setRiseFactor(x, 1.0);
+  SDTBubble_trigger(x);
+  SDTBubble_normAmp(x);
+  decay = 0.13 / radius + 0.0072 / (radius * sqrt(radius));
+  step = 3.0 / radius * SDT_timeStep;
+  rise = step * decay * SDT_timeStep;
+
+  // The phasor follows the exponentially decaying chirp, until it is quiet
+  amp = 1.0;
+  for (i = 0; amp >= SDT_QUIET; ++i) {
+    phase = i * step + 0.5 * i * (i - 1.0) * rise;
+    expected = fmin(phase, 1.0) * amp * sin(SDT_TWOPI * phase);
+    CuAssertDblEquals(tc, expected, SDTBubble_dsp(x), 3e-9);
+    amp = exp(-decay * SDT_timeStep * (i + 1));
+  }
+
+  SDTBubble_free(x);
+  SDT_TEST_END()
+}
+
+/* Draws a bubble like the fluid flow does, from the next two random numbers,
+   and plays it on a bubble object */
+static void _TestHelper_triggerBubble(SDTFluidFlow *x, SDTBubble *bubble) {
+  double radius, depth;
+
+  radius = SDT_scale(rand(), 0.0, RAND_MAX, SDTFluidFlow_getMinRadius(x),
+                     SDTFluidFlow_getMaxRadius(x),
+                     SDTFluidFlow_getExpRadius(x));
+  depth = SDT_scale(rand(), 0.0, RAND_MAX, SDTFluidFlow_getMinDepth(x),
+                    SDTFluidFlow_getMaxDepth(x), SDTFluidFlow_getExpDepth(x));
+  SDTBubble_setRadius(bubble, radius);
+  SDTBubble_setDepth(bubble, depth);
+  SDTBubble_setRiseFactor(bubble, depth > SDTFluidFlow_getRiseCutoff(x)
+                                      ? SDTFluidFlow_getRiseFactor(x)
+                                      : 0.0);
+  SDTBubble_trigger(bubble);
+}
+
+void TestSDTFluidFlow_release(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTFluidFlow *x = SDTFluidFlow_new(TEST_LIQUIDS_NBUBBLES);
+  SDTBubble *bubbles[TEST_LIQUIDS_NBUBBLES];
+  double buf[TEST_LIQUIDS_LENGTH], wait, expected, peak, error;
+  int i, j, n, maxActive;
+
+  // Bubbles of different sizes overlap, and fall silent in a different order
+  SDTFluidFlow_setMinRadius(x, 0.001);
+  SDTFluidFlow_setMaxRadius(x, 0.003);
+  SDTFluidFlow_setMinDepth(x, 0.2);
+  SDTFluidFlow_setMaxDepth(x, 1.0);
+  srand(5);
+  SDTFluidFlow_setAvgRate(x, 500.0);
+  maxActive = 0;
+  for (i = 0; i < TEST_LIQUIDS_LENGTH; ++i) {
+    if (i == TEST_LIQUIDS_LENGTH / 2) SDTFluidFlow_setAvgRate(x, 0.0);
+    buf[i] = SDTFluidFlow_dsp(x);
+    if (SDTFluidFlow_getActiveVoices(x) > maxActive) {
+      maxActive = SDTFluidFlow_getActiveVoices(x);
+    }
+  }
+
+  // Every bubble is played on its own, from the same random sequence
+  srand(5);
+  wait = SDT_expRand(500.0 * SDT_timeStep);
+  n = 0;
+  peak = 0.0;
+  error = 0.0;
+  for (i = 0; i < TEST_LIQUIDS_LENGTH; ++i) {
+    if (i == TEST_LIQUIDS_LENGTH / 2) wait = HUGE_VAL;
+    while (wait < 1.0 && n < TEST_LIQUIDS_NBUBBLES) {
+      bubbles[n] = SDTBubble_new();
+      _TestHelper_triggerBubble(x, bubbles[n++]);
+      wait += SDT_expRand(500.0 * SDT_timeStep);
+    }
+    wait -= 1.0;
+    expected = 0.0;
+    for (j = 0; j < n; ++j) expected += SDTBubble_dsp(bubbles[j]);
+    // The flow is normalized by its largest radius
+    expected *= 0.15 / SDTFluidFlow_getMaxRadius(x);
+    peak = fmax(peak, fabs(expected));
+    error = fmax(error, fabs(buf[i] - expected));
+  }
+  CuAssert(tc, "Check the reference is large enough",
+           n < TEST_LIQUIDS_NBUBBLES);
+  CuAssert(tc, "Check bubbles overlap", maxActive > 4);
+  // Voices are only released once they are quiet, as bubble objects are
+  CuAssert(tc, "Check accuracy",
+           error <= 2.0 * SDT_QUIET * 0.15 / SDTFluidFlow_getMaxRadius(x));
+  CuAssertIntEquals(tc, 0, SDTFluidFlow_getActiveVoices(x));
+
+  for (j = 0; j < n; ++j) SDTBubble_free(bubbles[j]);
+  SDTFluidFlow_free(x);
+  SDT_TEST_END()
+}
+
+void TestSDTFluidFlow_steal(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTFluidFlow *x = SDTFluidFlow_new(2);
+  SDTBubble *bubbles[2];
+  double buf[TEST_LIQUIDS_LENGTH], wait, expected, peak, error;
+  int i, n;
+
+  /* Identical bubbles, arriving much faster than they decay, but slower than
+     the attack of a bubble */
+  SDTFluidFlow_setMinRadius(x, 0.003);
+  SDTFluidFlow_setMaxRadius(x, 0.003);
+  SDTFluidFlow_setMinDepth(x, 1.0);
+  SDTFluidFlow_setMaxDepth(x, 1.0);
+  srand(7);
+  SDTFluidFlow_setAvgRate(x, 200.0);
+  for (i = 0; i < TEST_LIQUIDS_LENGTH; ++i) {
+    buf[i] = SDTFluidFlow_dsp(x);
+    CuAssert(tc, "Check the voices", SDTFluidFlow_getActiveVoices(x) <= 2);
+  }
+
+  // The oldest bubble is the closest to silence, and is stolen
+  srand(7);
+  wait = SDT_expRand(200.0 * SDT_timeStep);
+  bubbles[0] = SDTBubble_new();
+  bubbles[1] = SDTBubble_new();
+  n = 0;
+  peak = 0.0;
+  error = 0.0;
+  for (i = 0; i < TEST_LIQUIDS_LENGTH; ++i) {
+    while (wait < 1.0) {
+      _TestHelper_triggerBubble(x, bubbles[n++ % 2]);
+      wait += SDT_expRand(200.0 * SDT_timeStep);
+    }
+    wait -= 1.0;
+    expected = (SDTBubble_dsp(bubbles[0]) + SDTBubble_dsp(bubbles[1])) *
+               0.15 / SDTFluidFlow_getMaxRadius(x);
+    peak = fmax(peak, fabs(expected));
+    error = fmax(error, fabs(buf[i] - expected));
+  }
+  CuAssert(tc, "Check voices are stolen", n > 10);
+  CuAssert(tc, "Check accuracy", error <= 1e-9 * peak);
+
+  SDTBubble_free(bubbles[0]);
+  SDTBubble_free(bubbles[1]);
+  SDTFluidFlow_free(x);
+  SDT_TEST_END()
+}
+
+void TestSDTFluidFlow_avgRate(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTFluidFlow *x = SDTFluidFlow_new(4096);
+  int i, active, last, bursts;
+
+  // Large bubbles last longer than the test, so no voice is released
+  SDTFluidFlow_setMaxRadius(x, 0.15);
+  SDTFluidFlow_setMinRadius(x, 0.15);
+  srand(11);
+  SDTFluidFlow_setAvgRate(x, 100000.0);
+  active = 0;
+  last = 0;
+  bursts = 0;
+  for (i = 0; i < 1000; ++i) {
+    SDTFluidFlow_dsp(x);
+    active = SDTFluidFlow_getActiveVoices(x);
+    if (active - last > 1) bursts++;
+    last = active;
+  }
+  // More than two bubbles are born every sample, on average
+  CuAssert(tc, "Check several bubbles per sample", bursts > 100);
+  CuAssertDblEquals(tc, 1000.0 * 100000.0 / 44100.0, active,
+                    0.1 * 1000.0 * 100000.0 / 44100.0);
+
+  SDTFluidFlow_free(x);
+  SDT_TEST_END()
+}
+
+void TestSDTFluidFlow_dspBlock(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTFluidFlow *x0 = SDTFluidFlow_new(16);
+  SDTFluidFlow *x1 = SDTFluidFlow_new(16);
+  double buf[TEST_LIQUIDS_LENGTH], peak;
+  unsigned int i;
+
+  // Voices are both released and stolen, from the same random sequence
+  srand(13);
+  SDTFluidFlow_setAvgRate(x1, 1000.0);
+  for (i = 0; i < TEST_LIQUIDS_LENGTH; i += 100) {
+    SDTFluidFlow_dspBlock(
+        x1, buf + i,
+        i + 100 > TEST_LIQUIDS_LENGTH ? TEST_LIQUIDS_LENGTH - i : 100);
+  }
+  srand(13);
+  SDTFluidFlow_setAvgRate(x0, 1000.0);
+  peak = 0.0;
+  for (i = 0; i < TEST_LIQUIDS_LENGTH; ++i) {
+    CuAssertDblEquals(tc, SDTFluidFlow_dsp(x0), buf[i], 0.0);
+    peak = fmax(peak, fabs(buf[i]));
+  }
+  CuAssert(tc, "Check the flow bubbles", peak > 0.0);
+
+  SDTFluidFlow_free(x0);
+  SDTFluidFlow_free(x1);
+  SDT_TEST_END()
+}
+
+void TestSDTSpectralFlow_dspBlock(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTFluidFlow *x0 = SDTFluidFlow_new(4);
+  SDTSpectralFlow *x1 = SDTSpectralFlow_new(4);
+  double expected[TEST_LIQUIDS_LENGTH], buf[TEST_LIQUIDS_LENGTH], peak, error;
+  unsigned int i, onset, hop;
+
+  // Deep bubbles of a single size, with a steady pitch
+  SDTFluidFlow_setMinRadius(x0, 0.005);
+  SDTFluidFlow_setMaxRadius(x0, 0.005);
+  SDTFluidFlow_setMinDepth(x0, 0.0);
+  SDTFluidFlow_setMaxDepth(x0, 0.5);
+  SDTSpectralFlow_setMinRadius(x1, 0.005);
+  SDTSpectralFlow_setMaxRadius(x1, 0.005);
+  SDTSpectralFlow_setMinDepth(x1, 0.0);
+  SDTSpectralFlow_setMaxDepth(x1, 0.5);
+  hop = SDTSpectralFlow_getHopSize(x1);
+
+  // With the same random sequence, both objects draw the same bubbles
+  srand(3);
+  SDTFluidFlow_setAvgRate(x0, 10.0);
+  SDTFluidFlow_dspBlock(x0, expected, TEST_LIQUIDS_LENGTH);
+  srand(3);
+  SDTSpectralFlow_setAvgRate(x1, 10.0);
+  for (i = 0; i < TEST_LIQUIDS_LENGTH; i += 100) {
+    SDTSpectralFlow_dspBlock(
+        x1, buf + i,
+        i + 100 > TEST_LIQUIDS_LENGTH ? TEST_LIQUIDS_LENGTH - i : 100);
+  }
+
+  // After the onset, smoothed over a hop, the bubble matches the fluid flow
+  onset = 0;
+  while (onset < TEST_LIQUIDS_LENGTH && expected[onset] == 0.0) onset++;
+  CuAssert(tc, "Check a bubble is born", onset + 8 * hop < TEST_LIQUIDS_LENGTH);
+  peak = 0.0;
+  error = 0.0;
+  for (i = onset + 2 * hop; i < onset + 8 * hop; ++i) {
+    peak = fmax(peak, fabs(expected[i]));
+    error = fmax(error, fabs(buf[i] - expected[i]));
+  }
+  CuAssert(tc, "Check the bubble rings", peak > 0.0);
+  CuAssert(tc, "Check accuracy", error <= 1e-3 * peak);
+
+  SDTFluidFlow_free(x0);
+  SDTSpectralFlow_free(x1);
+  SDT_TEST_END()
+}
+
+void TestSDTSpectralFlow_saturate(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTSpectralFlow *x = SDTSpectralFlow_new(1);
+  double buf[TEST_LIQUIDS_LENGTH], rate, wait, n, amp, decay, step,
+      expected, peak, error;
+  unsigned int i, hop, frame, born, maxBorn;
+
+  // Identical bubbles, arriving many times per hop on a single voice
+  SDTSpectralFlow_setMinRadius(x, 0.005);
+  SDTSpectralFlow_setMaxRadius(x, 0.005);
+  SDTSpectralFlow_setMinDepth(x, 0.5);
+  SDTSpectralFlow_setMaxDepth(x, 0.5);
+  hop = SDTSpectralFlow_getHopSize(x);
+  rate = 20000.0;
+  srand(5);
+  SDTSpectralFlow_setAvgRate(x, rate);
+  SDTSpectralFlow_dspBlock(x, buf, TEST_LIQUIDS_LENGTH);
+  CuAssertIntEquals(tc, 1, SDTSpectralFlow_getActiveVoices(x));
+
+  /* Each frame, the first bubble takes the voice and the others are dropped,
+     so the center of the frame only holds the bubble born first */
+  amp = 17.2133 * 0.005 * sqrt(0.005) * 0.5 * 0.15 / 0.005;
+  decay = 0.13 / 0.005 + 0.0072 / (0.005 * sqrt(0.005));
+  step = 3.0 / 0.005 * SDT_timeStep;
+  srand(5);
+  wait = SDT_expRand(rate * SDT_timeStep) - hop;
+  peak = 0.0;
+  error = 0.0;
+  maxBorn = 0;
+  for (frame = 0; (frame + 1) * hop < TEST_LIQUIDS_LENGTH; ++frame) {
+    born = 0;
+    n = 0.0;
+    while (wait < 1.0) {
+      if (!born) n = -floor(wait);
+      born++;
+      rand();
+      rand();
+      wait += SDT_expRand(rate * SDT_timeStep);
+    }
+    wait -= hop;
+    if (born > maxBorn) maxBorn = born;
+    if (frame < 1) continue;
+    expected = amp * exp(-decay * SDT_timeStep * n) * sin(SDT_TWOPI * step * n);
+    i = (frame + 1) * hop;
+    peak = fmax(peak, fabs(expected));
+    error = fmax(error, fabs(buf[i] - expected));
+  }
+  CuAssert(tc, "Check the flow is saturated", maxBorn > 4);
+  CuAssert(tc, "Check the first bubble is kept", error <= 1e-3 * peak);
+
+  SDTSpectralFlow_free(x);
+  SDT_TEST_END()
+}
@@ -0,0 +1,769 @@
+/**
+ * @file TestSDTResonators.c
+ * @brief Test SDT/SDTResonators.h
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ */
+#include <math.h>
+#include <stdio.h>
+
+#include "CuTest.h"
+#include "SDT/SDTResonators.h"
+#include "SDTTestUtils.h"
+
+#define TEST_RESONATOR_NMODES 24
+#define TEST_RESONATOR_NPICKUPS 3
+#define TEST_RESONATOR_BLOCKSIZE 64
+#define TEST_RESONATOR_NINSTANCES 19
+
+/* Tolerance between processing paths relative to the peak output, and error
+   tolerance relative to the modal envelope after long runs */
+#ifdef SDT_RESONATOR_FLOAT32
+#define TEST_RESONATOR_EPSILON 1e-3
+#define TEST_RESONATOR_DRIFT 2e-2
+#else
+#define TEST_RESONATOR_EPSILON 1e-9
+#define TEST_RESONATOR_DRIFT 1e-9
+#endif
+
+static SDTResonator *_TestHelper_newResonator(unsigned int nModes,
+                                              unsigned int nPickups) {
+  SDTResonator *x = SDTResonator_new(nModes, nPickups);
+  SDTRandomSequence *freqs = SDTRandomSequence_newLog(nModes, 50, 18000);
+  SDTRandomSequence *decays = SDTRandomSequence_newLog(nModes, 0.005, 0.5);
+  SDTRandomSequence *gains = SDTRandomSequence_newFloat(0, 0, 100);
+  unsigned int mode, pickup;
+
+  SDTResonator_setFragmentSize(x, 1.0);
+  SDTResonator_setActiveModes(x, nModes);
+  mode = 0;
+  FOR_RANDOM_ITER_FLOAT (freqs, f) {
+    SDTResonator_setFrequency(x, mode, f);
+    SDTResonator_setDecay(x, mode, SDTRandomSequence_nextFloat(decays));
+    SDTResonator_setWeight(x, mode, 0.01);
+    for (pickup = 0; pickup < nPickups; ++pickup)
+      SDTResonator_setGain(x, pickup, mode,
+                           SDTRandomSequence_nextFloat(gains));
+    ++mode;
+  }
+  SDTResonator_update(x);
+  SDTRandomSequence_free(freqs);
+  SDTRandomSequence_free(decays);
+  SDTRandomSequence_free(gains);
+  return x;
+}
+
+// Exact impulse response of a mode at sample n, for a unit force at sample 0
+static double _TestHelper_modalImpulse(double freq, double decay,
+                                       double weight, unsigned long n) {
+  double w = SDT_TWOPI * freq, t = (n + 1) * SDT_timeStep;
+
+  return SDT_timeStep / (weight * w) * exp(-2.0 * t / decay) * sin(w * t);
+}
+
+// Modal envelope at sample n, for a unit force at sample 0
+static double _TestHelper_modalEnvelope(double freq, double decay,
+                                        double weight, unsigned long n) {
+  double w = SDT_TWOPI * freq, t = (n + 1) * SDT_timeStep;
+
+  return SDT_timeStep / (weight * w) * exp(-2.0 * t / decay);
+}
+
+void TestSDTResonator_dspBlock(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTResonator *x0 = _TestHelper_newResonator(TEST_RESONATOR_NMODES,
+                                              TEST_RESONATOR_NPICKUPS);
+  SDTResonator *x1 = _TestHelper_newResonator(TEST_RESONATOR_NMODES,
+                                              TEST_RESONATOR_NPICKUPS);
+  SDTRandomSequence *forces = SDTRandomSequence_newFloat(0, -1, 1);
+  double in[TEST_RESONATOR_BLOCKSIZE];
+  double buf[TEST_RESONATOR_NPICKUPS][TEST_RESONATOR_BLOCKSIZE];
+  double *outs[TEST_RESONATOR_NPICKUPS];
+  double expected, peak;
+  unsigned int block, i, pickup;
+
+  for (pickup = 0; pickup < TEST_RESONATOR_NPICKUPS; ++pickup)
+    outs[pickup] = buf[pickup];
+  peak = 0.0;
+  for (block = 0; block < 32; ++block) {
+    // Sparse impulsive input, silent in the second half of the run
+    for (i = 0; i < TEST_RESONATOR_BLOCKSIZE; ++i)
+      in[i] = (block < 16 && i % 7 == 0) ? SDTRandomSequence_nextFloat(forces)
+                                         : 0.0;
+    SDTResonator_dspBlock(x1, 1, in, outs, TEST_RESONATOR_BLOCKSIZE);
+    for (i = 0; i < TEST_RESONATOR_BLOCKSIZE; ++i) {
+      SDTResonator_applyForce(x0, 1, in[i]);
+      SDTResonator_dsp(x0);
+      for (pickup = 0; pickup < TEST_RESONATOR_NPICKUPS; ++pickup) {
+        expected = SDTResonator_getPosition(x0, pickup);
+        peak = fmax(peak, fabs(expected));
+        CuAssertDblEquals(tc, expected, outs[pickup][i],
+                          TEST_RESONATOR_EPSILON * peak);
+      }
+    }
+  }
+  CuAssert(tc, "Check the resonator has been excited", peak > 0.0);
+  SDTResonator_free(x0);
+  SDTResonator_free(x1);
+  SDTRandomSequence_free(forces);
+  SDT_TEST_END()
+}
+
+void TestSDTResonator_kernels(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  // Specialized sizes, and generic sizes around them
+  unsigned int sizes[] = {1, 2, 3, 4, 8, 16, 17};
+  double in[TEST_RESONATOR_BLOCKSIZE], buf[2][TEST_RESONATOR_BLOCKSIZE];
+  double *outs[2] = {buf[0], buf[1]}, expected, peak;
+  unsigned int block, i, pickup, size;
+
+  for (size = 0; size < sizeof(sizes) / sizeof(sizes[0]); ++size) {
+    SDTResonator *x0 = _TestHelper_newResonator(sizes[size], 2);
+    SDTResonator *x1 = _TestHelper_newResonator(sizes[size], 2);
+    // Inertial mode
+    SDTResonator_setFrequency(x0, 0, 0.0);
+    SDTResonator_setFrequency(x1, 0, 0.0);
+    peak = 0.0;
+    for (block = 0; block < 8; ++block) {
+      for (i = 0; i < TEST_RESONATOR_BLOCKSIZE; ++i)
+        in[i] = (block < 4 && i % 11 == 0) ? 1.0 / (i + 1) : 0.0;
+      SDTResonator_dspBlock(x1, 0, in, outs, TEST_RESONATOR_BLOCKSIZE);
+      for (i = 0; i < TEST_RESONATOR_BLOCKSIZE; ++i) {
+        SDTResonator_applyForce(x0, 0, in[i]);
+        SDTResonator_dsp(x0);
+        for (pickup = 0; pickup < 2; ++pickup) {
+          expected = SDTResonator_getPosition(x0, pickup);
+          peak = fmax(peak, fabs(expected));
+          CuAssertDblEquals(tc, expected, outs[pickup][i],
+                            TEST_RESONATOR_EPSILON * peak);
+        }
+      }
+    }
+    CuAssert(tc, "Check the resonator has been excited", peak > 0.0);
+    CuAssertDblEquals(tc, SDTResonator_getVelocity(x0, 1),
+                      SDTResonator_getVelocity(x1, 1),
+                      TEST_RESONATOR_EPSILON * peak * 44100.0);
+    SDTResonator_free(x0);
+    SDTResonator_free(x1);
+  }
+  SDT_TEST_END()
+}
+
+void TestSDTResonator_sleep(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTResonator *x0 = _TestHelper_newResonator(TEST_RESONATOR_NMODES, 1);
+  SDTResonator *x1 = _TestHelper_newResonator(TEST_RESONATOR_NMODES, 1);
+  unsigned int i;
+
+  SDTResonator_setSleepThreshold(x1, 1e-18);
+  CuAssertIntEquals_Msg(tc, "Check modes at rest are asleep", 0,
+                        SDTResonator_getAwakeModes(x1));
+  SDTResonator_applyForce(x0, 0, 1.0);
+  SDTResonator_applyForce(x1, 0, 1.0);
+  CuAssertIntEquals_Msg(tc, "Check applied force wakes modes",
+                        TEST_RESONATOR_NMODES, SDTResonator_getAwakeModes(x1));
+  for (i = 0; i < 4 * 44100; ++i) {
+    SDTResonator_dsp(x0);
+    SDTResonator_dsp(x1);
+    CuAssertDblEquals(tc, SDTResonator_getPosition(x0, 0),
+                      SDTResonator_getPosition(x1, 0), 1e-8);
+  }
+  CuAssertIntEquals_Msg(tc, "Check decayed modes fall asleep", 0,
+                        SDTResonator_getAwakeModes(x1));
+  SDTResonator_setVelocity(x1, 0, 1.0);
+  CuAssertIntEquals_Msg(tc, "Check applied velocity wakes modes",
+                        TEST_RESONATOR_NMODES, SDTResonator_getAwakeModes(x1));
+
+  // Sample by sample, the energy is only checked every 64 samples
+  SDTResonator_setSleepThreshold(x1, 1e6);
+  for (i = 0; i < 64; ++i) {
+    CuAssertIntEquals(tc, TEST_RESONATOR_NMODES,
+                      SDTResonator_getAwakeModes(x1));
+    SDTResonator_dsp(x1);
+  }
+  CuAssertIntEquals(tc, 0, SDTResonator_getAwakeModes(x1));
+  SDTResonator_free(x0);
+  SDTResonator_free(x1);
+  SDT_TEST_END()
+}
+
+void TestSDTResonator_liveModes(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTResonator *x = _TestHelper_newResonator(TEST_RESONATOR_NMODES, 2);
+  double in[TEST_RESONATOR_BLOCKSIZE], buf[2][TEST_RESONATOR_BLOCKSIZE];
+  double *outs[2] = {buf[0], buf[1]}, expected, error, peak, sum;
+  double freq, decay, weight;
+  unsigned long n;
+  unsigned int i, mode, pickup;
+  int live;
+
+  // Modes above Nyquist and modes without gain never reach an output
+  for (mode = 0; mode < 4; ++mode) SDTResonator_setFrequency(x, mode, 30000.0);
+  for (mode = 4; mode < 8; ++mode)
+    for (pickup = 0; pickup < 2; ++pickup)
+      SDTResonator_setGain(x, pickup, mode, 0.0);
+  SDTResonator_update(x);
+  CuAssertIntEquals(tc, TEST_RESONATOR_NMODES - 8,
+                    SDTResonator_getLiveModes(x));
+
+  sum = 0.0;
+  for (mode = 0; mode < TEST_RESONATOR_NMODES; ++mode)
+    sum += SDTResonator_getGain(x, 0, mode);
+  error = 0.0;
+  peak = 0.0;
+  for (n = 0; n < 4410;) {
+    for (i = 0; i < TEST_RESONATOR_BLOCKSIZE; ++i) in[i] = n + i == 0;
+    SDTResonator_dspBlock(x, 0, in, outs, TEST_RESONATOR_BLOCKSIZE);
+    for (i = 0; i < TEST_RESONATOR_BLOCKSIZE; ++i, ++n) {
+      for (pickup = 0; pickup < 2; ++pickup) {
+        expected = 0.0;
+        for (mode = 4; mode < TEST_RESONATOR_NMODES; ++mode) {
+          freq = SDTResonator_getFrequency(x, mode);
+          decay = SDTResonator_getDecay(x, mode);
+          weight = SDTResonator_getWeight(x, mode);
+          expected += SDTResonator_getGain(x, pickup, mode) *
+                      SDTResonator_getGain(x, 0, mode) / sum *
+                      _TestHelper_modalImpulse(freq, decay, weight, n);
+        }
+        peak = fmax(peak, fabs(expected));
+        error = fmax(error, fabs(buf[pickup][i] - expected));
+      }
+    }
+  }
+  CuAssert(tc, "Check the resonator has been excited", peak > 0.0);
+  CuAssert(tc, "Check live modes match the exact response",
+           error < TEST_RESONATOR_DRIFT * peak);
+  SDTResonator_getPositions(x, buf[0]);
+  for (pickup = 0; pickup < 2; ++pickup)
+    CuAssertDblEquals(tc, SDTResonator_getPosition(x, pickup), buf[0][pickup],
+                      TEST_RESONATOR_EPSILON * peak);
+
+  // Liveness follows gains and fragment size
+  SDTResonator_setGain(x, 1, 4, 1.0);
+  SDTResonator_update(x);
+  CuAssertIntEquals(tc, TEST_RESONATOR_NMODES - 7,
+                    SDTResonator_getLiveModes(x));
+  live = SDTResonator_getLiveModes(x);
+  SDTResonator_modulateFragmentSize(x, 0.01);
+  CuAssert(tc, "Check smaller fragments lose high modes",
+           SDTResonator_getLiveModes(x) < live);
+  SDTResonator_modulateFragmentSize(x, 1.0);
+  CuAssertIntEquals(tc, live, SDTResonator_getLiveModes(x));
+  SDTResonator_free(x);
+  SDT_TEST_END()
+}
+
+void TestSDTResonator_reserve(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTResonator *x = _TestHelper_newResonator(TEST_RESONATOR_NMODES, 1);
+  json_value *j;
+
+  SDTResonator_reserve(x, 2 * TEST_RESONATOR_NMODES, TEST_RESONATOR_NPICKUPS);
+  CuAssertIntEquals(tc, 2 * TEST_RESONATOR_NMODES,
+                    SDTResonator_getModeCapacity(x));
+  CuAssertIntEquals(tc, TEST_RESONATOR_NPICKUPS,
+                    SDTResonator_getPickupCapacity(x));
+  CuAssertIntEquals(tc, TEST_RESONATOR_NMODES, SDTResonator_getNModes(x));
+  CuAssert(tc, "Check reserve preserves parameters",
+           SDTResonator_getFrequency(x, TEST_RESONATOR_NMODES - 1) > 0.0);
+
+  // Shrinking and growing within capacity clears the modes coming back
+  SDTResonator_setNModes(x, 4);
+  CuAssertIntEquals(tc, 4, SDTResonator_getActiveModes(x));
+  SDTResonator_setNModes(x, TEST_RESONATOR_NMODES);
+  SDTResonator_setNPickups(x, TEST_RESONATOR_NPICKUPS);
+  CuAssertDblEquals(tc, 0.0, SDTResonator_getFrequency(x, 4), 0.0);
+  CuAssertDblEquals(tc, 0.0, SDTResonator_getGain(x, 0, 4), 0.0);
+  CuAssertDblEquals(tc, 0.0, SDTResonator_getGain(x, 2, 0), 0.0);
+  CuAssert(tc, "Check modes below the new size are kept",
+           SDTResonator_getFrequency(x, 3) > 0.0);
+  CuAssertIntEquals(tc, 2 * TEST_RESONATOR_NMODES,
+                    SDTResonator_getModeCapacity(x));
+
+  // Resizing within capacity from JSON is safe
+  j = json_object_new(0);
+  json_object_push(j, "nModes", json_integer_new(2 * TEST_RESONATOR_NMODES));
+  SDTResonator_setParams(x, j, 0);
+  CuAssertIntEquals(tc, 2 * TEST_RESONATOR_NMODES, SDTResonator_getNModes(x));
+  json_builder_free(j);
+  j = json_object_new(0);
+  json_object_push(j, "nModes", json_integer_new(4 * TEST_RESONATOR_NMODES));
+  SDTResonator_setParams(x, j, 0);
+  CuAssertIntEquals(tc, 2 * TEST_RESONATOR_NMODES, SDTResonator_getNModes(x));
+  json_builder_free(j);
+
+  // Growing beyond capacity reallocates
+  SDTResonator_setNModes(x, 4 * TEST_RESONATOR_NMODES);
+  CuAssertIntEquals(tc, 4 * TEST_RESONATOR_NMODES,
+                    SDTResonator_getModeCapacity(x));
+  CuAssert(tc, "Check reallocation preserves parameters",
+           SDTResonator_getFrequency(x, 3) > 0.0);
+  SDTResonator_free(x);
+  SDT_TEST_END()
+}
+
+void TestSDTResonator_reserveStaged(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTResonator *x0 = _TestHelper_newResonator(TEST_RESONATOR_NMODES, 1);
+  SDTResonator *x1 = _TestHelper_newResonator(TEST_RESONATOR_NMODES, 1);
+  double buf[2][TEST_RESONATOR_BLOCKSIZE];
+  double *outs[2][TEST_RESONATOR_NPICKUPS] = {{buf[0]}, {buf[1]}};
+  unsigned int block, i;
+
+  // Storage reserved while ringing is swapped in without changing the state
+  SDTResonator_applyForce(x0, 0, 1.0);
+  SDTResonator_applyForce(x1, 0, 1.0);
+  for (block = 0; block < 4; ++block) {
+    if (block == 1) {
+      SDTResonator_reserve(x1, 2 * TEST_RESONATOR_NMODES,
+                           TEST_RESONATOR_NPICKUPS);
+      CuAssertIntEquals(tc, 2 * TEST_RESONATOR_NMODES,
+                        SDTResonator_getModeCapacity(x1));
+    }
+    // The same sizes, without reserving, are allocated on the spot
+    if (block == 2) {
+      SDTResonator_setNModes(x0, 2 * TEST_RESONATOR_NMODES);
+      SDTResonator_setNPickups(x0, TEST_RESONATOR_NPICKUPS);
+      SDTResonator_setNModes(x1, 2 * TEST_RESONATOR_NMODES);
+      SDTResonator_setNPickups(x1, TEST_RESONATOR_NPICKUPS);
+    }
+    SDTResonator_dspBlock(x0, 0, NULL, outs[0], TEST_RESONATOR_BLOCKSIZE);
+    SDTResonator_dspBlock(x1, 0, NULL, outs[1], TEST_RESONATOR_BLOCKSIZE);
+    for (i = 0; i < TEST_RESONATOR_BLOCKSIZE; ++i) {
+      CuAssertDblEquals(tc, buf[0][i], buf[1][i], 0.0);
+    }
+  }
+  CuAssert(tc, "Check the object rings", buf[1][0] != 0.0);
+  CuAssertIntEquals(tc, 2 * TEST_RESONATOR_NMODES, SDTResonator_getNModes(x1));
+  CuAssertIntEquals(tc, TEST_RESONATOR_NPICKUPS, SDTResonator_getNPickups(x1));
+  SDTResonator_free(x0);
+  SDTResonator_free(x1);
+  SDT_TEST_END()
+}
+
+void TestSDTResonator_drift(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  double freqs[3] = {20.0, 440.0, 15000.0}, decay = 5.0;
+  double in[TEST_RESONATOR_BLOCKSIZE], buf[TEST_RESONATOR_BLOCKSIZE];
+  double *outs[1] = {buf}, expected, error;
+  unsigned long n;
+  unsigned int i, j;
+
+  // Long, lightly damped runs accumulate phase and amplitude errors
+  for (j = 0; j < 3; ++j) {
+    SDTResonator *x = SDTResonator_new(1, 1);
+    SDTResonator_setFragmentSize(x, 1.0);
+    SDTResonator_setFrequency(x, 0, freqs[j]);
+    SDTResonator_setDecay(x, 0, decay);
+    SDTResonator_setWeight(x, 0, 1.0);
+    SDTResonator_setGain(x, 0, 0, 1.0);
+    SDTResonator_setActiveModes(x, 1);
+    error = 0.0;
+    for (n = 0; n < 10 * 44100;) {
+      for (i = 0; i < TEST_RESONATOR_BLOCKSIZE; ++i) in[i] = n + i == 0;
+      SDTResonator_dspBlock(x, 0, in, outs, TEST_RESONATOR_BLOCKSIZE);
+      for (i = 0; i < TEST_RESONATOR_BLOCKSIZE; ++i, ++n) {
+        expected = _TestHelper_modalImpulse(freqs[j], decay, 1.0, n);
+        error = fmax(error, fabs(buf[i] - expected) /
+                                _TestHelper_modalEnvelope(freqs[j], decay,
+                                                          1.0, n));
+      }
+    }
+    CuAssert(tc, "Check drift from the exact response",
+             error < TEST_RESONATOR_DRIFT);
+    SDTResonator_free(x);
+  }
+  SDT_TEST_END()
+}
+
+void TestSDTResonator_decay(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTResonator *x = _TestHelper_newResonator(TEST_RESONATOR_NMODES, 1);
+  double in[TEST_RESONATOR_BLOCKSIZE], buf[TEST_RESONATOR_BLOCKSIZE];
+  double *outs[1] = {buf}, expected, envelope, envelope0, error, sum, w;
+  double freq, decay, weight, gain;
+  unsigned long n;
+  unsigned int i, mode;
+
+  sum = 0.0;
+  for (mode = 0; mode < TEST_RESONATOR_NMODES; ++mode)
+    sum += SDTResonator_getGain(x, 0, mode);
+  error = 0.0;
+  envelope0 = 0.0;
+  for (n = 0; n < 44100;) {
+    for (i = 0; i < TEST_RESONATOR_BLOCKSIZE; ++i) in[i] = n + i == 0;
+    SDTResonator_dspBlock(x, 0, in, outs, TEST_RESONATOR_BLOCKSIZE);
+    for (i = 0; i < TEST_RESONATOR_BLOCKSIZE; ++i, ++n) {
+      expected = 0.0;
+      envelope = 0.0;
+      for (mode = 0; mode < TEST_RESONATOR_NMODES; ++mode) {
+        freq = SDTResonator_getFrequency(x, mode);
+        decay = SDTResonator_getDecay(x, mode);
+        weight = SDTResonator_getWeight(x, mode);
+        gain = SDTResonator_getGain(x, 0, mode);
+        w = gain * gain / sum;
+        expected += w * _TestHelper_modalImpulse(freq, decay, weight, n);
+        envelope += w * _TestHelper_modalEnvelope(freq, decay, weight, n);
+      }
+      if (n == 0) envelope0 = envelope;
+      // Skip the tail, where the output is too small to be meaningful
+      if (envelope < 1e-6 * envelope0) continue;
+      error = fmax(error, fabs(buf[i] - expected) / envelope);
+    }
+  }
+  CuAssert(tc, "Check modal bank decays as the exact response",
+           error < TEST_RESONATOR_DRIFT);
+  SDTResonator_free(x);
+  SDT_TEST_END()
+}
+
+void TestSDTResonator_commit(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTResonator *x0 = _TestHelper_newResonator(TEST_RESONATOR_NMODES, 1);
+  SDTResonator *x1 = _TestHelper_newResonator(TEST_RESONATOR_NMODES, 1);
+  unsigned int i, mode;
+
+  SDTResonator_applyForce(x0, 0, 1.0);
+  SDTResonator_applyForce(x1, 0, 1.0);
+  for (i = 0; i < 100; ++i) {
+    SDTResonator_dsp(x0);
+    SDTResonator_dsp(x1);
+  }
+  // Pending changes are applied once, with the same result
+  for (mode = 0; mode < TEST_RESONATOR_NMODES; ++mode) {
+    SDTResonator_setWeight(x0, mode, 0.02);
+    SDTResonator_commit(x0);
+    SDTResonator_setFrequency(x0, mode,
+                              1.5 * SDTResonator_getFrequency(x0, mode));
+    SDTResonator_commit(x0);
+    SDTResonator_setWeight(x1, mode, 0.05);
+    SDTResonator_setFrequency(x1, mode,
+                              1.5 * SDTResonator_getFrequency(x1, mode));
+    SDTResonator_setWeight(x1, mode, 0.02);
+  }
+  SDTResonator_setGain(x0, 0, 0, 0.0);
+  SDTResonator_setGain(x1, 0, 0, 0.0);
+  for (i = 0; i < 100; ++i) {
+    SDTResonator_dsp(x0);
+    SDTResonator_dsp(x1);
+    CuAssertDblEquals(
+        tc, SDTResonator_getPosition(x0, 0), SDTResonator_getPosition(x1, 0),
+        TEST_RESONATOR_EPSILON * fabs(SDTResonator_getPosition(x0, 0)));
+  }
+  CuAssertDblEquals(
+      tc, SDTResonator_computeEnergy(x0, 0, 0.0),
+      SDTResonator_computeEnergy(x1, 0, 0.0),
+      TEST_RESONATOR_EPSILON * SDTResonator_computeEnergy(x0, 0, 0.0));
+  SDTResonator_free(x0);
+  SDTResonator_free(x1);
+  SDT_TEST_END()
+}
+
+void TestSDTResonator_modulateFragmentSize(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTResonator *x0 = _TestHelper_newResonator(TEST_RESONATOR_NMODES, 1);
+  SDTResonator *x1 = _TestHelper_newResonator(TEST_RESONATOR_NMODES, 1);
+  double p0, p1, peak, error;
+  unsigned int i;
+
+  SDTResonator_applyForce(x0, 0, 1.0);
+  SDTResonator_applyForce(x1, 0, 1.0);
+  // A smooth sweep follows exact updates closely
+  peak = 0.0;
+  error = 0.0;
+  for (i = 0; i < 4410; ++i) {
+    SDTResonator_setFragmentSize(x0, 1.0 - 0.5 * i / 4410.0);
+    SDTResonator_modulateFragmentSize(x1, 1.0 - 0.5 * i / 4410.0);
+    SDTResonator_dsp(x0);
+    SDTResonator_dsp(x1);
+    p0 = SDTResonator_getPosition(x0, 0);
+    p1 = SDTResonator_getPosition(x1, 0);
+    peak = fmax(peak, fabs(p0));
+    error = fmax(error, fabs(p1 - p0));
+  }
+  CuAssert(tc, "Check the resonator rings", peak > 0.0);
+  CuAssert(tc, "Check sweep accuracy", error <= 1e-3 * peak);
+
+  // Jumps are exact
+  SDTResonator_setFragmentSize(x0, 0.9);
+  SDTResonator_modulateFragmentSize(x1, 0.9);
+  for (i = 0; i < 100; ++i) {
+    SDTResonator_dsp(x0);
+    SDTResonator_dsp(x1);
+  }
+  CuAssertDblEquals(tc, SDTResonator_computeEnergy(x0, 0, 0.0),
+                    SDTResonator_computeEnergy(x1, 0, 0.0),
+                    1e-3 * SDTResonator_computeEnergy(x0, 0, 0.0));
+  SDTResonator_free(x0);
+  SDTResonator_free(x1);
+  SDT_TEST_END()
+}
+
+void TestSDTResonatorBank_dspBlock(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTResonator *model = _TestHelper_newResonator(TEST_RESONATOR_NMODES, 2);
+  SDTResonator *xs[TEST_RESONATOR_NINSTANCES];
+  SDTResonatorBank *bank;
+  double out[TEST_RESONATOR_BLOCKSIZE], expected, peak;
+  unsigned int block, i, j, mode;
+
+  SDTResonator_setSleepThreshold(model, 1e-30);
+  bank = SDTResonatorBank_new(model, TEST_RESONATOR_NINSTANCES);
+  CuAssertIntEquals(tc, TEST_RESONATOR_NINSTANCES,
+                    SDTResonatorBank_getNInstances(bank));
+  for (j = 0; j < TEST_RESONATOR_NINSTANCES; ++j) {
+    xs[j] = SDTResonator_new(TEST_RESONATOR_NMODES, 2);
+    for (mode = 0; mode < TEST_RESONATOR_NMODES; ++mode) {
+      SDTResonator_setFrequency(xs[j], mode,
+                                SDTResonator_getFrequency(model, mode));
+      SDTResonator_setDecay(xs[j], mode, SDTResonator_getDecay(model, mode));
+      SDTResonator_setWeight(xs[j], mode, SDTResonator_getWeight(model, mode));
+      for (i = 0; i < 2; ++i)
+        SDTResonator_setGain(xs[j], i, mode,
+                             SDTResonator_getGain(model, i, mode));
+    }
+    SDTResonator_setActiveModes(xs[j], TEST_RESONATOR_NMODES);
+    SDTResonator_setFragmentSize(xs[j], 1.0 - 0.04 * j);
+    SDTResonatorBank_setFragmentSize(bank, j, 1.0 - 0.04 * j);
+  }
+
+  // Instances behave as independent resonators
+  peak = 0.0;
+  for (block = 0; block < 16; ++block) {
+    for (j = block % 3; j < TEST_RESONATOR_NINSTANCES; j += 3) {
+      SDTResonator_applyForce(xs[j], block % 2, 1.0 + j);
+      SDTResonatorBank_applyForce(bank, j, block % 2, 1.0 + j);
+    }
+    SDTResonatorBank_dspBlock(bank, 1, out, TEST_RESONATOR_BLOCKSIZE);
+    for (i = 0; i < TEST_RESONATOR_BLOCKSIZE; ++i) {
+      expected = 0.0;
+      for (j = 0; j < TEST_RESONATOR_NINSTANCES; ++j) {
+        SDTResonator_dsp(xs[j]);
+        expected += SDTResonator_getPosition(xs[j], 1);
+      }
+      peak = fmax(peak, fabs(expected));
+      CuAssertDblEquals(tc, expected, out[i],
+                        TEST_RESONATOR_EPSILON * fmax(peak, fabs(expected)));
+    }
+    for (j = 0; j < TEST_RESONATOR_NINSTANCES; ++j) {
+      CuAssertDblEquals(tc, SDTResonator_getPosition(xs[j], 0),
+                        SDTResonatorBank_getPosition(bank, j, 0),
+                        TEST_RESONATOR_EPSILON * peak);
+      CuAssertDblEquals(tc, SDTResonator_getVelocity(xs[j], 0),
+                        SDTResonatorBank_getVelocity(bank, j, 0),
+                        TEST_RESONATOR_EPSILON *
+                            fmax(1.0, fabs(SDTResonator_getVelocity(xs[j], 0))));
+    }
+  }
+  CuAssert(tc, "Check the bank rings", peak > 0.0);
+
+  // Instances at rest go to sleep and are silent
+  for (j = 0; j < TEST_RESONATOR_NINSTANCES; ++j) {
+    SDTResonatorBank_reset(bank, j);
+  }
+  SDTResonatorBank_dspBlock(bank, 1, out, TEST_RESONATOR_BLOCKSIZE);
+  CuAssertDblEquals(tc, 0.0, out[TEST_RESONATOR_BLOCKSIZE - 1], 0.0);
+
+  for (j = 0; j < TEST_RESONATOR_NINSTANCES; ++j) {
+    SDTResonator_free(xs[j]);
+  }
+  SDTResonatorBank_free(bank);
+  SDTResonator_free(model);
+  SDT_TEST_END()
+}
+
+void TestSDTSpectralResonator_dspBlock(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTResonator *x0 = _TestHelper_newResonator(TEST_RESONATOR_NMODES, 2);
+  SDTSpectralResonator *x1 = SDTSpectralResonator_new(TEST_RESONATOR_NMODES, 2);
+  double buf[2][4096], expected[2][4096], *outs[2], *refs[2], peak, error;
+  unsigned int i, mode, pickup, hop;
+
+  // Modes decaying within a few hops are not accurate
+  for (mode = 0; mode < TEST_RESONATOR_NMODES; ++mode) {
+    SDTResonator_setDecay(x0, mode,
+                          fmax(0.1, SDTResonator_getDecay(x0, mode)));
+    SDTSpectralResonator_setFrequency(x1, mode,
+                                      SDTResonator_getFrequency(x0, mode));
+    SDTSpectralResonator_setDecay(x1, mode, SDTResonator_getDecay(x0, mode));
+    SDTSpectralResonator_setWeight(x1, mode,
+                                   SDTResonator_getWeight(x0, mode));
+    for (pickup = 0; pickup < 2; ++pickup)
+      SDTSpectralResonator_setGain(x1, pickup, mode,
+                                   SDTResonator_getGain(x0, pickup, mode));
+  }
+  for (pickup = 0; pickup < 2; ++pickup) {
+    outs[pickup] = buf[pickup];
+    refs[pickup] = expected[pickup];
+  }
+  hop = SDTSpectralResonator_getHopSize(x1);
+
+  // After fading in over a hop, the response matches the recursive resonator
+  SDTResonator_applyForce(x0, 1, 1.0);
+  SDTSpectralResonator_applyForce(x1, 1, 1.0);
+  SDTResonator_dspBlock(x0, 0, NULL, refs, 4096);
+  for (i = 0; i < 4096; i += 100) {
+    SDTSpectralResonator_dspBlock(x1, outs, i + 100 > 4096 ? 4096 - i : 100);
+    outs[0] += 100;
+    outs[1] += 100;
+  }
+  for (pickup = 0; pickup < 2; ++pickup) {
+    peak = 0.0;
+    error = 0.0;
+    for (i = hop; i < 4096; ++i) {
+      peak = fmax(peak, fabs(expected[pickup][i]));
+      error = fmax(error, fabs(buf[pickup][i] - expected[pickup][i]));
+    }
+    CuAssert(tc, "Check the object rings", peak > 0.0);
+    CuAssert(tc, "Check accuracy", error <= 1e-3 * peak);
+  }
+
+  // Negative decays and weights are clamped, as in the recursive resonator
+  SDTSpectralResonator_setDecay(x1, 0, -1.0);
+  SDTSpectralResonator_setWeight(x1, 0, -1.0);
+  CuAssertDblEquals(tc, 0.0, SDTSpectralResonator_getDecay(x1, 0), 0.0);
+  CuAssertDblEquals(tc, 0.0, SDTSpectralResonator_getWeight(x1, 0), 0.0);
+  SDTResonator_free(x0);
+  SDTSpectralResonator_free(x1);
+  SDT_TEST_END()
+}
+
+void TestSDTSpectralResonator_update(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTSpectralResonator *x0 = SDTSpectralResonator_new(1, 1);
+  SDTSpectralResonator *x1 = SDTSpectralResonator_new(1, 1);
+  double buf0[1024], buf1[1024], *outs0[1] = {buf0}, *outs1[1] = {buf1};
+  unsigned int i;
+
+  SDTSpectralResonator_setFrequency(x0, 0, 1000.0);
+  SDTSpectralResonator_setDecay(x0, 0, 0.1);
+  SDTSpectralResonator_setWeight(x0, 0, 1.0);
+  SDTSpectralResonator_setGain(x0, 0, 0, 1.0);
+  SDTSpectralResonator_dspBlock(x0, NULL, 1);
+
+  // Coefficients follow the sample rate once updated
+  SDT_setSampleRate(22050.0);
+  SDTSpectralResonator_update(x0);
+  SDTSpectralResonator_setFrequency(x1, 0, 1000.0);
+  SDTSpectralResonator_setDecay(x1, 0, 0.1);
+  SDTSpectralResonator_setWeight(x1, 0, 1.0);
+  SDTSpectralResonator_setGain(x1, 0, 0, 1.0);
+  SDTSpectralResonator_dspBlock(x1, NULL, 1);
+  SDTSpectralResonator_applyForce(x0, 0, 1.0);
+  SDTSpectralResonator_applyForce(x1, 0, 1.0);
+  SDTSpectralResonator_dspBlock(x0, outs0, 1024);
+  SDTSpectralResonator_dspBlock(x1, outs1, 1024);
+  for (i = 0; i < 1024; ++i) CuAssertDblEquals(tc, buf1[i], buf0[i], 0.0);
+
+  SDTSpectralResonator_free(x0);
+  SDTSpectralResonator_free(x1);
+  SDT_setSampleRate(44100.0);
+  SDT_TEST_END()
+}
+
+void TestSDTModalBudget_update(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTResonator *x0 = _TestHelper_newResonator(TEST_RESONATOR_NMODES, 1);
+  SDTResonator *x1 = _TestHelper_newResonator(TEST_RESONATOR_NMODES, 1);
+  SDTModalBudget *budget = SDTModalBudget_new();
+  unsigned int i;
+
+  SDT_registerResonator(x0, "loud");
+  SDT_registerResonator(x1, "quiet");
+  SDTResonator_applyForce(x0, 0, 1.0);
+  SDTResonator_applyForce(x1, 0, 0.001);
+  SDTModalBudget_setMaxModes(budget, 32);
+  SDTModalBudget_setMinModes(budget, 4);
+  SDTModalBudget_update(budget);
+  CuAssertIntEquals(tc, 2 * TEST_RESONATOR_NMODES,
+                    SDTModalBudget_getRequestedModes(budget));
+  CuAssertIntEquals(tc, 32, SDTModalBudget_getUsedModes(budget));
+  CuAssertIntEquals_Msg(tc, "Check the louder resonator is not limited",
+                        TEST_RESONATOR_NMODES, SDTResonator_getActiveModes(x0));
+  CuAssertIntEquals_Msg(tc, "Check the quieter resonator gets the rest", 8,
+                        SDTResonator_getModeLimit(x1));
+
+  // Dropped modes fade out before being removed
+  CuAssertIntEquals(tc, TEST_RESONATOR_NMODES,
+                    SDTResonator_getActiveModes(x1));
+  for (i = 0; i < 0.06 * 44100; ++i) {
+    SDTResonator_dsp(x0);
+    SDTResonator_dsp(x1);
+  }
+  CuAssertIntEquals(tc, 8, SDTResonator_getActiveModes(x1));
+
+  // Raising the budget lifts the limit
+  SDTModalBudget_setMaxModes(budget, 1024);
+  SDTModalBudget_update(budget);
+  CuAssertIntEquals(tc, TEST_RESONATOR_NMODES,
+                    SDTResonator_getActiveModes(x1));
+  CuAssertIntEquals(tc, 2 * TEST_RESONATOR_NMODES,
+                    SDTModalBudget_getUsedModes(budget));
+
+  // Updating once per block lets the fade complete
+  SDTModalBudget_setMaxModes(budget, 32);
+  for (i = 0; i < 160; ++i) {
+    SDTModalBudget_update(budget);
+    SDTResonator_dspBlock(x0, 0, NULL, NULL, 64);
+    SDTResonator_dspBlock(x1, 0, NULL, NULL, 64);
+  }
+  CuAssertIntEquals(tc, 8, SDTResonator_getModeLimit(x1));
+  CuAssertIntEquals(tc, 8, SDTResonator_getActiveModes(x1));
+  CuAssertIntEquals(tc, TEST_RESONATOR_NMODES,
+                    SDTResonator_getActiveModes(x0));
+
+  SDT_unregisterResonator("loud");
+  SDT_unregisterResonator("quiet");
+  SDTModalBudget_free(budget);
+  SDTResonator_free(x0);
+  SDTResonator_free(x1);
+  SDT_TEST_END()
+}
+
+void TestSDTModalBudget_reserve(CuTest *tc) {
+  SDT_TEST_BEGIN()
+  SDT_setSampleRate(44100.0);
+  SDTResonator *xs[12];
+  SDTModalBudget *before = SDTModalBudget_new(), *after;
+  char key[16];
+  unsigned int j;
+
+  // Budgets make room for resonators registered after their creation
+  for (j = 0; j < 12; ++j) {
+    xs[j] = _TestHelper_newResonator(TEST_RESONATOR_NMODES, 1);
+    snprintf(key, 16, "budget%u", j);
+    SDT_registerResonator(xs[j], key);
+    SDTResonator_applyForce(xs[j], 0, 1.0);
+  }
+  after = SDTModalBudget_new();
+  SDTModalBudget_update(before);
+  SDTModalBudget_update(after);
+  CuAssertIntEquals(tc, 12 * TEST_RESONATOR_NMODES,
+                    SDTModalBudget_getRequestedModes(before));
+  CuAssertIntEquals(tc, 12 * TEST_RESONATOR_NMODES,
+                    SDTModalBudget_getRequestedModes(after));
+
+  for (j = 0; j < 12; ++j) {
+    snprintf(key, 16, "budget%u", j);
+    SDT_unregisterResonator(key);
+    SDTResonator_free(xs[j]);
+  }
+  SDTModalBudget_free(before);
+  SDTModalBudget_free(after);
+  SDT_TEST_END()
+}